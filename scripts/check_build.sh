@@ -14,6 +14,7 @@ pushd build-tsan
 
 cmake -G "Unix Makefiles" ../.. -DCMAKE_BUILD_TYPE=Debug -DCMAKE_CXX_COMPILER=clang++-18 -DUSE_SANITIZER=tsan -DCMAKE_CXX_FLAGS="-stdlib=libc++"
 cmake --build . --config Debug --parallel
+ctest --output-on-failure
 
 popd
 
@@ -23,6 +24,7 @@ pushd build-asan
 
 cmake -G "Unix Makefiles" ../.. -DCMAKE_BUILD_TYPE=Debug -DCMAKE_CXX_COMPILER=clang++-18 -DUSE_SANITIZER=asan -DCMAKE_CXX_FLAGS="-stdlib=libc++"
 cmake --build . --config Debug --parallel
+ctest --output-on-failure
 
 popd
 
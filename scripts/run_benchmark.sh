@@ -7,5 +7,33 @@ set -x
 ./scripts/check_build.sh
 
 ./temp/build-release/demo_coarse_grained 8 4 100000
+./temp/build-release/demo_coarse_grained 8 4 100000 observer
 ./temp/build-release/demo_striped 8 4 100000
+./temp/build-release/demo_striped 8 4 100000 observer
 ./temp/build-release/demo_refinable 8 4 100000
+./temp/build-release/demo_refinable 8 4 100000 observer
+./temp/build-release/demo_lock_free 8 4 100000
+./temp/build-release/demo_lock_free 8 4 100000 observer
+./temp/build-release/demo_cuckoo 8 4 100000
+./temp/build-release/demo_cuckoo 8 4 100000 observer
+
+./temp/build-release/workload --threads=1,2,4,8 --format=csv
+
+# Single-operation costs; pass the CSV of an earlier commit as --baseline to
+# report regressions.
+./temp/build-release/microbench --format=csv
+
+# Exclusive vs reader-writer global lock on a read-mostly mix.
+./temp/build-release/workload --threads=1,2,4,8 --format=csv --mix=99,1,0 \
+    --impls=coarse_grained,coarse_grained_rw,coarse_grained_rw_spin
+
+# Padded vs packed lock layout (see src/lock_policy.h).
+./temp/build-release/workload --threads=1,2,4,8,16,32,64 --format=csv \
+    --impls=striped,striped_padded,striped_spin,striped_spin_padded,refinable,refinable_padded,refinable_spin,refinable_spin_padded
+
+# Local vs remote memory, and per-node shards (see src/hash_set_sharded.h).
+for affinity in local remote spread; do
+  ./temp/build-release/workload --threads=1,2,4,8,16 --format=csv \
+      --affinity=${affinity} \
+      --impls=striped_arena,refinable_arena,sharded_striped,sharded_refinable
+done
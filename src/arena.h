@@ -0,0 +1,210 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "src/cache_line.h"
+#include "src/numa.h"
+#include "src/thread_index.h"
+
+// ============================================================================
+// Table arenas
+// ----------------------------------------------------------------------------
+// The Allocator template parameter of the chaining sets allocates the bucket
+// array and every bucket's elements. With the default std::allocator each
+// bucket grows through the global heap. With ArenaAllocator, each table gets
+// an Arena of its own instead:
+//  - Allocations are carved out of large slabs, from a shard per thread, so
+//    concurrent inserts neither call malloc nor contend on a shared lock.
+//  - Deallocation is a no-op. Everything a table allocated is freed in one
+//    go when the table is dropped after a resize, or when the set dies.
+//    Memory released by a live table is not reused, which costs a bucket at
+//    most as much again as the largest size it has grown to.
+//  - Slabs may be bound to a NUMA node (see numa.h), which places the whole
+//    table there, whichever thread allocates it.
+// Sets create one TableAllocator<Allocator> per table, which holds the
+// table's arena (or nothing, for stateless allocators) and must outlive
+// every bucket of the table.
+// ============================================================================
+class Arena {
+ public:
+  // Slabs come from |numa_node| (see numa.h), which defaults to that of the
+  // innermost ScopedNumaNode of the creating thread, if any.
+  explicit Arena(size_t num_shards = DefaultShardCount(),
+                 size_t numa_node = ScopedNumaNode::Current())
+      : shards_(std::bit_ceil(std::max<size_t>(num_shards, 1))),
+        mask_(shards_.size() - 1),
+        numa_node_(numa_node) {}
+
+  ~Arena() {
+    for (Shard& shard : shards_) {
+      Slab* slab = shard.slabs;
+      while (slab != nullptr) {
+        Slab* next = slab->next;
+        FreeOnNumaNode(slab, slab->bytes, numa_node_);
+        slab = next;
+      }
+    }
+  }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // --------------------------------------------------------------------------
+  // Default shard count: one per hardware thread, rounded up to a power of
+  // two.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] static size_t DefaultShardCount() noexcept {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns |bytes| of storage aligned to |alignment|, a power of two. Safe to
+  // call from several threads at once.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] void* Allocate(size_t bytes, size_t alignment) {
+    Shard& shard = shards_[CurrentThreadIndex() & mask_];
+    const std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // Large blocks (such as bucket arrays) get a slab of their own, so they
+    // do not waste the rest of the current one.
+    if (bytes > kMaxSlabSize / 4) {
+      size_t space = bytes + alignment;
+      void* block = AddSlab(shard, space);
+      return std::align(alignment, bytes, block, space);
+    }
+
+    void* block = shard.cursor;
+    size_t space = shard.remaining;
+    if (block == nullptr ||
+        std::align(alignment, bytes, block, space) == nullptr) {
+      space = std::max(shard.next_slab_size, bytes + alignment);
+      shard.next_slab_size = std::min(shard.next_slab_size * 2, kMaxSlabSize);
+      block = AddSlab(shard, space);
+      std::align(alignment, bytes, block, space);
+    }
+    shard.cursor = static_cast<char*>(block) + bytes;
+    shard.remaining = space - bytes;
+    return block;
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the number of bytes obtained from the heap so far.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t ReservedBytes() const {
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+      const std::lock_guard<std::mutex> lock(shard.mutex);
+      total += shard.reserved;
+    }
+    return total;
+  }
+
+ private:
+  // Slabs start small, since most tables are small, and grow geometrically.
+  static constexpr size_t kMinSlabSize = size_t{4} << 10;
+  static constexpr size_t kMaxSlabSize = size_t{1} << 20;
+
+  struct alignas(std::max_align_t) Slab {
+    Slab* next;
+    size_t bytes;  // including this header
+  };
+
+  struct alignas(kCacheLineSize) Shard {
+    mutable std::mutex mutex;
+    char* cursor = nullptr;  // free space in the newest slab
+    size_t remaining = 0;
+    size_t next_slab_size = kMinSlabSize;
+    size_t reserved = 0;
+    Slab* slabs = nullptr;  // every slab of the shard, newest first
+  };
+
+  // Allocates a slab with |size| usable bytes and returns their start.
+  void* AddSlab(Shard& shard, size_t size) const {
+    auto* slab = static_cast<Slab*>(
+        AllocateOnNumaNode(sizeof(Slab) + size, numa_node_));
+    slab->next = shard.slabs;
+    slab->bytes = sizeof(Slab) + size;
+    shard.slabs = slab;
+    shard.reserved += sizeof(Slab) + size;
+    return slab + 1;
+  }
+
+  std::vector<Shard> shards_;  // power-of-two count
+  size_t mask_;
+  size_t numa_node_;  // or kAnyNumaNode
+};
+
+// ============================================================================
+// Standard allocator that allocates from an Arena. Like
+// std::pmr::polymorphic_allocator, it passes itself on to the elements it
+// constructs when they are allocator-aware, so the buckets of a table and
+// their elements all come from the table's arena.
+// ============================================================================
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  explicit ArenaAllocator(Arena& arena) noexcept : arena_(&arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+      : arena_(&other.arena()) {}
+
+  [[nodiscard]] T* allocate(size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* /*ptr*/, size_t /*n*/) noexcept {}
+
+  template <typename U, typename... Args>
+  void construct(U* ptr, Args&&... args) {
+    std::uninitialized_construct_using_allocator(ptr, *this,
+                                                 std::forward<Args>(args)...);
+  }
+
+  [[nodiscard]] Arena& arena() const noexcept { return *arena_; }
+
+  template <typename U>
+  friend bool operator==(const ArenaAllocator& lhs,
+                         const ArenaAllocator<U>& rhs) noexcept {
+    return &lhs.arena() == &rhs.arena();
+  }
+
+ private:
+  Arena* arena_;
+};
+
+// ============================================================================
+// Per-table allocation state for a set's Allocator parameter. A stateless
+// allocator needs none; ArenaAllocator gets a fresh Arena per table.
+// ============================================================================
+template <typename Allocator>
+class TableAllocator {
+ public:
+  [[nodiscard]] Allocator Get() const { return Allocator(); }
+};
+
+template <typename T>
+class TableAllocator<ArenaAllocator<T>> {
+ public:
+  [[nodiscard]] ArenaAllocator<T> Get() { return ArenaAllocator<T>(arena_); }
+
+ private:
+  Arena arena_;
+};
+
+#endif  // ARENA_H
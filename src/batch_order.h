@@ -0,0 +1,67 @@
+#ifndef BATCH_ORDER_H
+#define BATCH_ORDER_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+// How many elements ahead of the current one a batch operation prefetches.
+inline constexpr size_t kBatchPrefetchDistance = 8;
+
+// ----------------------------------------------------------------------------
+// Returns the positions 0..keys.size()-1 sorted by |keys|, keeping equal keys
+// in input order. Batch operations use it to visit elements grouped by the
+// lock or bucket they need, while repeated elements are still processed in
+// the order the caller gave them.
+// ----------------------------------------------------------------------------
+inline std::vector<size_t> BatchOrder(const std::vector<size_t>& keys) {
+  std::vector<size_t> order(keys.size());
+  std::iota(order.begin(), order.end(), size_t{0});
+  std::stable_sort(order.begin(), order.end(),
+                   [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+  return order;
+}
+
+// Hints that |addr| is about to be read.
+inline void PrefetchForRead(const void* addr) noexcept {
+  __builtin_prefetch(addr, 0);
+}
+
+// ----------------------------------------------------------------------------
+// Runs |n| independent lookups as a software pipeline, so that their cache
+// misses overlap instead of following one another. A lookup misses twice:
+// on its bucket in the table, and on the element storage the bucket points
+// to (see PrefetchElements() in bucket_storage.h). Each lookup therefore
+// goes through three stages, kBatchPrefetchDistance lookups apart:
+//   State locate(i)        - hash element i and prefetch its bucket
+//   void fetch(state)      - prefetch the bucket's element storage
+//   void probe(i, state)   - search the bucket
+// so that at step s lookup s is located, s - d fetched and s - 2d probed.
+// The per-lookup state lives in a small ring, which makes this the
+// explicit state machine a coroutine per lookup would compile to, without
+// allocating a frame per lookup.
+// ----------------------------------------------------------------------------
+template <typename State, typename Locate, typename Fetch, typename Probe>
+void InterleaveLookups(size_t n, Locate&& locate, Fetch&& fetch,
+                       Probe&& probe) {
+  constexpr size_t kDistance = kBatchPrefetchDistance;
+  constexpr size_t kWindow = std::bit_ceil(2 * kDistance + 1);
+  std::array<State, kWindow> states{};
+  for (size_t step = 0; step < n + 2 * kDistance; ++step) {
+    if (step < n) {
+      states[step % kWindow] = locate(step);
+    }
+    if (step >= kDistance && step - kDistance < n) {
+      fetch(states[(step - kDistance) % kWindow]);
+    }
+    if (step >= 2 * kDistance) {
+      const size_t i = step - 2 * kDistance;
+      probe(i, states[i % kWindow]);
+    }
+  }
+}
+
+#endif  // BATCH_ORDER_H
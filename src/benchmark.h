@@ -2,9 +2,11 @@
 #define BENCHMARK_H
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstddef>
 #include <iostream>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -12,14 +14,83 @@
 
 namespace benchmark {
 
-void ThreadBody(HashSetBase<int>& hash_set, size_t chunk_size, size_t id,
-                size_t& max_observed_size);
+// How the benchmark tracks the largest size it observes:
+//   kInline    - every thread calls Size() after each Add and Remove. For sets
+//                whose Size() synchronises, this dominates the measurement.
+//   kSampled   - every thread calls Size() after one in kSizeSampleInterval
+//                updates, and once when it finishes.
+//   kObserver  - the worker threads never call Size(); a separate observer
+//                thread polls it every kObserverPeriod until they finish.
+enum class SizeMode { kInline, kSampled, kObserver };
 
-template <typename HashSetType>
+inline constexpr size_t kSizeSampleInterval = 1024;
+inline constexpr std::chrono::microseconds kObserverPeriod{100};
+
+// Parses "inline", "sampled" or "observer". Returns false otherwise.
+bool ParseSizeMode(const std::string& text, SizeMode& mode);
+
+// The worker and observer bodies are templated on the set type, so that
+// operations are dispatched statically and can be inlined into the loop.
+template <HashSet<int> HashSetType>
+void ThreadBody(HashSetType& hash_set, size_t chunk_size, size_t id,
+                SizeMode size_mode, size_t& max_observed_size) {
+  max_observed_size = 0;
+  size_t updates = 0;
+  // Called after every Add and Remove.
+  auto observe_size = [&]() {
+    if (size_mode == SizeMode::kInline ||
+        (size_mode == SizeMode::kSampled &&
+         ++updates % kSizeSampleInterval == 0)) {
+      max_observed_size = std::max(max_observed_size, hash_set.Size());
+    }
+  };
+
+  for (size_t k = 0; k < chunk_size * 2; k++) {
+    int elem = static_cast<int>(id * chunk_size + k);
+    hash_set.Add(elem);
+    observe_size();
+  }
+  for (size_t j = 0; j < 20; j++) {
+    for (size_t k = 0; k < chunk_size * 2; k++) {
+      int elem = static_cast<int>(id * chunk_size + k);
+      if (hash_set.Contains(elem)) {
+        if ((elem % 20) == 0) {
+          hash_set.Remove(elem);
+          observe_size();
+        }
+      }
+    }
+  }
+  for (size_t k = 0; k < chunk_size * 2; k++) {
+    int elem = static_cast<int>(id * chunk_size + k);
+    hash_set.Add(elem);
+    observe_size();
+  }
+  if (size_mode == SizeMode::kSampled) {
+    max_observed_size = std::max(max_observed_size, hash_set.Size());
+  }
+}
+
+// Polls hash_set.Size() until |done| is set.
+template <HashSet<int> HashSetType>
+void ObserverBody(const HashSetType& hash_set, const std::atomic<bool>& done,
+                  size_t& max_observed_size) {
+  max_observed_size = 0;
+  while (!done.load(std::memory_order_acquire)) {
+    max_observed_size = std::max(max_observed_size, hash_set.Size());
+    std::this_thread::sleep_for(kObserverPeriod);
+  }
+  max_observed_size = std::max(max_observed_size, hash_set.Size());
+}
+
+template <HashSet<int> HashSetType>
 int RunBenchmark(int argc, char** argv) {
-  if (argc != 4) {
+  SizeMode size_mode = SizeMode::kInline;
+  if ((argc != 4 && argc != 5) ||
+      (argc == 5 && !ParseSizeMode(argv[4], size_mode))) {
     std::cerr << "Usage: " << argv[0]
-              << " num_threads initial_capacity chunk_size" << std::endl;
+              << " num_threads initial_capacity chunk_size"
+              << " [inline|sampled|observer]" << std::endl;
     return 1;
   }
   size_t num_threads = std::stoul(std::string(argv[1]));
@@ -37,15 +108,33 @@ int RunBenchmark(int argc, char** argv) {
   std::vector<std::thread> threads;
   threads.reserve(num_threads);
 
+  std::atomic<bool> done{false};
+  size_t observer_max_size = 0;
+  std::thread observer;
+
   auto begin_time = std::chrono::high_resolution_clock::now();
+  if (size_mode == SizeMode::kObserver) {
+    observer = std::thread(ObserverBody<HashSetType>, std::cref(hash_set),
+                           std::cref(done), std::ref(observer_max_size));
+  }
   for (size_t i = 0; i < num_threads; i++) {
-    threads.emplace_back(std::thread(ThreadBody, std::ref(hash_set), chunk_size,
-                                     i, std::ref(max_observed_sizes.at(i))));
+    threads.emplace_back(std::thread(ThreadBody<HashSetType>,
+                                     std::ref(hash_set), chunk_size, i,
+                                     size_mode,
+                                     std::ref(max_observed_sizes.at(i))));
   }
   for (auto& thread : threads) {
     thread.join();
   }
   auto end_time = std::chrono::high_resolution_clock::now();
+  if (observer.joinable()) {
+    done.store(true, std::memory_order_release);
+    observer.join();
+  }
+  size_t max_observed_size = observer_max_size;
+  for (size_t thread_max_size : max_observed_sizes) {
+    max_observed_size = std::max(max_observed_size, thread_max_size);
+  }
 
   auto duration = end_time - begin_time;
   auto millis =
@@ -69,6 +158,7 @@ int RunBenchmark(int argc, char** argv) {
   std::cout << argv[0] << " succeeded" << std::endl;
   std::cout << "Concurrent computation took:" << std::endl;
   std::cout << "  " << millis << " ms" << std::endl;
+  std::cout << "max_observed_size: " << max_observed_size << std::endl;
   return 0;
 }
 
@@ -0,0 +1,154 @@
+#ifndef BUCKET_PROBE_H
+#define BUCKET_PROBE_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// ============================================================================
+// Bucket probe kernels
+// ----------------------------------------------------------------------------
+// BucketProbe<T> finds an element in a contiguous run of bucket slots:
+//
+//   Find(elems, count, elem)        - index of |elem| in elems[0, count), or
+//                                     |count| if it is absent.
+//   FindInline<N>(slots, count, elem)
+//                                   - as Find, for a fixed array of N slots of
+//                                     which the first |count| are in use. The
+//                                     unused slots may be read but are never
+//                                     reported as matches.
+//
+// The primary template is a scalar loop. 32-bit integers get a specialisation
+// that compares a whole group of slots at once and turns the result into a
+// bit mask: 8 slots per step with AVX2, 4 with SSE2 or AArch64 NEON. Without
+// any of those it uses the scalar loop as well.
+// ============================================================================
+template <typename T, typename Enable = void>
+struct BucketProbe {
+  [[nodiscard]] static size_t Find(const T* elems, size_t count,
+                                   const T& elem) {
+    return static_cast<size_t>(std::find(elems, elems + count, elem) - elems);
+  }
+
+  template <size_t N>
+  [[nodiscard]] static size_t FindInline(const T* slots, size_t count,
+                                         const T& elem) {
+    return Find(slots, count, elem);
+  }
+};
+
+template <typename T>
+struct BucketProbe<T,
+                   std::enable_if_t<std::is_integral_v<T> && sizeof(T) == 4>> {
+  // Widest group of slots compared per vector step, and the narrower group
+  // used for short fixed-size buckets. Zero means no vector support.
+#if defined(__AVX2__)
+  static constexpr size_t kWideLanes = 8;
+  static constexpr size_t kNarrowLanes = 4;
+#elif defined(__SSE2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+  static constexpr size_t kWideLanes = 4;
+  static constexpr size_t kNarrowLanes = 4;
+#else
+  static constexpr size_t kWideLanes = 0;
+  static constexpr size_t kNarrowLanes = 0;
+#endif
+
+  [[nodiscard]] static size_t Find(const T* elems, size_t count,
+                                   const T& elem) {
+    size_t i = 0;
+    if constexpr (kWideLanes > 0) {
+      for (; i + kWideLanes <= count; i += kWideLanes) {
+        const uint32_t mask = MatchMask<kWideLanes>(elems + i, elem);
+        if (mask != 0) {
+          return i + static_cast<size_t>(std::countr_zero(mask));
+        }
+      }
+    }
+    for (; i < count; ++i) {
+      if (elems[i] == elem) {
+        return i;
+      }
+    }
+    return count;
+  }
+
+  template <size_t N>
+  [[nodiscard]] static size_t FindInline(const T* slots, size_t count,
+                                         const T& elem) {
+    if constexpr (SplitsIntoGroups(N, kWideLanes)) {
+      return FindInGroups<kWideLanes>(slots, count, elem);
+    } else if constexpr (SplitsIntoGroups(N, kNarrowLanes)) {
+      return FindInGroups<kNarrowLanes>(slots, count, elem);
+    } else {
+      return Find(slots, count, elem);
+    }
+  }
+
+ private:
+  static constexpr bool SplitsIntoGroups(size_t slots, size_t lanes) {
+    return lanes > 0 && slots % lanes == 0;
+  }
+
+  // Every slot of the fixed array is readable, so compare whole groups and
+  // mask off the lanes past |count| instead of running a scalar tail.
+  template <size_t Lanes>
+  [[nodiscard]] static size_t FindInGroups(const T* slots, size_t count,
+                                           const T& elem) {
+    for (size_t i = 0; i < count; i += Lanes) {
+      uint32_t mask = MatchMask<Lanes>(slots + i, elem);
+      if (count - i < Lanes) {
+        mask &= (uint32_t{1} << (count - i)) - 1;
+      }
+      if (mask != 0) {
+        return i + static_cast<size_t>(std::countr_zero(mask));
+      }
+    }
+    return count;
+  }
+
+  // Returns a mask with bit j set iff group[j] == elem, for j < Lanes.
+  template <size_t Lanes>
+  [[nodiscard]] static uint32_t MatchMask(const T* group, const T& elem) {
+#if defined(__AVX2__)
+    if constexpr (Lanes == 8) {
+      __m256i slots;
+      std::memcpy(&slots, group, sizeof(slots));
+      const __m256i needle = _mm256_set1_epi32(static_cast<int>(elem));
+      const __m256i equal = _mm256_cmpeq_epi32(slots, needle);
+      return static_cast<uint32_t>(
+          _mm256_movemask_ps(_mm256_castsi256_ps(equal)));
+    }
+#endif
+    static_assert(Lanes == 4 || Lanes == 8, "unsupported group width");
+#if defined(__SSE2__)
+    __m128i slots;
+    std::memcpy(&slots, group, sizeof(slots));
+    const __m128i needle = _mm_set1_epi32(static_cast<int>(elem));
+    const __m128i equal = _mm_cmpeq_epi32(slots, needle);
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(equal)));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint32_t lanes[4];
+    std::memcpy(lanes, group, sizeof(lanes));
+    const uint32x4_t equal = vceqq_u32(
+        vld1q_u32(lanes), vdupq_n_u32(static_cast<uint32_t>(elem)));
+    // Keep one distinct bit per lane and add them up.
+    const uint32x4_t bits = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(equal, bits));
+#else
+    (void)group;
+    (void)elem;
+    return 0;
+#endif
+  }
+};
+
+#endif  // BUCKET_PROBE_H
@@ -0,0 +1,539 @@
+#ifndef BUCKET_STORAGE_H
+#define BUCKET_STORAGE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "src/bucket_probe.h"
+
+// ============================================================================
+// Bucket storage policies
+// ----------------------------------------------------------------------------
+// Every chaining hash set stores its table as a std::vector of buckets. The
+// Storage template parameter of a set chooses the bucket type, which
+// allocates through the set's Allocator (see arena.h):
+//
+//   VectorBucketStorage      - one heap-allocated std::vector per bucket.
+//   InlineBucketStorage<N>   - N slots stored inline in the table itself,
+//                              plus an overflow vector allocated only for
+//                              buckets that hold more than N elements.
+//   CachedHashBucketStorage  - a std::vector of (hash, element) entries.
+//                              Lookups compare the hash before the element
+//                              and rehashing never recomputes a hash, which
+//                              pays off for keys such as strings.
+//
+// A bucket type provides, for a key K that is T or a HeterogeneousKey (see
+// hash_policy.h) and the hash h of the key or element:
+//   explicit Bucket(const Allocator&)
+//                                    - an empty bucket; it is allocator-aware,
+//                                      so allocators such as ArenaAllocator
+//                                      construct it with themselves
+//   bool Contains(const K&, h) const - membership test
+//   void Insert(T, h)                - append; the element must be absent
+//   bool Erase(const K&, h)          - remove; false if absent
+//   const T* Find(const K&, h) const - the element equal to the key, or
+//                                      null if absent
+//   bool Modify(const K&, h, F)      - apply F to the element equal to the
+//                                      key, which must leave it equal to
+//                                      the key; false if absent
+//   size_t Size() const              - number of elements
+//   void ForEach(F) const            - visit every element
+//   void PrefetchElements() const    - hint that the elements are about to
+//                                      be searched, for the ones stored
+//                                      outside the bucket itself (see
+//                                      InterleaveLookups() in batch_order.h)
+//   void Drain(H, F)                 - move every element out, passing it and
+//                                      its hash to F, then Clear(); H
+//                                      computes hashes the bucket does not
+//                                      store
+//   void Clear()                     - drop every element and free memory
+//   static constexpr bool kStoresHashes
+//                                    - whether Insert() keeps the hash it is
+//                                      given; buckets that do not may be
+//                                      filled with any hash, e.g. from a
+//                                      snapshot (see snapshot.h)
+//
+// A bucket type may also support optimistic reads, i.e. lookups that run
+// concurrently with a writer holding the bucket's lock:
+//   static constexpr bool kSupportsOptimisticReads
+//   OptimisticLookup ContainsOptimistic(const T&) const
+//                                    - membership test that never reads
+//                                      memory a writer may free; the result
+//                                      is only meaningful if the caller can
+//                                      prove that no write overlapped it
+//                                      (e.g. with a seqlock).
+//
+// Lookups by T go through BucketProbe (see bucket_probe.h), which vectorises
+// the scan for 32-bit integer keys.
+//
+// Buckets are not thread-safe; the owning set provides synchronisation.
+// ============================================================================
+
+enum class OptimisticLookup {
+  kFound,     // the element was seen
+  kNotFound,  // the element was not seen
+  kUnknown,   // the bucket cannot be searched without its lock
+};
+
+// ----------------------------------------------------------------------------
+// Returns the index of |key| in elems[0, count), or |count| if it is absent.
+// Keys of the element type use BucketProbe; other key types, which the
+// probe kernels do not know how to compare, a plain loop.
+// ----------------------------------------------------------------------------
+template <typename T, typename K>
+[[nodiscard]] size_t FindKey(const T* elems, size_t count, const K& key) {
+  if constexpr (std::is_same_v<K, T>) {
+    return BucketProbe<T>::Find(elems, count, key);
+  } else {
+    return static_cast<size_t>(std::find(elems, elems + count, key) - elems);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Bucket backed by a std::vector<T>.
+// ----------------------------------------------------------------------------
+template <typename T, typename Allocator = std::allocator<T>>
+class VectorBucket {
+ public:
+  using allocator_type = Allocator;
+
+  // push_back may reallocate the elements under a concurrent reader.
+  static constexpr bool kSupportsOptimisticReads = false;
+  static constexpr bool kStoresHashes = false;
+
+  explicit VectorBucket(const Allocator& allocator = Allocator())
+      : elems_(allocator) {}
+
+  template <typename K>
+  [[nodiscard]] bool Contains(const K& key, size_t /*hash*/) const {
+    return FindKey(elems_.data(), elems_.size(), key) != elems_.size();
+  }
+
+  void Insert(T elem, size_t /*hash*/) { elems_.push_back(std::move(elem)); }
+
+  template <typename K>
+  bool Erase(const K& key, size_t /*hash*/) {
+    const size_t index = FindKey(elems_.data(), elems_.size(), key);
+    if (index == elems_.size()) {
+      return false;
+    }
+    elems_.erase(elems_.begin() + static_cast<std::ptrdiff_t>(index));
+    return true;
+  }
+
+  template <typename K>
+  [[nodiscard]] const T* Find(const K& key, size_t /*hash*/) const {
+    const size_t index = FindKey(elems_.data(), elems_.size(), key);
+    return index != elems_.size() ? &elems_[index] : nullptr;
+  }
+
+  template <typename K, typename F>
+  bool Modify(const K& key, size_t /*hash*/, F&& f) {
+    const size_t index = FindKey(elems_.data(), elems_.size(), key);
+    if (index == elems_.size()) {
+      return false;
+    }
+    f(elems_[index]);
+    return true;
+  }
+
+  [[nodiscard]] size_t Size() const noexcept { return elems_.size(); }
+
+  template <typename F>
+  void ForEach(F&& f) const {
+    for (const auto& elem : elems_) {
+      f(elem);
+    }
+  }
+
+  void PrefetchElements() const noexcept {
+    if (!elems_.empty()) {
+      __builtin_prefetch(elems_.data(), 0);
+    }
+  }
+
+  template <typename H, typename F>
+  void Drain(const H& hash, F&& f) {
+    for (auto& elem : elems_) {
+      const size_t h = hash(elem);
+      f(std::move(elem), h);
+    }
+    Clear();
+  }
+
+  void Clear() {
+    std::vector<T, Allocator>(elems_.get_allocator()).swap(elems_);
+  }
+
+ private:
+  std::vector<T, Allocator> elems_;
+};
+
+// ----------------------------------------------------------------------------
+// Whether plain objects of type T can be accessed through std::atomic_ref
+// without locking. Instantiating atomic_ref needs a trivially copyable T, so
+// that is checked first.
+// ----------------------------------------------------------------------------
+template <typename T, bool = std::is_trivially_copyable_v<T>>
+struct AtomicallyAccessible : std::false_type {};
+
+template <typename T>
+struct AtomicallyAccessible<T, true>
+    : std::bool_constant<std::atomic_ref<T>::is_always_lock_free &&
+                         std::atomic_ref<T>::required_alignment ==
+                             alignof(T)> {};
+
+// ----------------------------------------------------------------------------
+// Bucket with N inline slots and a lazily allocated overflow vector.
+//  - The first N elements live in the bucket itself, i.e. contiguously in
+//    the table, so a lookup in a short bucket touches no other memory.
+//  - The overflow vector is only used while all inline slots are taken.
+//  - Erase keeps the inline slots dense by moving the last element (from
+//    the overflow if there is one) into the hole.
+//  - The overflow's elements come from the Allocator; the bucket keeps a
+//    copy of it, which takes no space if the allocator is stateless.
+//  - For trivially copyable elements with lock-free atomics, the inline
+//    slots and their count are written atomically, which makes optimistic
+//    reads of the inline part possible. A full bucket may own an overflow
+//    vector that a writer can free, so it is never read optimistically.
+// ----------------------------------------------------------------------------
+template <typename T, size_t N, typename Allocator = std::allocator<T>>
+class InlineBucket {
+  static_assert(N > 0, "InlineBucket needs at least one inline slot");
+
+ public:
+  using allocator_type = Allocator;
+
+  explicit InlineBucket(const Allocator& allocator = Allocator())
+      : allocator_(allocator) {}
+
+  static constexpr bool kSupportsOptimisticReads =
+      AtomicallyAccessible<T>::value && AtomicallyAccessible<uint32_t>::value;
+  static constexpr bool kStoresHashes = false;
+
+  template <typename K>
+  [[nodiscard]] bool Contains(const K& key, size_t /*hash*/) const {
+    if (FindInline(key) != inline_size_) {
+      return true;
+    }
+    return overflow_ != nullptr &&
+           FindKey(overflow_->data(), overflow_->size(), key) !=
+               overflow_->size();
+  }
+
+  [[nodiscard]] OptimisticLookup ContainsOptimistic(const T& elem) const
+    requires kSupportsOptimisticReads
+  {
+    const uint32_t size =
+        AtomicRef(inline_size_).load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < size && i < N; ++i) {
+      if (AtomicRef(slots_[i]).load(std::memory_order_relaxed) == elem) {
+        return OptimisticLookup::kFound;
+      }
+    }
+    return size < N ? OptimisticLookup::kNotFound : OptimisticLookup::kUnknown;
+  }
+
+  void Insert(T elem, size_t /*hash*/) {
+    if (inline_size_ < N) {
+      StoreSlot(inline_size_, std::move(elem));
+      SetInlineSize(inline_size_ + 1);
+      return;
+    }
+    if (overflow_ == nullptr) {
+      overflow_ = std::make_unique<std::vector<T, Allocator>>(allocator_);
+    }
+    overflow_->push_back(std::move(elem));
+  }
+
+  template <typename K>
+  bool Erase(const K& key, size_t /*hash*/) {
+    const size_t slot = FindInline(key);
+    if (slot != inline_size_) {
+      if (overflow_ != nullptr) {
+        StoreSlot(slot, std::move(overflow_->back()));
+        PopOverflow();
+      } else {
+        StoreSlot(slot, std::move(slots_[inline_size_ - 1]));
+        SetInlineSize(inline_size_ - 1);
+      }
+      return true;
+    }
+
+    if (overflow_ == nullptr) {
+      return false;
+    }
+    const size_t index = FindKey(overflow_->data(), overflow_->size(), key);
+    if (index == overflow_->size()) {
+      return false;
+    }
+    (*overflow_)[index] = std::move(overflow_->back());
+    PopOverflow();
+    return true;
+  }
+
+  template <typename K>
+  [[nodiscard]] const T* Find(const K& key, size_t /*hash*/) const {
+    const size_t slot = FindInline(key);
+    if (slot != inline_size_) {
+      return &slots_[slot];
+    }
+    if (overflow_ == nullptr) {
+      return nullptr;
+    }
+    const size_t index = FindKey(overflow_->data(), overflow_->size(), key);
+    return index != overflow_->size() ? &(*overflow_)[index] : nullptr;
+  }
+
+  // Inline slots are modified in a copy that is stored back whole, as
+  // optimistic readers may be loading them.
+  template <typename K, typename F>
+  bool Modify(const K& key, size_t /*hash*/, F&& f) {
+    const size_t slot = FindInline(key);
+    if (slot != inline_size_) {
+      if constexpr (kSupportsOptimisticReads) {
+        T elem = slots_[slot];
+        f(elem);
+        StoreSlot(slot, elem);
+      } else {
+        f(slots_[slot]);
+      }
+      return true;
+    }
+    if (overflow_ == nullptr) {
+      return false;
+    }
+    const size_t index = FindKey(overflow_->data(), overflow_->size(), key);
+    if (index == overflow_->size()) {
+      return false;
+    }
+    f((*overflow_)[index]);
+    return true;
+  }
+
+  [[nodiscard]] size_t Size() const noexcept {
+    return inline_size_ + (overflow_ != nullptr ? overflow_->size() : 0);
+  }
+
+  template <typename F>
+  void ForEach(F&& f) const {
+    for (size_t i = 0; i < inline_size_; ++i) {
+      f(slots_[i]);
+    }
+    if (overflow_ != nullptr) {
+      for (const auto& elem : *overflow_) {
+        f(elem);
+      }
+    }
+  }
+
+  // The inline slots share the bucket's cache lines, so only the spill
+  // vector is fetched; its contents would take reading its data pointer,
+  // i.e. the very miss this is meant to hide.
+  void PrefetchElements() const noexcept {
+    if (overflow_ != nullptr) {
+      __builtin_prefetch(overflow_.get(), 0);
+    }
+  }
+
+  template <typename H, typename F>
+  void Drain(const H& hash, F&& f) {
+    for (size_t i = 0; i < inline_size_; ++i) {
+      const size_t h = hash(slots_[i]);
+      f(std::move(slots_[i]), h);
+    }
+    if (overflow_ != nullptr) {
+      for (auto& elem : *overflow_) {
+        const size_t h = hash(elem);
+        f(std::move(elem), h);
+      }
+    }
+    Clear();
+  }
+
+  void Clear() {
+    SetInlineSize(0);
+    overflow_.reset();
+  }
+
+ private:
+  template <typename K>
+  [[nodiscard]] size_t FindInline(const K& key) const {
+    if constexpr (std::is_same_v<K, T>) {
+      return BucketProbe<T>::template FindInline<N>(slots_.data(),
+                                                    inline_size_, key);
+    } else {
+      return FindKey(slots_.data(), inline_size_, key);
+    }
+  }
+
+  template <typename U>
+  [[nodiscard]] static std::atomic_ref<U> AtomicRef(const U& value) noexcept {
+    // Only ever used for loads; atomic_ref<const U> needs C++26.
+    return std::atomic_ref<U>(const_cast<U&>(value));
+  }
+
+  // Writes that optimistic readers may observe.
+  void StoreSlot(size_t slot, T elem) {
+    if constexpr (kSupportsOptimisticReads) {
+      AtomicRef(slots_[slot]).store(elem, std::memory_order_relaxed);
+    } else {
+      slots_[slot] = std::move(elem);
+    }
+  }
+
+  void SetInlineSize(uint32_t size) noexcept {
+    if constexpr (kSupportsOptimisticReads) {
+      AtomicRef(inline_size_).store(size, std::memory_order_relaxed);
+    } else {
+      inline_size_ = size;
+    }
+  }
+
+  // Removes the last overflow element, freeing the vector once it is empty.
+  void PopOverflow() {
+    overflow_->pop_back();
+    if (overflow_->empty()) {
+      overflow_.reset();
+    }
+  }
+
+  std::array<T, N> slots_{};
+  uint32_t inline_size_ = 0;  // used inline slots
+  [[no_unique_address]] Allocator allocator_;
+  std::unique_ptr<std::vector<T, Allocator>> overflow_;  // null when empty
+};
+
+// ----------------------------------------------------------------------------
+// Bucket of (hash, element) entries.
+//  - A lookup only compares elements whose stored hash matches, so a miss
+//    rarely touches the elements themselves.
+//  - Drain() hands out the stored hashes, so rehashing never hashes an
+//    element again.
+//  - Erase moves the last entry into the hole instead of shifting the rest.
+// ----------------------------------------------------------------------------
+template <typename T, typename Allocator = std::allocator<T>>
+class CachedHashBucket {
+  struct Entry {
+    size_t hash;
+    T elem;
+  };
+  using EntryAllocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Entry>;
+
+ public:
+  using allocator_type = Allocator;
+
+  static constexpr bool kSupportsOptimisticReads = false;
+  static constexpr bool kStoresHashes = true;
+
+  explicit CachedHashBucket(const Allocator& allocator = Allocator())
+      : entries_(EntryAllocator(allocator)) {}
+
+  template <typename K>
+  [[nodiscard]] bool Contains(const K& key, size_t hash) const {
+    return IndexOf(key, hash) != entries_.size();
+  }
+
+  void Insert(T elem, size_t hash) {
+    entries_.push_back(Entry{hash, std::move(elem)});
+  }
+
+  template <typename K>
+  bool Erase(const K& key, size_t hash) {
+    const size_t index = IndexOf(key, hash);
+    if (index == entries_.size()) {
+      return false;
+    }
+    if (index + 1 != entries_.size()) {
+      entries_[index] = std::move(entries_.back());
+    }
+    entries_.pop_back();
+    return true;
+  }
+
+  template <typename K>
+  [[nodiscard]] const T* Find(const K& key, size_t hash) const {
+    const size_t index = IndexOf(key, hash);
+    return index != entries_.size() ? &entries_[index].elem : nullptr;
+  }
+
+  template <typename K, typename F>
+  bool Modify(const K& key, size_t hash, F&& f) {
+    const size_t index = IndexOf(key, hash);
+    if (index == entries_.size()) {
+      return false;
+    }
+    f(entries_[index].elem);
+    return true;
+  }
+
+  [[nodiscard]] size_t Size() const noexcept { return entries_.size(); }
+
+  template <typename F>
+  void ForEach(F&& f) const {
+    for (const Entry& entry : entries_) {
+      f(entry.elem);
+    }
+  }
+
+  void PrefetchElements() const noexcept {
+    if (!entries_.empty()) {
+      __builtin_prefetch(entries_.data(), 0);
+    }
+  }
+
+  template <typename H, typename F>
+  void Drain(const H& /*hash*/, F&& f) {
+    for (Entry& entry : entries_) {
+      f(std::move(entry.elem), entry.hash);
+    }
+    Clear();
+  }
+
+  void Clear() {
+    std::vector<Entry, EntryAllocator>(entries_.get_allocator())
+        .swap(entries_);
+  }
+
+ private:
+  template <typename K>
+  [[nodiscard]] size_t IndexOf(const K& key, size_t hash) const {
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      if (entries_[i].hash == hash && entries_[i].elem == key) {
+        return i;
+      }
+    }
+    return entries_.size();
+  }
+
+  std::vector<Entry, EntryAllocator> entries_;
+};
+
+// ----------------------------------------------------------------------------
+// Storage policies, passed as the Storage parameter of the hash sets.
+// ----------------------------------------------------------------------------
+struct VectorBucketStorage {
+  template <typename T, typename Allocator = std::allocator<T>>
+  using Bucket = VectorBucket<T, Allocator>;
+};
+
+template <size_t N = 4>
+struct InlineBucketStorage {
+  template <typename T, typename Allocator = std::allocator<T>>
+  using Bucket = InlineBucket<T, N, Allocator>;
+};
+
+struct CachedHashBucketStorage {
+  template <typename T, typename Allocator = std::allocator<T>>
+  using Bucket = CachedHashBucket<T, Allocator>;
+};
+
+#endif  // BUCKET_STORAGE_H
@@ -0,0 +1,122 @@
+#ifndef BULK_LOAD_H
+#define BULK_LOAD_H
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "src/parallel_rehash.h"
+
+// ============================================================================
+// Bulk load
+// ----------------------------------------------------------------------------
+// Every set can be built from a span of elements in one pass, instead of
+// one Add() after another:
+//  - The table is sized once, for all the elements, so that it does not
+//    resize on the way (see table_sizing.h), and built before the set is
+//    published to any other thread, so that it is filled without locks.
+//  - The chaining sets hash the elements on several threads, partition them
+//    by the range of buckets they fall into, and fill each range on a thread
+//    of its own, the way a parallel rehash does (see parallel_rehash.h).
+//    Nothing is parallelized below the set's parallel rehash threshold.
+//  - With BulkKeys::kDistinct the caller promises that no element repeats,
+//    and nothing is checked for duplicates. With kMayRepeat every element is
+//    looked up in its bucket first, as Add() would, and later copies of an
+//    element are dropped.
+// ============================================================================
+
+// Whether the elements of a bulk load may repeat.
+enum class BulkKeys {
+  kDistinct,   // the caller guarantees that every element is distinct
+  kMayRepeat,  // repeated elements are detected and dropped
+};
+
+// ----------------------------------------------------------------------------
+// Inserts |elems| into the empty |buckets|, indexed by HashPolicy, on up to
+// |num_workers| threads, and returns how many were inserted. Nobody else may
+// use the buckets meanwhile.
+// ----------------------------------------------------------------------------
+template <typename HashPolicy, typename T, typename Buckets>
+size_t BulkFill(std::span<const T> elems, BulkKeys keys, Buckets& buckets,
+                size_t num_workers) {
+  const size_t n = elems.size();
+  const size_t capacity = buckets.size();
+  const auto insert = [&](size_t i, size_t h) {
+    auto& bucket = buckets[HashPolicy::Index(h, capacity)];
+    if (keys == BulkKeys::kMayRepeat && bucket.Contains(elems[i], h)) {
+      return false;
+    }
+    bucket.Insert(elems[i], h);
+    return true;
+  };
+
+  if (num_workers <= 1 || n == 0) {
+    size_t inserted = 0;
+    for (size_t i = 0; i < n; ++i) {
+      inserted += insert(i, HashPolicy::Hash(elems[i])) ? 1u : 0u;
+    }
+    return inserted;
+  }
+
+  // Worker w (see ForEachWorker() in parallel_rehash.h) reads elements
+  // [w * n / workers, (w + 1) * n / workers) and fills group w, the buckets
+  // [w * group_size, (w + 1) * group_size).
+  const size_t workers = num_workers;
+  const size_t group_size = (capacity + workers - 1) / workers;
+  const size_t groups = (capacity + group_size - 1) / group_size;
+  const auto slice_begin = [&](size_t worker) { return worker * n / workers; };
+  const auto group_of = [&](size_t h) {
+    return HashPolicy::Index(h, capacity) / group_size;
+  };
+
+  // Hash every element and count, per worker, how many fall into each group.
+  std::vector<size_t> hashes(n);
+  std::vector<size_t> offsets(workers * groups);
+  ForEachWorker(workers, [&](size_t worker) {
+    for (size_t i = slice_begin(worker); i < slice_begin(worker + 1); ++i) {
+      hashes[i] = HashPolicy::Hash(elems[i]);
+      ++offsets[worker * groups + group_of(hashes[i])];
+    }
+  });
+
+  // Turn the counts into where each worker writes its part of each group.
+  // Within a group, the elements keep their input order, so that the first
+  // copy of a repeated element is the one kept.
+  std::vector<size_t> group_begin(groups + 1);
+  size_t position = 0;
+  for (size_t group = 0; group < groups; ++group) {
+    group_begin[group] = position;
+    for (size_t worker = 0; worker < workers; ++worker) {
+      const size_t count = offsets[worker * groups + group];
+      offsets[worker * groups + group] = position;
+      position += count;
+    }
+  }
+  group_begin[groups] = position;
+
+  std::vector<size_t> order(n);
+  ForEachWorker(workers, [&](size_t worker) {
+    for (size_t i = slice_begin(worker); i < slice_begin(worker + 1); ++i) {
+      order[offsets[worker * groups + group_of(hashes[i])]++] = i;
+    }
+  });
+
+  // Each group only touches its own buckets, and is filled by a worker of
+  // its own.
+  std::vector<size_t> inserted(groups);
+  ForEachWorker(groups, [&](size_t group) {
+    size_t count = 0;
+    for (size_t k = group_begin[group]; k < group_begin[group + 1]; ++k) {
+      count += insert(order[k], hashes[order[k]]) ? 1u : 0u;
+    }
+    inserted[group] = count;
+  });
+
+  size_t total = 0;
+  for (const size_t count : inserted) {
+    total += count;
+  }
+  return total;
+}
+
+#endif  // BULK_LOAD_H
@@ -0,0 +1,15 @@
+#ifndef CACHE_LINE_H
+#define CACHE_LINE_H
+
+#include <cstddef>
+
+// Size of the unit of cache coherence: data written by different threads
+// should live at least this far apart to avoid false sharing.
+//
+// This is what std::hardware_destructive_interference_size reports on the
+// x86-64 and AArch64 targets we build for. A fixed constant is used instead
+// because that value may change with -mtune, which would silently change the
+// layout of every structure that is aligned to it.
+inline constexpr size_t kCacheLineSize = 64;
+
+#endif  // CACHE_LINE_H
@@ -1,10 +1,38 @@
 #include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_cuckoo.h"
+#include "src/hash_set_lock_free.h"
 #include "src/hash_set_refinable.h"
 #include "src/hash_set_sequential.h"
+#include "src/hash_set_sharded.h"
 #include "src/hash_set_striped.h"
+#include "src/lock_policy.h"
 
 namespace check_all {
 
+static_assert(HashSet<HashSetBase<int>, int>);
+static_assert(HashSet<HashSetCoarseGrained<int>, int>);
+static_assert(HashSet<HashSetCoarseGrainedRW<int>, int>);
+static_assert(HashSet<HashSetCuckoo<int>, int>);
+static_assert(HashSet<HashSetLockFree<int>, int>);
+static_assert(HashSet<HashSetRefinable<int>, int>);
+static_assert(HashSet<HashSetSequential<int>, int>);
+static_assert(HashSet<HashSetSharded<int, HashSetStriped<int>>, int>);
+static_assert(HashSet<HashSetStriped<int>, int>);
+static_assert(
+    HashSet<HashSetRefinable<int, VectorBucketStorage, ModuloHashPolicy<>,
+                             std::allocator<int>, SpinParkLockPolicy>,
+            int>);
+static_assert(
+    HashSet<HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                           std::allocator<int>, SpinParkLockPolicy>,
+            int>);
+
+static_assert(ReportsSetStats<HashSetCoarseGrained<int>>);
+static_assert(ReportsSetStats<HashSetRefinable<int>>);
+static_assert(ReportsSetStats<HashSetSequential<int>>);
+static_assert(ReportsSetStats<HashSetSharded<int, HashSetStriped<int>>>);
+static_assert(ReportsSetStats<HashSetStriped<int>>);
+
 void Placeholder();
 
 void Placeholder() {
@@ -16,6 +44,22 @@ void Placeholder() {
     (void)hs.Contains(1);
   }
 
+  {
+    HashSetCuckoo<int> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetLockFree<int> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
   {
     HashSetRefinable<int> hs(16);
     hs.Add(1);
@@ -0,0 +1,210 @@
+#ifndef CHECKS_LINEARIZABILITY_H
+#define CHECKS_LINEARIZABILITY_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <set>
+#include <span>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// Linearizability of set histories
+// ----------------------------------------------------------------------------
+// A history records, for every operation a thread ran on a set, when it was
+// invoked, when it returned and what it returned. The history is
+// linearizable if every operation can be given a point between its
+// invocation and its response at which it took effect, such that the
+// results are those of running the operations one at a time in that order.
+//  - Linearizability is local (Herlihy & Wing, 1990): a history is
+//    linearizable if and only if the operations on each object are. A set of
+//    keys is a collection of independent objects, one present-or-absent flag
+//    per key, so every key is checked on its own, which keeps the searches
+//    small.
+//  - Each key is checked with the search of Wing & Gong (1993): linearize
+//    some operation that no pending operation returned before, check its
+//    result, and backtrack on a mismatch. Configurations already explored,
+//    how far each thread got and whether the key is present, are
+//    remembered, as Lowe proposes ("Testing for linearizability", 2017), so
+//    the search stays linear in the history for any realistic interleaving.
+//  - A batch operation is several single-element operations, all invoked
+//    when the batch was and returning when it did (see hash_set_base.h). A
+//    batch must not name a key twice, since its entries for one key would
+//    then be ordered by the batch, and not only by their times.
+// Size() is not linearized; callers compare it with the flags at quiescence.
+// ============================================================================
+namespace linearizability {
+
+enum class SetOp : uint8_t { kContains, kAdd, kRemove };
+
+// One single-element operation of a history.
+struct SetEvent {
+  uint64_t invoke;    // Clock::Now() before the call
+  uint64_t response;  // Clock::Now() after it returned
+  size_t key;
+  SetOp op;
+  bool result;
+};
+
+// The operations of one thread, in the order it ran them.
+using History = std::vector<SetEvent>;
+
+// ----------------------------------------------------------------------------
+// Logical clock shared by the threads of a run. The stamps are taken with a
+// relaxed read-modify-write, so that the clock adds no happens-before edges
+// between the threads that would hide their races from ThreadSanitizer; all
+// read-modify-writes of the clock are still totally ordered, and on x86,
+// where each is a full barrier, they order the operations as they happened.
+// ----------------------------------------------------------------------------
+class Clock {
+ public:
+  uint64_t Now() noexcept {
+    return now_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> now_{0};
+};
+
+// The operations on one key that could not be linearized: the first few
+// operations of each thread that the longest linearization left pending.
+struct Violation {
+  static constexpr size_t kEventsPerThread = 4;
+
+  size_t key = 0;
+  std::vector<std::pair<size_t, SetEvent>> events;  // thread, event
+};
+
+namespace internal {
+
+// Applies |event| to the flag |present|, and returns whether its result is
+// the one the set should have returned.
+inline bool Apply(const SetEvent& event, bool& present) noexcept {
+  switch (event.op) {
+    case SetOp::kContains:
+      return event.result == present;
+    case SetOp::kAdd: {
+      const bool added = !present;
+      present = true;
+      return event.result == added;
+    }
+    case SetOp::kRemove: {
+      const bool removed = present;
+      present = false;
+      return event.result == removed;
+    }
+  }
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Searches for a linearization of the operations on one key, given as one
+// list per thread in program order, starting from an absent key. On failure
+// returns how far each thread got in the longest linearization found.
+// ----------------------------------------------------------------------------
+inline std::optional<std::vector<size_t>> SearchKey(
+    const std::vector<std::vector<SetEvent>>& threads) {
+  struct Configuration {
+    std::vector<size_t> next;  // per thread, its first pending operation
+    bool present;
+  };
+  const size_t num_threads = threads.size();
+  std::set<std::pair<std::vector<size_t>, bool>> explored;
+  std::vector<Configuration> pending = {
+      {std::vector<size_t>(num_threads, 0), false}};
+  std::vector<size_t> deepest = pending.front().next;
+  size_t deepest_depth = 0;
+
+  while (!pending.empty()) {
+    const Configuration configuration = std::move(pending.back());
+    pending.pop_back();
+
+    // Only an operation invoked before every pending operation returned can
+    // take effect first.
+    uint64_t first_response = std::numeric_limits<uint64_t>::max();
+    size_t depth = 0;
+    for (size_t t = 0; t < num_threads; ++t) {
+      depth += configuration.next[t];
+      if (configuration.next[t] < threads[t].size()) {
+        first_response = std::min(first_response,
+                                  threads[t][configuration.next[t]].response);
+      }
+    }
+    if (first_response == std::numeric_limits<uint64_t>::max()) {
+      return std::nullopt;  // every operation is linearized
+    }
+    if (depth > deepest_depth) {
+      deepest = configuration.next;
+      deepest_depth = depth;
+    }
+
+    for (size_t t = 0; t < num_threads; ++t) {
+      if (configuration.next[t] == threads[t].size()) {
+        continue;
+      }
+      const SetEvent& event = threads[t][configuration.next[t]];
+      bool present = configuration.present;
+      if (event.invoke > first_response || !Apply(event, present)) {
+        continue;
+      }
+      Configuration successor{configuration.next, present};
+      ++successor.next[t];
+      if (explored.emplace(successor.next, present).second) {
+        pending.push_back(std::move(successor));
+      }
+    }
+  }
+  return deepest;
+}
+
+}  // namespace internal
+
+// ----------------------------------------------------------------------------
+// Checks the histories of all threads of a run on keys in [0, key_range),
+// every key being absent at the start. Returns the first key whose
+// operations cannot be linearized, if any.
+// ----------------------------------------------------------------------------
+inline std::optional<Violation> CheckSetHistories(
+    std::span<const History> histories, size_t key_range) {
+  // Per key, the operations of each thread that touched it.
+  std::vector<std::vector<size_t>> threads_of_key(key_range);
+  std::vector<std::vector<std::vector<SetEvent>>> events_of_key(key_range);
+  for (size_t thread = 0; thread < histories.size(); ++thread) {
+    for (const SetEvent& event : histories[thread]) {
+      auto& threads = threads_of_key[event.key];
+      if (threads.empty() || threads.back() != thread) {
+        threads.push_back(thread);
+        events_of_key[event.key].emplace_back();
+      }
+      events_of_key[event.key].back().push_back(event);
+    }
+  }
+
+  for (size_t key = 0; key < key_range; ++key) {
+    const auto& threads = events_of_key[key];
+    const std::optional<std::vector<size_t>> stuck =
+        internal::SearchKey(threads);
+    if (!stuck) {
+      continue;
+    }
+    Violation violation;
+    violation.key = key;
+    for (size_t t = 0; t < threads.size(); ++t) {
+      const size_t end = std::min(
+          threads[t].size(), (*stuck)[t] + Violation::kEventsPerThread);
+      for (size_t i = (*stuck)[t]; i < end; ++i) {
+        violation.events.emplace_back(threads_of_key[key][t], threads[t][i]);
+      }
+    }
+    return violation;
+  }
+  return std::nullopt;
+}
+
+}  // namespace linearizability
+
+#endif  // CHECKS_LINEARIZABILITY_H
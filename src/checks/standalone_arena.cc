@@ -0,0 +1,60 @@
+#include <vector>
+
+#include "src/arena.h"
+#include "src/bucket_storage.h"
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_striped.h"
+
+namespace check_arena {
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    Arena arena;
+    (void)arena.Allocate(16, alignof(int));
+    (void)arena.ReservedBytes();
+    std::vector<int, ArenaAllocator<int>> elems{ArenaAllocator<int>(arena)};
+    elems.push_back(1);
+  }
+
+  {
+    HashSetSequential<int, VectorBucketStorage, ModuloHashPolicy<>,
+                      ArenaAllocator<int>>
+        hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetCoarseGrained<int, InlineBucketStorage<>, ModuloHashPolicy<>,
+                         ArenaAllocator<int>>
+        hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                   ArenaAllocator<int>>
+        hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetRefinable<int, InlineBucketStorage<>, ModuloHashPolicy<>,
+                     ArenaAllocator<int>>
+        hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Contains(1);
+  }
+}
+
+}  // namespace check_arena
@@ -0,0 +1,17 @@
+#include "src/bucket_probe.h"
+
+namespace check_bucket_probe {
+
+void Placeholder();
+
+void Placeholder() {
+  const int ints[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  (void)BucketProbe<int>::Find(ints, 8, 5);
+  (void)BucketProbe<int>::FindInline<8>(ints, 6, 5);
+
+  const long longs[2] = {1, 2};
+  (void)BucketProbe<long>::Find(longs, 2, 2L);
+  (void)BucketProbe<long>::FindInline<2>(longs, 1, 2L);
+}
+
+}  // namespace check_bucket_probe
@@ -0,0 +1,53 @@
+#include "src/bucket_storage.h"
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_striped.h"
+
+namespace check_bucket_storage {
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    HashSetCoarseGrained<int, InlineBucketStorage<>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetRefinable<int, InlineBucketStorage<>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetSequential<int, InlineBucketStorage<>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetStriped<int, InlineBucketStorage<8>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetSequential<int, CachedHashBucketStorage> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+}
+
+}  // namespace check_bucket_storage
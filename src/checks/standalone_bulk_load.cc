@@ -0,0 +1,21 @@
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "src/bucket_storage.h"
+#include "src/bulk_load.h"
+#include "src/hash_policy.h"
+
+namespace check_bulk_load {
+
+void Placeholder();
+
+void Placeholder() {
+  const std::vector<int> elems = {1, 2, 3, 2};
+  std::vector<VectorBucketStorage::Bucket<int, std::allocator<int>>> buckets(
+      8);
+  (void)BulkFill<ModuloHashPolicy<>>(std::span<const int>(elems),
+                                     BulkKeys::kMayRepeat, buckets, 2);
+}
+
+}  // namespace check_bulk_load
@@ -1,4 +1,10 @@
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
 #include "src/hash_set_coarse_grained.h"
+#include "src/lock_policy.h"
 
 namespace check_coarse_grained {
 
@@ -10,6 +16,35 @@ void Placeholder() {
   hs.Remove(1);
   (void)hs.Size();
   (void)hs.Contains(1);
+  hs.SetParallelRehashThreshold(0);
+  const std::vector<int> batch = {1, 2, 3};
+  (void)hs.AddMany(batch);
+  (void)hs.ContainsMany(batch);
+  (void)hs.RemoveMany(batch);
+  hs.SetShrinkLoadFactor(0.5);
+  hs.Reserve(100);
+  hs.SaveSnapshot("check_coarse_grained.snapshot");
+  hs.Compact();
+  (void)hs.BucketCount();
+
+  HashSetCoarseGrained<int> bulk(batch, BulkKeys::kDistinct);
+  (void)bulk.Contains(2);
+
+  // Reader-writer global locks.
+  static_assert(SharedLockable<std::shared_mutex>);
+  static_assert(!SharedLockable<std::mutex>);
+  HashSetCoarseGrainedRW<int> rw(16);
+  rw.Add(1);
+  (void)rw.Contains(1);
+  (void)rw.ContainsMany(batch);
+  (void)rw.Size();
+  rw.Remove(1);
+  HashSetCoarseGrainedRW<int, VectorBucketStorage, ModuloHashPolicy<>,
+                         std::allocator<int>, SpinParkLockPolicy>
+      spin_rw(16);
+  spin_rw.Add(1);
+  (void)spin_rw.Contains(1);
+  (void)spin_rw.Stats();
 }
 
 }  // namespace check_coarse_grained
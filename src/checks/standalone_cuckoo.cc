@@ -0,0 +1,49 @@
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "src/hash_policy.h"
+#include "src/hash_set_cuckoo.h"
+#include "src/lock_policy.h"
+
+namespace check_cuckoo {
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    HashSetCuckoo<int> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+    (void)hs.SlotCount();
+    (void)hs.LoadFactor();
+    const std::vector<int> batch = {1, 2, 3};
+    (void)hs.AddMany(batch);
+    (void)hs.ContainsMany(batch);
+    (void)hs.RemoveMany(batch);
+  }
+
+  {
+    HashSetCuckoo<int, ModuloHashPolicy<>,
+                  PaddedLockPolicy<SpinParkLockPolicy>>
+        hs(16, 4);
+    hs.Add(1);
+    (void)hs.Contains(1);
+    hs.Remove(1);
+    hs.SetShrinkLoadFactor(0.2);
+    hs.Reserve(100);
+    hs.Compact();
+  }
+
+  {
+    const std::vector<int> elems = {1, 2, 3, 2};
+    HashSetCuckoo<int> distinct(std::span<const int>(elems).first(3),
+                                BulkKeys::kDistinct);
+    HashSetCuckoo<int> repeated(elems, BulkKeys::kMayRepeat, 16, 4);
+    (void)repeated.Contains(2);
+  }
+}
+
+}  // namespace check_cuckoo
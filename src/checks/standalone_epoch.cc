@@ -0,0 +1,17 @@
+#include "src/epoch.h"
+
+namespace check_epoch {
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    EpochGuard guard;
+    EpochGuard nested;
+  }
+  EpochDomain::Global().Retire(new int(1));
+  EpochDomain::Global().TryReclaim();
+  (void)EpochDomain::Global().PendingCount();
+}
+
+}  // namespace check_epoch
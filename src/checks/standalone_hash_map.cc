@@ -0,0 +1,135 @@
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "src/bucket_storage.h"
+#include "src/hash_map.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_refinable.h"
+#include "src/lock_policy.h"
+
+namespace check_hash_map {
+
+using StringPolicy = ModuloHashPolicy<StringHash>;
+
+static_assert(HeterogeneousKey<MapLookup<int>, MapEntry<int, int>,
+                               MapHashPolicy<int, int, ModuloHashPolicy<>>>);
+static_assert(
+    HeterogeneousKey<MapLookup<std::string_view>, MapEntry<std::string, int>,
+                     MapHashPolicy<std::string, int, StringPolicy>>);
+static_assert(!HeterogeneousKey<
+              MapLookup<const char*>, MapEntry<std::string, int>,
+              MapHashPolicy<std::string, int, ModuloHashPolicy<>>>);
+
+// ForEach() is only there when the set has one.
+template <typename Map>
+concept VisitsEntries = requires(Map& map) {
+  map.ForEach([](int /*key*/, int /*value*/) {});
+};
+static_assert(VisitsEntries<HashMapStriped<int, int>>);
+static_assert(VisitsEntries<HashMapRefinable<int, int>>);
+static_assert(!VisitsEntries<HashMapSequential<int, int>>);
+static_assert(!VisitsEntries<HashMapCoarseGrained<int, int>>);
+
+void Placeholder();
+
+// Every operation of a map, on int keys.
+template <typename Map>
+void UseMap(Map& map) {
+  map.Insert(1, 10);
+  map.InsertOrAssign(1, 11);
+  map.Upsert(2, [](int& value) { ++value; });
+  (void)map.ComputeIfAbsent(3, [] { return 30; });
+  const std::optional<int> value = map.Find(1);
+  (void)value;
+  int copy = 0;
+  (void)map.Find(2, [&copy](const int& found) { copy = found; });
+  (void)map.Contains(3);
+  map.Erase(3);
+  (void)map.Size();
+}
+
+void Placeholder() {
+  {
+    HashMapSequential<int, int> map(16);
+    UseMap(map);
+    map.Reserve(64);
+    map.Compact();
+  }
+
+  {
+    HashMapCoarseGrained<int, int> map(16);
+    UseMap(map);
+  }
+
+  {
+    HashMapCoarseGrainedRW<int, int> map(16);
+    UseMap(map);
+  }
+
+  {
+    HashMapStriped<int, int> map(16);
+    UseMap(map);
+    size_t count = 0;
+    map.ForEach([&count](int /*key*/, int /*value*/) { ++count; });
+  }
+
+  {
+    // Entries of two ints are read optimistically by the set's Contains(),
+    // so the bucket stores modified entries back whole.
+    HashMapStriped<int, int, InlineBucketStorage<4>> map(16);
+    UseMap(map);
+  }
+
+  {
+    HashMapStriped<int, int, VectorBucketStorage, ModuloHashPolicy<>,
+                   std::allocator<MapEntry<int, int>>, SpinParkLockPolicy>
+        map(16);
+    UseMap(map);
+  }
+
+  {
+    HashMapRefinable<int, int> map(16);
+    UseMap(map);
+    size_t count = 0;
+    map.ForEach([&count](int /*key*/, int /*value*/) { ++count; });
+  }
+
+  {
+    HashMapRefinable<int, int, InlineBucketStorage<>> map(
+        16, ResizeMode::kIncremental);
+    UseMap(map);
+  }
+
+  {
+    // std::string keys, looked up by std::string_view.
+    HashMapStriped<std::string, std::string, CachedHashBucketStorage,
+                   StringPolicy>
+        map(16);
+    const std::string_view key = "key";
+    map.Insert(std::string(key), "value");
+    map.InsertOrAssign("key", "other");
+    map.Upsert("count", [](std::string& value) { value += "+"; });
+    (void)map.ComputeIfAbsent("lazy", [] { return std::string("made"); });
+    (void)map.Find(key);
+    (void)map.Find("literal");
+    size_t length = 0;
+    (void)map.Find(key, [&length](const std::string& value) {
+      length = value.size();
+    });
+    (void)map.Contains(key);
+    map.Erase(key);
+  }
+
+  {
+    // Without a transparent hasher, other key types convert to K.
+    HashMapRefinable<std::string, int> map(16);
+    map.Insert("key", 1);
+    (void)map.Find("key");
+    (void)map.Contains("key");
+    map.Erase("key");
+  }
+}
+
+}  // namespace check_hash_map
@@ -0,0 +1,64 @@
+#include "src/bucket_storage.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_lock_free.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_striped.h"
+
+namespace check_hash_policy {
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    HashSetCoarseGrained<int, VectorBucketStorage, MaskHashPolicy<>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetRefinable<int, VectorBucketStorage, FastRangeHashPolicy<>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetSequential<int, InlineBucketStorage<>,
+                      MaskHashPolicy<StdHash, FibonacciMixer>>
+        hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetStriped<int, VectorBucketStorage, MaskHashPolicy<>> hs(16, 6, 2);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  {
+    HashSetLockFree<int, FastRangeHashPolicy<>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+  }
+
+  static_assert(MaskHashPolicy<>::Capacity(5) == 8);
+  static_assert(FastRangeHashPolicy<>::Index(~size_t{0}, 10) == 9);
+  static_assert(ModuloHashPolicy<>::Index(13, 10) == 3);
+  static_assert(ModuloHashPolicy<>::FoldIndex(13, 20, 10) == 3);
+  static_assert(MaskHashPolicy<>::FoldIndex(13, 16, 4) == 1);
+  static_assert(FastRangeHashPolicy<>::FoldIndex(13, 20, 10) == 6);
+}
+
+}  // namespace check_hash_policy
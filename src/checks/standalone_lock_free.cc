@@ -0,0 +1,26 @@
+#include <vector>
+
+#include "src/hash_set_lock_free.h"
+
+namespace check_lock_free {
+
+void Placeholder();
+
+void Placeholder() {
+  HashSetLockFree<int> hs(16);
+  hs.Add(1);
+  hs.Remove(1);
+  (void)hs.Size();
+  (void)hs.Contains(1);
+  hs.SetParallelRehashThreshold(0);
+  hs.SetShrinkLoadFactor(0.125);
+  hs.Reserve(100);
+  hs.Compact();
+  (void)hs.Capacity();
+
+  const std::vector<int> elems = {1, 2, 3, 2};
+  HashSetLockFree<int> bulk(elems, BulkKeys::kMayRepeat);
+  (void)bulk.Contains(2);
+}
+
+}  // namespace check_lock_free
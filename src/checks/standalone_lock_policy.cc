@@ -0,0 +1,50 @@
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+
+#include "src/lock_policy.h"
+
+namespace check_lock_policy {
+
+struct Slot {
+  SpinParkMutex mutex;
+  bool flag;
+};
+
+static_assert(sizeof(LockSlot<SpinParkLockPolicy, Slot>) < kCacheLineSize);
+static_assert(sizeof(LockSlot<PaddedLockPolicy<SpinParkLockPolicy>, Slot>) ==
+              kCacheLineSize);
+static_assert(alignof(LockSlot<PaddedLockPolicy<StdLockPolicy>, Slot>) ==
+              kCacheLineSize);
+static_assert(std::is_same_v<PaddedLockPolicy<StdLockPolicy>::Mutex,
+                             StdLockPolicy::Mutex>);
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    SpinParkLockPolicy::Mutex mutex;
+    {
+      const std::lock_guard<SpinParkLockPolicy::Mutex> lock(mutex);
+    }
+    std::unique_lock<SpinParkLockPolicy::Mutex> lock(mutex, std::try_to_lock);
+    (void)lock.owns_lock();
+  }
+  {
+    SpinParkLockPolicy::SharedMutex mutex;
+    {
+      const std::unique_lock<SpinParkLockPolicy::SharedMutex> lock(mutex);
+    }
+    {
+      const std::shared_lock<SpinParkLockPolicy::SharedMutex> first(mutex);
+      std::shared_lock<SpinParkLockPolicy::SharedMutex> second(
+          mutex, std::try_to_lock);
+      (void)second.owns_lock();
+    }
+    std::unique_lock<SpinParkLockPolicy::SharedMutex> lock(mutex,
+                                                           std::try_to_lock);
+    (void)lock.owns_lock();
+  }
+}
+
+}  // namespace check_lock_policy
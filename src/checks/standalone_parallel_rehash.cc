@@ -0,0 +1,19 @@
+#include <vector>
+
+#include "src/parallel_rehash.h"
+
+namespace check_parallel_rehash {
+
+void Placeholder();
+
+void Placeholder() {
+  std::vector<int> buckets(16);
+  const size_t workers = RehashWorkerCount(100, buckets.size(), 0);
+  ForEachBucketRange(buckets.size(), workers, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      buckets[i] = 1;
+    }
+  });
+}
+
+}  // namespace check_parallel_rehash
@@ -0,0 +1,16 @@
+#include "src/perf_counters.h"
+
+namespace check_perf_counters {
+
+void Placeholder();
+
+void Placeholder() {
+  (void)ReadCycleCounter();
+  PerfCounters counters;
+  (void)counters.Available();
+  counters.Start();
+  const PerfSample sample = counters.Stop();
+  (void)sample.Count(PerfEvent::kInstructions);
+}
+
+}  // namespace check_perf_counters
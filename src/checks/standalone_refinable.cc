@@ -1,15 +1,66 @@
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
 #include "src/hash_set_refinable.h"
+#include "src/lock_policy.h"
 
 namespace check_refinable {
 
 void Placeholder();
 
 void Placeholder() {
-  HashSetRefinable<int> hs(16);
-  hs.Add(1);
-  hs.Remove(1);
-  (void)hs.Size();
-  (void)hs.Contains(1);
+  {
+    HashSetRefinable<int> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+    hs.SetParallelRehashThreshold(0);
+    const std::vector<int> batch = {1, 2, 3};
+    (void)hs.AddMany(batch);
+    (void)hs.ContainsMany(batch);
+    (void)hs.RemoveMany(batch);
+    size_t count = 0;
+    hs.ForEach([&count](int /*elem*/) { ++count; });
+    std::atomic<size_t> parallel_count{0};
+    hs.ForEachParallel(2, [&parallel_count](int /*elem*/) {
+      parallel_count.fetch_add(1, std::memory_order_relaxed);
+    });
+  }
+
+  {
+    HashSetRefinable<int> hs(16, ResizeMode::kIncremental);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+    hs.ForEach([](int /*elem*/) {});
+  }
+
+  {
+    // Spin-then-park bucket locks.
+    HashSetRefinable<int, VectorBucketStorage, ModuloHashPolicy<>,
+                     std::allocator<int>, SpinParkLockPolicy>
+        hs(16, ResizeMode::kIncremental);
+    hs.Add(1);
+    (void)hs.Contains(1);
+    const std::vector<int> batch = {1, 2, 3};
+    (void)hs.ContainsMany(batch);
+    hs.Remove(1);
+    hs.SetShrinkLoadFactor(0.25);
+    hs.Reserve(100);
+    hs.Compact();
+    (void)hs.BucketCount();
+  }
+
+  {
+    const std::vector<int> elems = {1, 2, 3};
+    HashSetRefinable<int> hs(elems, BulkKeys::kDistinct, 16,
+                             ResizeMode::kIncremental);
+    (void)hs.Contains(2);
+  }
 }
 
 }  // namespace check_refinable
@@ -1,3 +1,6 @@
+#include <span>
+#include <vector>
+
 #include "src/hash_set_sequential.h"
 
 namespace check_sequential {
@@ -10,6 +13,19 @@ void Placeholder() {
   hs.Remove(1);
   (void)hs.Size();
   (void)hs.Contains(1);
+  hs.SetParallelRehashThreshold(0);
+  hs.SetShrinkLoadFactor(0.5);
+  hs.Reserve(100);
+  hs.Compact();
+  (void)hs.BucketCount();
+
+  const std::vector<int> elems = {1, 2, 3, 2};
+  HashSetSequential<int> bulk(elems, BulkKeys::kMayRepeat);
+  (void)bulk.Contains(2);
+  HashSetSequential<int> distinct(std::span<const int>(elems).first(3),
+                                  BulkKeys::kDistinct, 16);
+  (void)distinct.Size();
+  (void)distinct.ContainsMany(elems);
 }
 
 }  // namespace check_sequential
@@ -0,0 +1,56 @@
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_striped.h"
+#include "src/set_stats.h"
+
+namespace check_set_stats {
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    SetStats stats;
+    stats.RecordLock(true);
+    stats.RecordProbe(3);
+    stats.RecordResize();
+    {
+      const auto rehash_timer = stats.TimeRehash();
+    }
+    SetStatsSnapshot snapshot;
+    stats.AddTo(snapshot);
+    snapshot.CountBucket(2);
+    (void)snapshot.MeanProbeLength();
+    stats.Reset();
+  }
+
+  {
+    HashSetSequential<int> hs(16);
+    hs.Add(1);
+    (void)hs.Stats();
+    hs.ResetStats();
+  }
+
+  {
+    HashSetCoarseGrained<int> hs(16);
+    hs.Add(1);
+    (void)hs.Stats();
+    hs.ResetStats();
+  }
+
+  {
+    HashSetStriped<int> hs(16);
+    hs.Add(1);
+    (void)hs.Stats();
+    hs.ResetStats();
+  }
+
+  {
+    HashSetRefinable<int> hs(16, ResizeMode::kIncremental);
+    hs.Add(1);
+    (void)hs.Stats();
+    hs.ResetStats();
+  }
+}
+
+}  // namespace check_set_stats
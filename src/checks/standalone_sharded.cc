@@ -0,0 +1,73 @@
+#include <vector>
+
+#include "src/arena.h"
+#include "src/bucket_storage.h"
+#include "src/hash_set_cuckoo.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sharded.h"
+#include "src/hash_set_striped.h"
+#include "src/numa.h"
+
+namespace check_sharded {
+
+void Placeholder();
+
+void Placeholder() {
+  {
+    HashSetSharded<int, HashSetStriped<int>> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+    (void)hs.ShardCount();
+    (void)hs.ShardNode(0);
+    (void)hs.GetShard(0).Size();
+    (void)hs.Stats();
+    hs.ResetStats();
+    const std::vector<int> batch = {1, 2, 3};
+    (void)hs.AddMany(batch);
+    (void)hs.ContainsMany(batch);
+    (void)hs.RemoveMany(batch);
+  }
+
+  {
+    HashSetSharded<int,
+                   HashSetRefinable<int, VectorBucketStorage,
+                                    ModuloHashPolicy<>, ArenaAllocator<int>>>
+        hs(16, 4);
+    hs.Add(1);
+    (void)hs.Contains(1);
+    hs.Remove(1);
+  }
+
+  {
+    HashSetSharded<int, HashSetCuckoo<int>> hs(16, 2);
+    hs.Add(1);
+    (void)hs.Contains(1);
+    hs.Remove(1);
+    hs.SetShrinkLoadFactor(0.2);
+    hs.Reserve(100);
+    hs.Compact();
+  }
+
+  {
+    const std::vector<int> elems = {1, 2, 3, 2};
+    HashSetSharded<int, HashSetStriped<int>> hs(elems, BulkKeys::kMayRepeat,
+                                                16, 2);
+    (void)hs.Contains(2);
+  }
+
+  {
+    (void)NumaNodeCount();
+    (void)PinThreadToNumaNode(0);
+    Arena arena(1, 0);
+    (void)arena.Allocate(16, alignof(int));
+    void* block = AllocateOnNumaNode(4096, kAnyNumaNode);
+    FreeOnNumaNode(block, 4096, kAnyNumaNode);
+    const ScopedNumaMemoryPolicy memory_policy(0);
+    const ScopedNumaNode node(0);
+    (void)ScopedNumaNode::Current();
+  }
+}
+
+}  // namespace check_sharded
@@ -0,0 +1,16 @@
+#include "src/sharded_counter.h"
+
+namespace check_sharded_counter {
+
+void Placeholder();
+
+void Placeholder() {
+  ShardedCounter counter;
+  counter.Increment();
+  counter.Decrement();
+  (void)counter.Size();
+  (void)counter.ApproximateSize();
+  (void)counter.Exceeds(16);
+}
+
+}  // namespace check_sharded_counter
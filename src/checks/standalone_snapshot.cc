@@ -0,0 +1,42 @@
+#include <cstdint>
+#include <span>
+
+#include "src/bucket_storage.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/snapshot.h"
+
+namespace check_snapshot {
+
+void Placeholder();
+
+void Placeholder() {
+  static_assert(SnapshotElement<int>);
+  static_assert(sizeof(SnapshotHeader) % alignof(uint64_t) == 0);
+
+  {
+    HashSetSequential<int, InlineBucketStorage<>, MaskHashPolicy<>> hs(16);
+    hs.Add(1);
+    hs.SaveSnapshot("check_snapshot.bin");
+
+    const MappedSnapshot<int, MaskHashPolicy<>> snapshot("check_snapshot.bin");
+    (void)snapshot.Contains(1);
+    (void)snapshot.Size();
+    const std::span<const int> bucket = snapshot.Bucket(0);
+    (void)bucket;
+
+    HashSetRefinable<int, CachedHashBucketStorage, MaskHashPolicy<>> adopted(
+        snapshot, ResizeMode::kIncremental);
+    (void)adopted.Contains(1);
+    adopted.SaveSnapshot("check_snapshot.bin");
+  }
+
+  {
+    SnapshotWriter<int, ModuloHashPolicy<>> writer("check_snapshot.bin");
+    writer.AddBucket(VectorBucketStorage::Bucket<int>());
+    writer.Finish();
+  }
+}
+
+}  // namespace check_snapshot
@@ -0,0 +1,65 @@
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "src/bucket_storage.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_striped.h"
+
+namespace check_string_keys {
+
+using StringPolicy = ModuloHashPolicy<StringHash>;
+
+void Placeholder();
+
+void Placeholder() {
+  const std::string_view key = "key";
+
+  {
+    HashSetSequential<std::string, CachedHashBucketStorage, StringPolicy> hs(
+        16);
+    hs.Add(std::string("key"));
+    hs.Add(key);
+    hs.Add("literal");
+    (void)hs.Contains(key);
+    (void)hs.Contains("literal");
+    (void)hs.Contains(std::string("key"));
+    hs.Remove(key);
+    hs.Remove("literal");
+  }
+
+  {
+    HashSetCoarseGrained<std::string, VectorBucketStorage, StringPolicy> hs(
+        16);
+    hs.Add(key);
+    (void)hs.Contains(key);
+    hs.Remove(key);
+  }
+
+  {
+    HashSetStriped<std::string, CachedHashBucketStorage, StringPolicy> hs(16);
+    hs.Add(key);
+    (void)hs.Contains(key);
+    hs.Remove(key);
+  }
+
+  {
+    HashSetRefinable<std::string, InlineBucketStorage<>, StringPolicy> hs(16);
+    hs.Add(key);
+    (void)hs.Contains(key);
+    hs.Remove(key);
+  }
+
+  {
+    // Without a transparent hasher, other key types convert to T.
+    HashSetSequential<std::string> hs(16);
+    hs.Add("key");
+    (void)hs.Contains("key");
+    hs.Remove("key");
+  }
+}
+
+}  // namespace check_string_keys
@@ -1,15 +1,77 @@
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
 #include "src/hash_set_striped.h"
+#include "src/lock_policy.h"
 
 namespace check_striped {
 
 void Placeholder();
 
 void Placeholder() {
-  HashSetStriped<int> hs(16);
-  hs.Add(1);
-  hs.Remove(1);
-  (void)hs.Size();
-  (void)hs.Contains(1);
+  {
+    HashSetStriped<int> hs(16);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+    hs.SetParallelRehashThreshold(0);
+    const std::vector<int> batch = {1, 2, 3};
+    (void)hs.AddMany(batch);
+    (void)hs.ContainsMany(batch);
+    (void)hs.RemoveMany(batch);
+    size_t count = 0;
+    hs.ForEach([&count](int /*elem*/) { ++count; });
+    std::atomic<size_t> parallel_count{0};
+    hs.ForEachParallel(2, [&parallel_count](int /*elem*/) {
+      parallel_count.fetch_add(1, std::memory_order_relaxed);
+    });
+  }
+
+  {
+    HashSetStriped<int> hs(16, 4, 3);
+    hs.Add(1);
+    hs.Remove(1);
+    (void)hs.Size();
+    (void)hs.Contains(1);
+    (void)hs.StripeCount();
+    hs.SetShrinkLoadFactor(0.5);
+    hs.Reserve(100);
+    hs.SaveSnapshot("check_striped.snapshot");
+    hs.Compact();
+    (void)hs.BucketCount();
+  }
+
+  {
+    const std::vector<int> elems = {1, 2, 3, 2};
+    HashSetStriped<int> hs(elems, BulkKeys::kMayRepeat, 16, 4, 3);
+    (void)hs.Contains(2);
+    (void)hs.StripeCount();
+  }
+
+  {
+    // Optimistic Contains.
+    HashSetStriped<int, InlineBucketStorage<>> hs(16, 4, 1);
+    hs.Add(1);
+    (void)hs.Contains(1);
+    (void)hs.Contains(2);
+    const std::vector<int> lookups = {1, 2, 3};
+    (void)hs.ContainsMany(lookups);
+    hs.Remove(1);
+    (void)hs.LoadFactor();
+  }
+
+  {
+    // Spin-then-park stripe locks.
+    HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                   std::allocator<int>, SpinParkLockPolicy>
+        hs(16, 4, 1);
+    hs.Add(1);
+    (void)hs.Contains(1);
+    hs.Remove(1);
+  }
 }
 
 }  // namespace check_striped
@@ -0,0 +1,20 @@
+#include "src/table_sizing.h"
+
+namespace check_table_sizing {
+
+void Placeholder();
+
+void Placeholder() {
+  TableSizing sizing(16, 4.0, 2);
+  sizing.SetShrinkLoadFactor(sizing.MaxShrinkLoadFactor());
+  (void)sizing.ShrinkLoadFactor();
+  sizing.Reserve(1000);
+  (void)sizing.ReserveCapacity(0, 16);
+  (void)sizing.MinCapacity();
+  (void)sizing.CanShrink(512, 4);
+  (void)sizing.ShrinkBound(512);
+  (void)sizing.ShouldShrink(10, 512);
+  (void)sizing.FitCapacity(10, 512, 4);
+}
+
+}  // namespace check_table_sizing
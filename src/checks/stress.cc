@@ -0,0 +1,499 @@
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/arena.h"
+#include "src/bucket_storage.h"
+#include "src/checks/linearizability.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_cuckoo.h"
+#include "src/hash_set_lock_free.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sharded.h"
+#include "src/hash_set_striped.h"
+#include "src/lock_policy.h"
+#include "src/table_sizing.h"
+#include "src/workload.h"
+
+// ============================================================================
+// Concurrent stress and linearizability check
+// ----------------------------------------------------------------------------
+// Runs every concurrent set through rounds of random operations on a few
+// threads, records what each operation returned and when (see
+// linearizability.h), and checks that the histories are linearizable. Meant
+// to be run in the sanitizer builds (USE_SANITIZER=tsan or asan), which turn
+// the races and use-after-frees that the histories may not show into
+// failures, and registered as a test for that.
+//
+// Each round starts from a set with the smallest capacity and few stripes,
+// so that the set resizes, grows its stripes and rehashes in parallel
+// throughout:
+//  - The workers alternate between waves of mostly Add() and mostly
+//    Remove(), so that the table grows and shrinks again, and half of their
+//    keys fall on a few hot keys, so that the same buckets are contended.
+//    Some operations are batches (AddMany(), RemoveMany(), ContainsMany()).
+//  - A maintenance thread meanwhile calls Compact() and Reserve() on sets
+//    that size their table, reads LoadFactor() without a lock where sets
+//    offer it, and traverses sets that have ForEach(), checking that no
+//    element is visited twice.
+//  - At quiescence, every key is looked up once more as part of the history,
+//    and Size() and a final ForEach() have to agree with those lookups.
+// ============================================================================
+namespace stress {
+namespace {
+
+using linearizability::History;
+using linearizability::SetEvent;
+using linearizability::SetOp;
+
+struct Options {
+  size_t threads = 4;
+  size_t ops = 20000;  // per worker and round
+  size_t rounds = 3;
+  size_t key_range = 4096;
+  size_t hot_keys = 16;
+  uint64_t seed = 1;
+  std::vector<std::string> implementations;  // empty means all
+};
+
+// Operations per wave of mostly Add() or mostly Remove().
+inline constexpr size_t kWaveLength = 1024;
+inline constexpr size_t kMaxBatchSize = 16;
+inline constexpr uint64_t kBatchPercent = 10;
+
+template <typename S>
+concept Traversable = requires(S& hash_set, void (*f)(int)) {
+  hash_set.ForEach(f);
+  hash_set.ForEachParallel(size_t{2}, f);
+};
+
+template <typename S>
+concept ReportsLoadFactor = requires(const S& hash_set) {
+  { hash_set.LoadFactor() } -> std::convertible_to<double>;
+};
+
+template <typename S>
+concept RehashesInParallel = requires(S& hash_set, size_t n) {
+  hash_set.SetParallelRehashThreshold(n);
+};
+
+// Whether the rounds run so far found a problem, and which.
+class Failures {
+ public:
+  void Add(const std::string& failure) {
+    if (!failed_.exchange(true)) {
+      first_ = failure;
+    }
+  }
+  [[nodiscard]] bool Any() const { return failed_.load(); }
+  [[nodiscard]] const std::string& First() const { return first_; }
+
+ private:
+  std::atomic<bool> failed_{false};
+  std::string first_;  // written once, by whoever set |failed_|
+};
+
+std::string Describe(const linearizability::Violation& violation) {
+  static constexpr const char* kOpNames[] = {"Contains", "Add", "Remove"};
+  std::ostringstream out;
+  out << "operations on key " << violation.key << " are not linearizable;"
+      << " pending when the search got stuck:";
+  for (const auto& [thread, event] : violation.events) {
+    out << "\n    thread " << thread << ": "
+        << kOpNames[static_cast<size_t>(event.op)] << " -> "
+        << (event.result ? "true" : "false") << " in [" << event.invoke << ", "
+        << event.response << "]";
+  }
+  return out.str();
+}
+
+// Visits the set with ForEach() or ForEachParallel() and returns how many
+// elements were visited, reporting keys that are out of range or visited
+// twice. |visited| is cleared first.
+template <Traversable S>
+size_t Traverse(S& hash_set, size_t num_workers, const Options& options,
+                std::vector<std::atomic<bool>>& visited, Failures& failures) {
+  for (std::atomic<bool>& flag : visited) {
+    flag.store(false, std::memory_order_relaxed);
+  }
+  std::atomic<size_t> count{0};
+  const auto visit = [&](int elem) {
+    const auto key = static_cast<size_t>(elem);
+    if (elem < 0 || key >= options.key_range) {
+      failures.Add("ForEach() visited " + std::to_string(elem) +
+                   ", which was never added");
+    } else if (visited[key].exchange(true, std::memory_order_relaxed)) {
+      failures.Add("ForEach() visited " + std::to_string(elem) + " twice");
+    }
+    count.fetch_add(1, std::memory_order_relaxed);
+  };
+  if (num_workers == 1) {
+    hash_set.ForEach(visit);
+  } else {
+    hash_set.ForEachParallel(num_workers, visit);
+  }
+  return count.load(std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+// Body of one worker: runs |options.ops| random operations and records them.
+// ----------------------------------------------------------------------------
+template <typename S>
+void WorkerBody(S& hash_set, const Options& options, uint64_t seed,
+                const std::atomic<bool>& start, linearizability::Clock& clock,
+                History& history) {
+  workload::Random random(seed);
+  while (!start.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  const auto draw_key = [&]() {
+    const uint64_t range =
+        random.Next() % 2 == 0 ? options.hot_keys : options.key_range;
+    return static_cast<size_t>(random.Next() % range);
+  };
+  // 50% Add() and 20% Remove() in waves that grow the set, the other way
+  // round in those that shrink it, and 30% Contains().
+  const auto draw_op = [&](size_t i) {
+    const uint64_t adds = (i / kWaveLength) % 2 == 0 ? 50 : 20;
+    const uint64_t r = random.Next() % 100;
+    return r < adds ? SetOp::kAdd
+           : r < 70 ? SetOp::kRemove
+                    : SetOp::kContains;
+  };
+
+  std::vector<int> batch;
+  for (size_t i = 0; i < options.ops; ++i) {
+    const SetOp op = draw_op(i);
+    if (random.Next() % 100 >= kBatchPercent) {
+      const size_t key = draw_key();
+      const int elem = static_cast<int>(key);
+      const uint64_t invoke = clock.Now();
+      const bool result = op == SetOp::kAdd      ? hash_set.Add(elem)
+                          : op == SetOp::kRemove ? hash_set.Remove(elem)
+                                                 : hash_set.Contains(elem);
+      history.push_back({invoke, clock.Now(), key, op, result});
+      continue;
+    }
+
+    // A batch of distinct keys.
+    batch.clear();
+    const size_t batch_size = 1 + random.Next() % kMaxBatchSize;
+    for (size_t j = 0; j < batch_size; ++j) {
+      const int elem = static_cast<int>(draw_key());
+      if (std::find(batch.begin(), batch.end(), elem) == batch.end()) {
+        batch.push_back(elem);
+      }
+    }
+    const uint64_t invoke = clock.Now();
+    const std::vector<bool> results = op == SetOp::kAdd
+                                          ? hash_set.AddMany(batch)
+                                      : op == SetOp::kRemove
+                                          ? hash_set.RemoveMany(batch)
+                                          : hash_set.ContainsMany(batch);
+    const uint64_t response = clock.Now();
+    for (size_t j = 0; j < batch.size(); ++j) {
+      history.push_back({invoke, response, static_cast<size_t>(batch[j]), op,
+                         results[j]});
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Body of the maintenance thread: resizes and traverses the set until the
+// workers are done.
+// ----------------------------------------------------------------------------
+template <typename S>
+void MaintenanceBody(S& hash_set, const Options& options, uint64_t seed,
+                     const std::atomic<bool>& done, Failures& failures) {
+  workload::Random random(seed);
+  std::vector<std::atomic<bool>> visited(options.key_range);
+  while (!done.load(std::memory_order_acquire)) {
+    switch (random.Next() % 5) {
+      case 0:
+        if constexpr (SizesTable<S>) {
+          hash_set.Compact();
+        }
+        break;
+      case 1:
+        if constexpr (SizesTable<S>) {
+          hash_set.Reserve(random.Next() % (options.key_range / 8));
+        }
+        break;
+      case 2:
+        if constexpr (ReportsLoadFactor<S>) {
+          const double load_factor = hash_set.LoadFactor();
+          if (!(load_factor >= 0)) {
+            failures.Add("LoadFactor() returned " +
+                         std::to_string(load_factor));
+          }
+        }
+        break;
+      default:
+        if constexpr (Traversable<S>) {
+          (void)Traverse(hash_set, 1 + random.Next() % 2, options, visited,
+                         failures);
+        }
+        break;
+    }
+    std::this_thread::yield();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Runs one round on the set |make| builds, and adds what went wrong to
+// |failures|. Returns the number of operations checked.
+// ----------------------------------------------------------------------------
+template <typename S>
+size_t RunRound(const std::function<std::unique_ptr<S>()>& make,
+                const Options& options, uint64_t seed, Failures& failures) {
+  const std::unique_ptr<S> hash_set = make();
+  if constexpr (RehashesInParallel<S>) {
+    hash_set->SetParallelRehashThreshold(0);
+  }
+
+  linearizability::Clock clock;
+  // One history per worker, and one for the final lookups.
+  std::vector<History> histories(options.threads + 1);
+  std::atomic<bool> start{false};
+  std::atomic<bool> done{false};
+  {
+    std::vector<std::thread> threads;
+    for (size_t id = 0; id < options.threads; ++id) {
+      threads.emplace_back([&, id]() {
+        WorkerBody(*hash_set, options, seed * 0x100000001b3ULL + id, start,
+                   clock, histories[id]);
+      });
+    }
+    std::thread maintenance;
+    if constexpr (SizesTable<S> || Traversable<S> || ReportsLoadFactor<S>) {
+      maintenance = std::thread([&]() {
+        MaintenanceBody(*hash_set, options, seed, done, failures);
+      });
+    }
+    start.store(true, std::memory_order_release);
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    done.store(true, std::memory_order_release);
+    if (maintenance.joinable()) {
+      maintenance.join();
+    }
+  }
+
+  // At quiescence.
+  History& final_lookups = histories.back();
+  size_t present = 0;
+  for (size_t key = 0; key < options.key_range; ++key) {
+    const uint64_t invoke = clock.Now();
+    const bool found = hash_set->Contains(static_cast<int>(key));
+    final_lookups.push_back(
+        {invoke, clock.Now(), key, SetOp::kContains, found});
+    present += found ? 1u : 0u;
+  }
+  if (hash_set->Size() != present) {
+    failures.Add("Size() is " + std::to_string(hash_set->Size()) + ", but " +
+                 std::to_string(present) + " keys are present");
+  }
+  if constexpr (Traversable<S>) {
+    std::vector<std::atomic<bool>> visited(options.key_range);
+    const size_t count = Traverse(*hash_set, 1, options, visited, failures);
+    for (const SetEvent& lookup : final_lookups) {
+      if (visited[lookup.key].load(std::memory_order_relaxed) !=
+          lookup.result) {
+        failures.Add("ForEach() and Contains() disagree on key " +
+                     std::to_string(lookup.key));
+        break;
+      }
+    }
+    if (count != present) {
+      failures.Add("ForEach() visited " + std::to_string(count) +
+                   " elements, but " + std::to_string(present) +
+                   " keys are present");
+    }
+  }
+
+  if (const auto violation =
+          linearizability::CheckSetHistories(histories, options.key_range)) {
+    failures.Add(Describe(*violation));
+  }
+  size_t checked = 0;
+  for (const History& history : histories) {
+    checked += history.size();
+  }
+  return checked;
+}
+
+struct Implementation {
+  std::string name;
+  // Runs the rounds, and returns whether all of them passed.
+  std::function<bool(const Options&)> run;
+};
+
+// ----------------------------------------------------------------------------
+// An implementation whose sets are built as S(args...).
+// ----------------------------------------------------------------------------
+template <typename S, typename... Args>
+Implementation Stress(std::string name, Args... args) {
+  const std::function<std::unique_ptr<S>()> make = [args...]() {
+    return std::make_unique<S>(args...);
+  };
+  return {name, [name, make](const Options& options) {
+            Failures failures;
+            size_t checked = 0;
+            for (size_t round = 0;
+                 round < options.rounds && !failures.Any(); ++round) {
+              checked += RunRound(make, options, options.seed + round,
+                                  failures);
+            }
+            if (failures.Any()) {
+              std::cout << name << ": FAILED: " << failures.First()
+                        << std::endl;
+              return false;
+            }
+            std::cout << name << ": " << checked
+                      << " operations linearizable" << std::endl;
+            return true;
+          }};
+}
+
+void PrintUsage(const char* program) {
+  std::cerr << "Usage: " << program << " [--flag=value ...]\n"
+            << "  --threads=4        worker threads per round\n"
+            << "  --ops=20000        operations per worker and round\n"
+            << "  --rounds=3         rounds per implementation\n"
+            << "  --key_range=4096   keys are drawn from [0, key_range)\n"
+            << "  --hot_keys=16      half the keys come from [0, hot_keys)\n"
+            << "  --seed=1           seed of the first round\n"
+            << "  --impls=a,b,...    implementations to run (default: all)"
+            << std::endl;
+}
+
+bool ParseFlag(const std::string& name, const std::string& value,
+               Options& options) {
+  if (name == "impls") {
+    options.implementations.clear();
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+      if (item.empty()) {
+        return false;
+      }
+      options.implementations.push_back(item);
+    }
+    return !options.implementations.empty();
+  }
+  if (value.empty() || value.find_first_not_of("0123456789") !=
+                           std::string::npos) {
+    return false;
+  }
+  const size_t number = std::stoul(value);
+  if (name == "threads") {
+    options.threads = number;
+  } else if (name == "ops") {
+    options.ops = number;
+  } else if (name == "rounds") {
+    options.rounds = number;
+  } else if (name == "key_range") {
+    options.key_range = number;
+  } else if (name == "hot_keys") {
+    options.hot_keys = number;
+  } else if (name == "seed") {
+    options.seed = number;
+  } else {
+    return false;
+  }
+  return options.threads > 0 && options.key_range >= 8 &&
+         options.key_range <= size_t{1} << 30 && options.hot_keys > 0 &&
+         options.hot_keys <= options.key_range;
+}
+
+bool ParseArgs(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || equals == std::string::npos ||
+        !ParseFlag(arg.substr(2, equals - 2), arg.substr(equals + 1),
+                   options)) {
+      std::cerr << argv[0] << ": invalid argument '" << arg << "'"
+                << std::endl;
+      PrintUsage(argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+}  // namespace stress
+
+int main(int argc, char** argv) {
+  stress::Options options;
+  if (!stress::ParseArgs(argc, argv, options)) {
+    return 1;
+  }
+
+  using stress::Stress;
+  // Few stripes that grow often, and the smallest initial capacity, so that
+  // every round resizes.
+  const size_t capacity = 1;
+  const size_t stripes = 2;
+  const size_t stripe_growths = 4;
+  const size_t shards = 2;
+  const std::vector<stress::Implementation> implementations = {
+      Stress<HashSetCoarseGrained<int>>("coarse_grained", capacity),
+      Stress<HashSetCoarseGrainedRW<int>>("coarse_grained_rw", capacity),
+      Stress<HashSetCoarseGrainedRW<int, VectorBucketStorage,
+                                    ModuloHashPolicy<>, std::allocator<int>,
+                                    SpinParkLockPolicy>>(
+          "coarse_grained_rw_spin", capacity),
+      Stress<HashSetStriped<int>>("striped", capacity, stripes,
+                                  stripe_growths),
+      Stress<HashSetStriped<int, VectorBucketStorage, MaskHashPolicy<>>>(
+          "striped_mask", capacity, stripes, stripe_growths),
+      Stress<HashSetStriped<int, InlineBucketStorage<4>>>(
+          "striped_optimistic", capacity, stripes, stripe_growths),
+      Stress<HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                            ArenaAllocator<int>>>(
+          "striped_arena", capacity, stripes, stripe_growths),
+      Stress<HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                            std::allocator<int>,
+                            PaddedLockPolicy<SpinParkLockPolicy>>>(
+          "striped_spin_padded", capacity, stripes, stripe_growths),
+      Stress<HashSetRefinable<int>>("refinable", capacity,
+                                    ResizeMode::kStopTheWorld),
+      Stress<HashSetRefinable<int>>("refinable_incremental", capacity,
+                                    ResizeMode::kIncremental),
+      Stress<HashSetRefinable<int, VectorBucketStorage, ModuloHashPolicy<>,
+                              ArenaAllocator<int>, SpinParkLockPolicy>>(
+          "refinable_arena_spin", capacity, ResizeMode::kIncremental),
+      Stress<HashSetLockFree<int>>("lock_free", capacity),
+      Stress<HashSetCuckoo<int>>("cuckoo", capacity, stripes),
+      Stress<HashSetSharded<int, HashSetStriped<int>>>("sharded_striped",
+                                                       capacity, shards),
+      Stress<HashSetSharded<int, HashSetRefinable<int>>>("sharded_refinable",
+                                                         capacity, shards),
+  };
+
+  bool passed = true;
+  for (const stress::Implementation& implementation : implementations) {
+    if (!options.implementations.empty() &&
+        std::find(options.implementations.begin(),
+                  options.implementations.end(),
+                  implementation.name) == options.implementations.end()) {
+      continue;
+    }
+    passed = implementation.run(options) && passed;
+  }
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+#include "src/cache_line.h"
+
+// ============================================================================
+// Epoch-based memory reclamation
+// ----------------------------------------------------------------------------
+//  - A thread pins the process-wide epoch domain for as long as it may hold
+//    raw pointers into a shared structure, by keeping an EpochGuard alive.
+//    Guards nest; only the outermost one pins.
+//  - An object that has been unlinked, so that no new reader can reach it, is
+//    handed to EpochDomain::Retire() instead of being deleted. It is freed
+//    once the global epoch has advanced twice since, which proves that every
+//    thread that could still see it has unpinned in between.
+//  - The epoch advances during Retire() and TryReclaim(), once every pinned
+//    thread has observed the current epoch.
+//  - Pinning is one CAS on a cache-line-padded record that normally only the
+//    pinning thread touches; no shared reference count is involved.
+//    Retirement takes a mutex, so it suits objects that are retired rarely,
+//    such as whole hash tables.
+//  - Records are claimed per pin rather than per thread, so threads that
+//    exit leave nothing behind. Unreclaimed objects live until a later
+//    Retire() or TryReclaim() frees them.
+// ============================================================================
+class EpochDomain {
+ public:
+  // --------------------------------------------------------------------------
+  // The domain shared by every structure in the process. It is never
+  // destroyed, so objects retired at exit stay reachable.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] static EpochDomain& Global() {
+    static EpochDomain* const domain = new EpochDomain();
+    return *domain;
+  }
+
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  // --------------------------------------------------------------------------
+  // Schedules |deleter(ptr)| for when no pinned thread can still reach |ptr|.
+  // |ptr| must already be unreachable for threads that pin from now on.
+  // --------------------------------------------------------------------------
+  void Retire(void* ptr, void (*deleter)(void*)) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      retired_.push_back(
+          {ptr, deleter, global_epoch_.load(std::memory_order_seq_cst)});
+    }
+    TryReclaim();
+  }
+
+  template <typename U>
+  void Retire(U* ptr) {
+    Retire(ptr, [](void* p) { delete static_cast<U*>(p); });
+  }
+
+  // --------------------------------------------------------------------------
+  // Advances the epoch as far as the pinned threads allow and frees every
+  // object that has become unreachable.
+  // --------------------------------------------------------------------------
+  void TryReclaim() {
+    std::vector<Retired> ready;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // Two steps are enough to free everything retired so far.
+      if (TryAdvance()) {
+        TryAdvance();
+      }
+      const uint64_t epoch = global_epoch_.load(std::memory_order_relaxed);
+      const auto is_ready = [epoch](const Retired& retired) {
+        return retired.epoch + 2 <= epoch;
+      };
+      std::copy_if(retired_.begin(), retired_.end(), std::back_inserter(ready),
+                   is_ready);
+      retired_.erase(
+          std::remove_if(retired_.begin(), retired_.end(), is_ready),
+          retired_.end());
+    }
+    // Deleters run unlocked, so they may retire further objects.
+    for (const Retired& retired : ready) {
+      retired.deleter(retired.ptr);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the number of retired objects that have not been freed yet.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t PendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return retired_.size();
+  }
+
+ private:
+  friend class EpochGuard;
+
+  // A record holds kUnpinned, or the epoch its owner observed when pinning.
+  static constexpr uint64_t kUnpinned = 0;
+
+  struct alignas(kCacheLineSize) Record {
+    std::atomic<uint64_t> epoch{kUnpinned};
+    Record* next = nullptr;  // immutable once the record is published
+  };
+
+  struct Retired {
+    void* ptr;
+    void (*deleter)(void*);
+    uint64_t epoch;  // global epoch when retired
+  };
+
+  struct ThreadState {
+    Record* record = nullptr;  // the record pinned by this thread
+    Record* hint = nullptr;    // the record this thread pinned last
+    size_t depth = 0;          // number of live guards
+  };
+
+  EpochDomain() = default;
+
+  [[nodiscard]] static ThreadState& LocalState() noexcept {
+    thread_local ThreadState state;
+    return state;
+  }
+
+  void Pin() {
+    ThreadState& local = LocalState();
+    if (local.depth++ > 0) {
+      return;
+    }
+
+    uint64_t epoch = global_epoch_.load(std::memory_order_seq_cst);
+    Record* record = local.hint;
+    if (record == nullptr || !TryClaim(*record, epoch)) {
+      record = Claim(epoch);
+    }
+    // The epoch may have advanced before the claim became visible; publish
+    // the newer one until the two agree, as an advance would otherwise
+    // overlook this thread.
+    uint64_t current;
+    while ((current = global_epoch_.load(std::memory_order_seq_cst)) !=
+           epoch) {
+      epoch = current;
+      record->epoch.store(epoch, std::memory_order_seq_cst);
+    }
+    local.record = record;
+    local.hint = record;
+  }
+
+  void Unpin() noexcept {
+    ThreadState& local = LocalState();
+    if (--local.depth > 0) {
+      return;
+    }
+    local.record->epoch.store(kUnpinned, std::memory_order_release);
+    local.record = nullptr;
+  }
+
+  static bool TryClaim(Record& record, uint64_t epoch) noexcept {
+    uint64_t expected = kUnpinned;
+    return record.epoch.load(std::memory_order_relaxed) == kUnpinned &&
+           record.epoch.compare_exchange_strong(expected, epoch,
+                                                std::memory_order_seq_cst);
+  }
+
+  // Claims any unpinned record, or publishes a new one.
+  Record* Claim(uint64_t epoch) {
+    for (Record* record = records_.load(std::memory_order_acquire);
+         record != nullptr; record = record->next) {
+      if (TryClaim(*record, epoch)) {
+        return record;
+      }
+    }
+
+    auto* record = new Record();
+    record->epoch.store(epoch, std::memory_order_relaxed);
+    record->next = records_.load(std::memory_order_relaxed);
+    while (!records_.compare_exchange_weak(record->next, record,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed)) {
+    }
+    return record;
+  }
+
+  // Moves the global epoch forward if every pinned thread has observed it.
+  // Must be called with |mutex_| held.
+  bool TryAdvance() {
+    const uint64_t epoch = global_epoch_.load(std::memory_order_seq_cst);
+    for (Record* record = records_.load(std::memory_order_acquire);
+         record != nullptr; record = record->next) {
+      const uint64_t observed = record->epoch.load(std::memory_order_seq_cst);
+      if (observed != kUnpinned && observed != epoch) {
+        return false;
+      }
+    }
+    global_epoch_.store(epoch + 1, std::memory_order_seq_cst);
+    return true;
+  }
+
+  alignas(kCacheLineSize) std::atomic<uint64_t> global_epoch_{1};
+  std::atomic<Record*> records_{nullptr};  // never shrinks
+  mutable std::mutex mutex_;               // guards retired_, epoch advances
+  std::vector<Retired> retired_;
+};
+
+// ============================================================================
+// Pins the global epoch domain for the lifetime of the guard.
+// ============================================================================
+class EpochGuard {
+ public:
+  EpochGuard() { EpochDomain::Global().Pin(); }
+  ~EpochGuard() { EpochDomain::Global().Unpin(); }
+
+  EpochGuard(const EpochGuard&) = delete;
+  EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+#endif  // EPOCH_H
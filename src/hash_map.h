@@ -0,0 +1,334 @@
+#ifndef HASH_MAP_H
+#define HASH_MAP_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+#include "src/bucket_storage.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_striped.h"
+#include "src/lock_policy.h"
+#include "src/table_sizing.h"
+
+// ============================================================================
+// Hash maps
+// ----------------------------------------------------------------------------
+// HashMap stores MapEntry<K, V> elements in one of the hash sets, so a map
+// has its set's bucket layout, locking and resizing. Entries are equal when
+// their keys are, and MapHashPolicy hashes an entry by its key alone, so the
+// set can look an entry up by a MapLookup of its key (a HeterogeneousKey, see
+// hash_policy.h).
+//  - Every operation is a single lookup in the set, under the lock the set
+//    takes for the key. Find() copies the value out, or passes it to a
+//    callback, while that lock is held. InsertOrAssign(), Upsert() and
+//    ComputeIfAbsent() keep it held from the lookup to the update or the
+//    insertion, so each of them is atomic.
+//  - Callbacks run under that lock. They must not call into the map, and
+//    should be short, as they hold up every other key under the same lock.
+//  - Values are never reachable outside the lock: there are no references
+//    or iterators into the map, as a resize may move the entries at any time.
+//  - Keys can be looked up by the key type, or by any key the KeyPolicy
+//    hashes transparently, e.g. std::string_view for std::string keys with
+//    StringHash.
+//
+//   HashMapSequential        - over HashSetSequential; not thread-safe.
+//   HashMapCoarseGrained     - over HashSetCoarseGrained, and the RW variant
+//                              over HashSetCoarseGrainedRW.
+//   HashMapStriped           - over HashSetStriped.
+//   HashMapRefinable         - over HashSetRefinable.
+//
+// The set must provide Visit() and AddOrModify(). The lock-free and cuckoo
+// sets do not: the former has no lock to update a value under, and the
+// latter's own bucket type has no element access yet.
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// A key to look up, as a set of MapEntry elements sees it: it compares equal
+// to the entries whose key equals |key|. It only refers to the key, for the
+// length of one operation.
+// ----------------------------------------------------------------------------
+template <typename Q>
+struct MapLookup {
+  const Q& key;
+};
+
+// ----------------------------------------------------------------------------
+// A key and its value. Entries are the same element of a set when their keys
+// are, so the set holds every key at most once.
+// ----------------------------------------------------------------------------
+template <typename K, typename V>
+struct MapEntry {
+  K key;
+  V value;
+
+  friend bool operator==(const MapEntry& a, const MapEntry& b) {
+    return a.key == b.key;
+  }
+
+  template <typename Q>
+  friend bool operator==(const MapEntry& entry, const MapLookup<Q>& lookup) {
+    return entry.key == lookup.key;
+  }
+};
+
+// ----------------------------------------------------------------------------
+// Hash policy of a set of MapEntry<K, V>: entries, and lookups of the keys
+// |KeyPolicy| accepts, hash like their keys do with it. It also sizes and
+// indexes the table.
+// ----------------------------------------------------------------------------
+template <typename K, typename V, typename KeyPolicy>
+struct MapHashPolicy {
+  static constexpr bool kTransparent = true;
+
+  [[nodiscard]] static size_t Hash(const MapEntry<K, V>& entry) {
+    return KeyPolicy::Hash(entry.key);
+  }
+
+  template <LookupKey<K, KeyPolicy> Q>
+  [[nodiscard]] static size_t Hash(const MapLookup<Q>& lookup) {
+    return KeyPolicy::Hash(lookup.key);
+  }
+
+  [[nodiscard]] static constexpr size_t Capacity(size_t n) noexcept {
+    return KeyPolicy::Capacity(n);
+  }
+
+  [[nodiscard]] static constexpr size_t Index(size_t h,
+                                              size_t capacity) noexcept {
+    return KeyPolicy::Index(h, capacity);
+  }
+
+  [[nodiscard]] static constexpr size_t FoldIndex(size_t index,
+                                                  size_t capacity,
+                                                  size_t divisor) noexcept {
+    return KeyPolicy::FoldIndex(index, capacity, divisor);
+  }
+};
+
+template <typename K, typename V, typename KeyPolicy, typename Set>
+class HashMap {
+  using Entry = MapEntry<K, V>;
+
+ public:
+  // --------------------------------------------------------------------------
+  // Creates the set with |initial_capacity| and any further arguments of its
+  // constructor (a stripe count, a resize mode, ...).
+  // --------------------------------------------------------------------------
+  template <typename... Args>
+  explicit HashMap(size_t initial_capacity, Args&&... args)
+      : set_(initial_capacity, std::forward<Args>(args)...) {}
+
+  HashMap(const HashMap&) = delete;
+  HashMap& operator=(const HashMap&) = delete;
+
+  // --------------------------------------------------------------------------
+  // Maps |key| to |value| if it is not mapped yet. Returns true if the entry
+  // was inserted, false if the key was present (its value is unchanged).
+  // --------------------------------------------------------------------------
+  bool Insert(K key, V value) {
+    return set_.Add(Entry{std::move(key), std::move(value)});
+  }
+
+  // --------------------------------------------------------------------------
+  // Maps |key| to |value|, replacing any value it had. Returns true if the
+  // entry was inserted, false if an existing value was assigned.
+  // --------------------------------------------------------------------------
+  bool InsertOrAssign(K key, V value) {
+    return set_.AddOrModify(
+        MapLookup<K>{key},
+        [&] { return Entry{std::move(key), std::move(value)}; },
+        [&](Entry& entry) { entry.value = std::move(value); });
+  }
+
+  // --------------------------------------------------------------------------
+  // Calls |update(value)| on the value of |key|, inserting a
+  // value-initialized V for it first if it is absent. Returns true if the
+  // entry was inserted. E.g. counting occurrences:
+  //   counts.Upsert(word, [](int& count) { ++count; });
+  // --------------------------------------------------------------------------
+  template <typename F>
+  bool Upsert(K key, F&& update) {
+    return set_.AddOrModify(
+        MapLookup<K>{key},
+        [&] {
+          Entry entry{std::move(key), V()};
+          update(entry.value);
+          return entry;
+        },
+        [&](Entry& entry) { update(entry.value); });
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the value of |key|, mapping it to |make()| first if it is
+  // absent. |make| only runs for an absent key; other threads asking for
+  // the key meanwhile wait for it, and all get the value it made.
+  // --------------------------------------------------------------------------
+  template <typename F>
+  V ComputeIfAbsent(K key, F&& make) {
+    std::optional<V> value;
+    set_.AddOrModify(
+        MapLookup<K>{key},
+        [&] {
+          Entry entry{std::move(key), make()};
+          value.emplace(entry.value);
+          return entry;
+        },
+        [&](Entry& entry) { value.emplace(entry.value); });
+    return *std::move(value);
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns a copy of the value of |key|, or std::nullopt if it is absent.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] std::optional<V> Find(const K& key) { return FindKey(key); }
+
+  template <HeterogeneousKey<K, KeyPolicy> Q>
+  [[nodiscard]] std::optional<V> Find(const Q& key) {
+    return FindKey(key);
+  }
+
+  // --------------------------------------------------------------------------
+  // Calls |f(value)| with the value of |key|, under its lock, and returns
+  // whether the key is present. This reads a large value in place, where
+  // Find(key) would copy it.
+  // --------------------------------------------------------------------------
+  template <typename F>
+  bool Find(const K& key, F&& f) {
+    return FindKey(key, std::forward<F>(f));
+  }
+
+  template <HeterogeneousKey<K, KeyPolicy> Q, typename F>
+  bool Find(const Q& key, F&& f) {
+    return FindKey(key, std::forward<F>(f));
+  }
+
+  // --------------------------------------------------------------------------
+  // Removes the entry of |key|. Returns true if removal occurred.
+  // --------------------------------------------------------------------------
+  bool Erase(const K& key) { return set_.Remove(MapLookup<K>{key}); }
+
+  template <HeterogeneousKey<K, KeyPolicy> Q>
+  bool Erase(const Q& key) {
+    return set_.Remove(MapLookup<Q>{key});
+  }
+
+  [[nodiscard]] bool Contains(const K& key) {
+    return set_.Contains(MapLookup<K>{key});
+  }
+
+  template <HeterogeneousKey<K, KeyPolicy> Q>
+  [[nodiscard]] bool Contains(const Q& key) {
+    return set_.Contains(MapLookup<Q>{key});
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the number of entries.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t Size() const { return set_.Size(); }
+
+  // --------------------------------------------------------------------------
+  // Calls |f(key, value)| for every entry, as the set's ForEach() visits its
+  // elements (see hash_set_striped.h and hash_set_refinable.h). Only maps over
+  // a set with a ForEach() have one.
+  // --------------------------------------------------------------------------
+  template <typename F>
+  void ForEach(F&& f)
+    requires requires(Set& set, void (*visit)(const Entry&)) {
+      set.ForEach(visit);
+    }
+  {
+    set_.ForEach([&f](const Entry& entry) { f(entry.key, entry.value); });
+  }
+
+  // --------------------------------------------------------------------------
+  // Table sizing, passed on to the set (see table_sizing.h).
+  // --------------------------------------------------------------------------
+  void Reserve(size_t num_entries)
+    requires SizesTable<Set>
+  {
+    set_.Reserve(num_entries);
+  }
+
+  void Compact()
+    requires SizesTable<Set>
+  {
+    set_.Compact();
+  }
+
+ private:
+  template <typename Q>
+  [[nodiscard]] std::optional<V> FindKey(const Q& key) {
+    std::optional<V> value;
+    set_.Visit(MapLookup<Q>{key},
+               [&value](const Entry& entry) { value = entry.value; });
+    return value;
+  }
+
+  template <typename Q, typename F>
+  bool FindKey(const Q& key, F&& f) {
+    return set_.Visit(MapLookup<Q>{key},
+                      [&f](const Entry& entry) { f(entry.value); });
+  }
+
+  Set set_;
+};
+
+// ----------------------------------------------------------------------------
+// Maps over the set variants. Storage, KeyPolicy and the locking parameters
+// are those of the set, with KeyPolicy hashing keys rather than elements.
+// ----------------------------------------------------------------------------
+template <typename K, typename V, typename Storage = VectorBucketStorage,
+          typename KeyPolicy = ModuloHashPolicy<>,
+          typename Allocator = std::allocator<MapEntry<K, V>>>
+using HashMapSequential =
+    HashMap<K, V, KeyPolicy,
+            HashSetSequential<MapEntry<K, V>, Storage,
+                              MapHashPolicy<K, V, KeyPolicy>, Allocator>>;
+
+template <typename K, typename V, typename Storage = VectorBucketStorage,
+          typename KeyPolicy = ModuloHashPolicy<>,
+          typename Allocator = std::allocator<MapEntry<K, V>>,
+          typename Mutex = std::mutex>
+using HashMapCoarseGrained =
+    HashMap<K, V, KeyPolicy,
+            HashSetCoarseGrained<MapEntry<K, V>, Storage,
+                                 MapHashPolicy<K, V, KeyPolicy>, Allocator,
+                                 Mutex>>;
+
+template <typename K, typename V, typename Storage = VectorBucketStorage,
+          typename KeyPolicy = ModuloHashPolicy<>,
+          typename Allocator = std::allocator<MapEntry<K, V>>,
+          typename LockPolicy = StdLockPolicy>
+using HashMapCoarseGrainedRW =
+    HashMap<K, V, KeyPolicy,
+            HashSetCoarseGrainedRW<MapEntry<K, V>, Storage,
+                                   MapHashPolicy<K, V, KeyPolicy>, Allocator,
+                                   LockPolicy>>;
+
+template <typename K, typename V, typename Storage = VectorBucketStorage,
+          typename KeyPolicy = ModuloHashPolicy<>,
+          typename Allocator = std::allocator<MapEntry<K, V>>,
+          typename LockPolicy = StdLockPolicy>
+using HashMapStriped =
+    HashMap<K, V, KeyPolicy,
+            HashSetStriped<MapEntry<K, V>, Storage,
+                           MapHashPolicy<K, V, KeyPolicy>, Allocator,
+                           LockPolicy>>;
+
+template <typename K, typename V, typename Storage = VectorBucketStorage,
+          typename KeyPolicy = ModuloHashPolicy<>,
+          typename Allocator = std::allocator<MapEntry<K, V>>,
+          typename LockPolicy = StdLockPolicy>
+using HashMapRefinable =
+    HashMap<K, V, KeyPolicy,
+            HashSetRefinable<MapEntry<K, V>, Storage,
+                             MapHashPolicy<K, V, KeyPolicy>, Allocator,
+                             LockPolicy>>;
+
+#endif  // HASH_MAP_H
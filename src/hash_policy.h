@@ -0,0 +1,231 @@
+#ifndef HASH_POLICY_H
+#define HASH_POLICY_H
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+
+// ============================================================================
+// Hash policies
+// ----------------------------------------------------------------------------
+// The HashPolicy template parameter of a set chooses how an element is hashed
+// and how a hash is reduced to a bucket index. A policy provides:
+//
+//   static size_t Hash(const T& elem)      - the (mixed) hash of an element
+//   static size_t Capacity(size_t n)       - the smallest usable table size
+//                                            that is at least n
+//   static size_t Index(size_t h, size_t capacity)
+//                                          - the bucket of hash h
+//   static size_t FoldIndex(size_t index, size_t capacity, size_t divisor)
+//                                          - Index(h, divisor) for the
+//                                            hashes h in bucket |index| of
+//                                            |capacity|, a multiple of
+//                                            |divisor|
+//   static constexpr bool kTransparent     - whether Hash() also accepts keys
+//                                            of other types than the
+//                                            elements (see HeterogeneousKey)
+//
+// Every policy guarantees that Index(h, m) is a function of Index(h, n)
+// whenever n is a multiple of m, namely FoldIndex(Index(h, n), n, m); it is
+// what lets a grown table be rehashed in disjoint ranges, and lets
+// HashSetStriped map a whole bucket to a single lock stripe. Capacity() must
+// keep every doubling of a usable size usable.
+//
+//   ModuloHashPolicy     - Index = h % capacity, any capacity. With the
+//                          default identity mixer this is plain std::hash.
+//   MaskHashPolicy       - power-of-two capacities, Index = h & (capacity-1).
+//                          The hash is mixed first, as the low bits of
+//                          std::hash<int> are the key itself.
+//   FastRangeHashPolicy  - Lemire's fast range reduction, Index = the high
+//                          word of h * capacity, any capacity. It uses the
+//                          high bits of the hash, so it needs a mixer that
+//                          spreads the low bits upwards.
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Hash functions and mixers
+// ----------------------------------------------------------------------------
+
+// std::hash for any element type.
+struct StdHash {
+  template <typename T>
+  [[nodiscard]] size_t operator()(const T& elem) const {
+    return std::hash<T>{}(elem);
+  }
+};
+
+// Transparent hash for string keys: std::string, std::string_view and string
+// literals with the same characters hash alike, so a set of std::string can
+// be searched by any of them. Like the standard unordered containers, sets
+// only use a hasher for other key types if it declares is_transparent.
+struct StringHash {
+  using is_transparent = void;
+
+  [[nodiscard]] size_t operator()(std::string_view text) const noexcept {
+    return std::hash<std::string_view>{}(text);
+  }
+};
+
+struct IdentityMixer {
+  [[nodiscard]] static constexpr size_t Mix(size_t h) noexcept { return h; }
+};
+
+// The murmur3 64-bit finalizer: every input bit affects every output bit.
+struct Murmur3Mixer {
+  [[nodiscard]] static constexpr size_t Mix(size_t h) noexcept {
+    uint64_t x = static_cast<uint64_t>(h);
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return static_cast<size_t>(x);
+  }
+};
+
+// Fibonacci hashing: one multiplication by 2^64 / phi. The product's high
+// bits are well mixed; folding them down also makes it usable with a mask.
+struct FibonacciMixer {
+  [[nodiscard]] static constexpr size_t Mix(size_t h) noexcept {
+    const uint64_t x = static_cast<uint64_t>(h) * 0x9e3779b97f4a7c15ULL;
+    return static_cast<size_t>(x ^ (x >> 32));
+  }
+};
+
+// ----------------------------------------------------------------------------
+// Policies
+// ----------------------------------------------------------------------------
+template <typename Hasher = StdHash, typename Mixer = IdentityMixer>
+struct ModuloHashPolicy {
+  static constexpr bool kTransparent =
+      requires { typename Hasher::is_transparent; };
+
+  template <typename T>
+  [[nodiscard]] static size_t Hash(const T& elem) {
+    return Mixer::Mix(Hasher{}(elem));
+  }
+
+  [[nodiscard]] static constexpr size_t Capacity(size_t n) noexcept {
+    return n > 0 ? n : 1;
+  }
+
+  [[nodiscard]] static constexpr size_t Index(size_t h,
+                                              size_t capacity) noexcept {
+    return h % capacity;
+  }
+
+  [[nodiscard]] static constexpr size_t FoldIndex(
+      size_t index, size_t /*capacity*/, size_t divisor) noexcept {
+    return index % divisor;
+  }
+};
+
+template <typename Hasher = StdHash, typename Mixer = Murmur3Mixer>
+struct MaskHashPolicy {
+  static constexpr bool kTransparent =
+      requires { typename Hasher::is_transparent; };
+
+  template <typename T>
+  [[nodiscard]] static size_t Hash(const T& elem) {
+    return Mixer::Mix(Hasher{}(elem));
+  }
+
+  [[nodiscard]] static constexpr size_t Capacity(size_t n) noexcept {
+    size_t capacity = 1;
+    while (capacity < n) {
+      capacity *= 2;
+    }
+    return capacity;
+  }
+
+  [[nodiscard]] static constexpr size_t Index(size_t h,
+                                              size_t capacity) noexcept {
+    return h & (capacity - 1);
+  }
+
+  [[nodiscard]] static constexpr size_t FoldIndex(
+      size_t index, size_t /*capacity*/, size_t divisor) noexcept {
+    return index & (divisor - 1);
+  }
+};
+
+template <typename Hasher = StdHash, typename Mixer = FibonacciMixer>
+struct FastRangeHashPolicy {
+  static constexpr bool kTransparent =
+      requires { typename Hasher::is_transparent; };
+
+  template <typename T>
+  [[nodiscard]] static size_t Hash(const T& elem) {
+    return Mixer::Mix(Hasher{}(elem));
+  }
+
+  [[nodiscard]] static constexpr size_t Capacity(size_t n) noexcept {
+    return n > 0 ? n : 1;
+  }
+
+  [[nodiscard]] static constexpr size_t Index(size_t h,
+                                              size_t capacity) noexcept {
+    const auto x = static_cast<uint64_t>(h);
+    const auto n = static_cast<uint64_t>(capacity);
+#if defined(__SIZEOF_INT128__)
+    return static_cast<size_t>((static_cast<__uint128_t>(x) * n) >> 64);
+#else
+    // High word of the 128-bit product, from 32-bit halves.
+    const uint64_t x_lo = x & 0xffffffffULL;
+    const uint64_t x_hi = x >> 32;
+    const uint64_t n_lo = n & 0xffffffffULL;
+    const uint64_t n_hi = n >> 32;
+    const uint64_t lo_lo = x_lo * n_lo;
+    const uint64_t hi_lo = x_hi * n_lo;
+    const uint64_t lo_hi = x_lo * n_hi;
+    const uint64_t cross =
+        (lo_lo >> 32) + (hi_lo & 0xffffffffULL) + (lo_hi & 0xffffffffULL);
+    return static_cast<size_t>(x_hi * n_hi + (hi_lo >> 32) + (lo_hi >> 32) +
+                               (cross >> 32));
+#endif
+  }
+
+  // Bucket i of n holds the hashes with floor(h * n / 2^64) == i, which all
+  // land in floor(i / (n / m)) of m.
+  [[nodiscard]] static constexpr size_t FoldIndex(size_t index,
+                                                  size_t capacity,
+                                                  size_t divisor) noexcept {
+    return index / (capacity / divisor);
+  }
+};
+
+// ----------------------------------------------------------------------------
+// A key of another type than the elements T that a set using |HashPolicy| can
+// look up without building a T, such as a std::string_view among
+// std::strings. The policy must be transparent, hashing every key exactly
+// like the elements it compares equal to.
+// ----------------------------------------------------------------------------
+template <typename K, typename T, typename HashPolicy>
+concept HeterogeneousKey =
+    !std::same_as<std::remove_cvref_t<K>, T> && HashPolicy::kTransparent &&
+    requires(const std::remove_cvref_t<K>& key, const T& elem) {
+      { HashPolicy::Hash(key) } -> std::convertible_to<size_t>;
+      { elem == key } -> std::convertible_to<bool>;
+    };
+
+// The element type itself or a HeterogeneousKey for it.
+template <typename K, typename T, typename HashPolicy>
+concept LookupKey = std::same_as<std::remove_cvref_t<K>, T> ||
+                    HeterogeneousKey<K, T, HashPolicy>;
+
+// ----------------------------------------------------------------------------
+// Function object hashing elements and keys with |HashPolicy|, e.g. for
+// Bucket::Drain() (see bucket_storage.h).
+// ----------------------------------------------------------------------------
+template <typename HashPolicy>
+struct PolicyHasher {
+  template <typename K>
+  [[nodiscard]] size_t operator()(const K& key) const {
+    return HashPolicy::Hash(key);
+  }
+};
+
+#endif  // HASH_POLICY_H
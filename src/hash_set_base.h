@@ -1,7 +1,10 @@
 #ifndef HASH_SET_BASE_H
 #define HASH_SET_BASE_H
 
+#include <concepts>
 #include <cstddef>
+#include <span>
+#include <vector>
 
 template <typename T>
 class HashSetBase {
@@ -21,6 +24,50 @@ class HashSetBase {
 
   // Returns the size of the hash set.
   [[nodiscard]] virtual size_t Size() const = 0;
+
+  // Batch versions of Add, Remove and Contains. Entry i of the result is what
+  // the single-element operation would have returned for |elems[i]|, had the
+  // elements been processed in order. The operations on distinct elements are
+  // not atomic as a whole: implementations may reorder them, e.g. to take
+  // each lock only once per batch.
+  virtual std::vector<bool> AddMany(std::span<const T> elems) {
+    std::vector<bool> results(elems.size());
+    for (size_t i = 0; i < elems.size(); ++i) {
+      results[i] = Add(elems[i]);
+    }
+    return results;
+  }
+
+  virtual std::vector<bool> RemoveMany(std::span<const T> elems) {
+    std::vector<bool> results(elems.size());
+    for (size_t i = 0; i < elems.size(); ++i) {
+      results[i] = Remove(elems[i]);
+    }
+    return results;
+  }
+
+  [[nodiscard]] virtual std::vector<bool> ContainsMany(
+      std::span<const T> elems) {
+    std::vector<bool> results(elems.size());
+    for (size_t i = 0; i < elems.size(); ++i) {
+      results[i] = Contains(elems[i]);
+    }
+    return results;
+  }
+};
+
+// ----------------------------------------------------------------------------
+// The operations every hash set provides, for code that is templated on the
+// set type instead of going through HashSetBase. Each set declares them
+// final, so calls on the concrete type are dispatched statically and can be
+// inlined; HashSetBase<T> itself models the concept with virtual calls.
+// ----------------------------------------------------------------------------
+template <typename S, typename T>
+concept HashSet = requires(S& hash_set, const S& const_hash_set, T elem) {
+  { hash_set.Add(elem) } -> std::convertible_to<bool>;
+  { hash_set.Remove(elem) } -> std::convertible_to<bool>;
+  { hash_set.Contains(elem) } -> std::convertible_to<bool>;
+  { const_hash_set.Size() } -> std::convertible_to<size_t>;
 };
 
 #endif  // HASH_SET_BASE_H
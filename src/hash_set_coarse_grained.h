@@ -1,129 +1,448 @@
 #ifndef HASH_SET_COARSE_GRAINED_H
 #define HASH_SET_COARSE_GRAINED_H
 
-#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <functional>
+#include <concepts>
+#include <filesystem>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "src/arena.h"
+#include "src/batch_order.h"
+#include "src/bucket_storage.h"
+#include "src/bulk_load.h"
+#include "src/hash_policy.h"
 #include "src/hash_set_base.h"
+#include "src/lock_policy.h"
+#include "src/parallel_rehash.h"
+#include "src/set_stats.h"
+#include "src/snapshot.h"
+#include "src/table_sizing.h"
 
 // ============================================================================
 // Coarse-grained (thread-safe) hash set implementation.
 // ----------------------------------------------------------------------------
-//  - Thread-safe using a single global mutex.
-//  - Uses std::vector<std::vector<T>> as the table.
+//  - Thread-safe using a single global lock of type Mutex. If Mutex is a
+//    reader-writer lock (SharedLockable, see lock_policy.h), Contains takes it
+//    shared, so lookups only serialize with writers; HashSetCoarseGrainedRW
+//    picks the SharedMutex of a LockPolicy.
+//  - Uses a std::vector of buckets as the table; the bucket layout is chosen
+//    by the Storage policy (see bucket_storage.h).
+//  - Hashing and bucket indexing are chosen by the HashPolicy (see
+//    hash_policy.h).
+//  - Buckets allocate through the Allocator, which may give every table an
+//    arena of its own (see arena.h).
+//  - Lock contention, probes and resizes are counted in builds with
+//    HASH_SET_STATS (see set_stats.h).
 //  - Simple chaining for collision resolution.
-//  - Automatically resizes when load factor exceeds threshold.
-//  - Concurrency: only one thread may access the table at a time.
+//  - Automatically resizes when load factor exceeds threshold, and shrinks
+//    when it falls below the shrink load factor (see table_sizing.h).
+//  - Concurrency: only one thread may modify the table at a time, and with
+//    an exclusive Mutex only one may access it. Size() reads an atomic
+//    count and takes no lock.
 // ============================================================================
 
-template <typename T>
+template <typename T, typename Storage = VectorBucketStorage,
+          typename HashPolicy = ModuloHashPolicy<>,
+          typename Allocator = std::allocator<T>, typename Mutex = std::mutex>
 class HashSetCoarseGrained : public HashSetBase<T> {
+  using Bucket = typename Storage::template Bucket<T, Allocator>;
+  using BucketAllocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Bucket>;
+  using Table = std::vector<Bucket, BucketAllocator>;
+  using WriteLock = std::unique_lock<Mutex>;
+  using ReadLock = std::conditional_t<SharedLockable<Mutex>,
+                                      std::shared_lock<Mutex>, WriteLock>;
+
  public:
   explicit HashSetCoarseGrained(size_t initial_capacity)
-      : table_(initial_capacity), size_(0) {
+      : table_allocator_(std::make_unique<TableAllocator<Allocator>>()),
+        table_(HashPolicy::Capacity(initial_capacity),
+               BucketAllocator(table_allocator_->Get())),
+        size_(0),
+        sizing_(table_.size(), kLoadFactorThreshold, kGrowthFactor) {
     assert(initial_capacity > 0 && "Initial capacity must be > 0");
   }
 
+  // --------------------------------------------------------------------------
+  // Builds the set from |elems| in one pass, with a table sized for all of
+  // them (see bulk_load.h). The capacity never shrinks below
+  // |initial_capacity|.
+  // --------------------------------------------------------------------------
+  HashSetCoarseGrained(std::span<const T> elems, BulkKeys keys,
+                       size_t initial_capacity = 1)
+      : HashSetCoarseGrained(initial_capacity) {
+    BulkLoad(elems, keys);
+  }
+
   // --------------------------------------------------------------------------
   // Insert an element if not already present.
   // Returns true if insertion occurred, false if element already exists.
   // --------------------------------------------------------------------------
   bool Add(T elem) final {
-    std::lock_guard<std::mutex> lock(mutex_);  // Acquire global lock
+    const auto lock = LockTable();  // Acquire global lock
+    return AddLocked(std::move(elem));
+  }
 
-    size_t index = BucketIndex(elem);
-    auto& bucket = table_[index];
+  // Builds the element from |key| only if it is absent.
+  template <HeterogeneousKey<T, HashPolicy> K>
+    requires std::constructible_from<T, K>
+  bool Add(K&& key) {
+    const auto lock = LockTable();  // Acquire global lock
+    return AddLocked(std::forward<K>(key));
+  }
 
-    // Check if element already exists
-    if (std::find(bucket.begin(), bucket.end(), elem) != bucket.end()) {
+  // --------------------------------------------------------------------------
+  // Remove an element if present.
+  // Returns true if removal occurred, false otherwise.
+  // --------------------------------------------------------------------------
+  bool Remove(T elem) final {
+    const auto lock = LockTable();  // Acquire global lock
+    return RemoveLocked(elem);
+  }
+
+  template <HeterogeneousKey<T, HashPolicy> K>
+  bool Remove(const K& key) {
+    const auto lock = LockTable();  // Acquire global lock
+    return RemoveLocked(key);
+  }
+
+  // --------------------------------------------------------------------------
+  // Check if an element is in the hash set.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool Contains(T elem) final {
+    const auto lock = LockTableForRead();  // Acquire global lock
+    return ContainsLocked(elem);
+  }
+
+  template <HeterogeneousKey<T, HashPolicy> K>
+  [[nodiscard]] bool Contains(const K& key) {
+    const auto lock = LockTableForRead();  // Acquire global lock
+    return ContainsLocked(key);
+  }
+
+  // --------------------------------------------------------------------------
+  // Element access, for maps built on the set (see hash_map.h). Visit()
+  // calls |f| with the element equal to |key|, under the global lock (shared,
+  // if it can be), and returns whether there was one. AddOrModify() applies
+  // |modify| to that element, or inserts |make()| if there is none, and
+  // returns whether it inserted; |modify| must leave the element equal to
+  // |key|, and |make()| may move from it.
+  // --------------------------------------------------------------------------
+  template <LookupKey<T, HashPolicy> K, typename F>
+  bool Visit(const K& key, F&& f) const {
+    const auto lock = LockTableForRead();  // Acquire global lock
+    const size_t h = HashPolicy::Hash(key);
+    const auto& bucket = table_[BucketIndex(h)];
+    stats_.RecordProbe(bucket.Size());
+    const T* elem = bucket.Find(key, h);
+    if (elem == nullptr) {
       return false;
     }
+    f(*elem);
+    return true;
+  }
 
-    // Insert new element
-    bucket.push_back(elem);
-    ++size_;
+  template <LookupKey<T, HashPolicy> K, typename Make, typename Modify>
+  bool AddOrModify(const K& key, Make&& make, Modify&& modify) {
+    const auto lock = LockTable();  // Acquire global lock
+    const size_t h = HashPolicy::Hash(key);
+    auto& bucket = table_[BucketIndex(h)];
+    stats_.RecordProbe(bucket.Size());
+    if (bucket.Modify(key, h, modify)) {
+      return false;
+    }
+
+    T elem = make();
+    assert(HashPolicy::Hash(elem) == h && "make() must build |key|");
+    bucket.Insert(std::move(elem), h);
+    const size_t size = size_.load(std::memory_order_relaxed) + 1;
+    size_.store(size, std::memory_order_relaxed);
 
     // Resize if load factor exceeded
-    if (size_ > kLoadFactorThreshold * table_.size()) {
-      Resize();
+    if (size > kLoadFactorThreshold * table_.size()) {
+      Resize(HashPolicy::Capacity(table_.size() * kGrowthFactor));
     }
     return true;
   }
 
   // --------------------------------------------------------------------------
-  // Remove an element if present.
-  // Returns true if removal occurred, false otherwise.
+  // Return the number of stored elements, without taking the global lock.
   // --------------------------------------------------------------------------
-  bool Remove(T elem) final {
-    std::lock_guard<std::mutex> lock(mutex_);  // Acquire global lock
+  [[nodiscard]] size_t Size() const final {
+    return size_.load(std::memory_order_relaxed);
+  }
 
-    size_t index = BucketIndex(elem);
-    auto& bucket = table_[index];
+  // --------------------------------------------------------------------------
+  // Sets the number of elements from which Resize() rehashes on several
+  // threads (see parallel_rehash.h).
+  // --------------------------------------------------------------------------
+  void SetParallelRehashThreshold(size_t num_elements) {
+    std::lock_guard lock(mutex_);  // Acquire global lock
+    parallel_rehash_threshold_ = num_elements;
+  }
 
-    for (auto it = bucket.begin(); it != bucket.end(); ++it) {
-      if (*it == elem) {
-        bucket.erase(it);
-        --size_;
-        return true;
-      }
+  // --------------------------------------------------------------------------
+  // Table sizing (see table_sizing.h). SetShrinkLoadFactor() sets the load
+  // factor below which Remove() shrinks the table, 0 turning shrinking off.
+  // Compact() rebuilds the table at the smallest capacity that fits the
+  // elements, and Reserve() grows it so that |num_elements| fit without
+  // further growth.
+  // --------------------------------------------------------------------------
+  void SetShrinkLoadFactor(double load_factor) noexcept {
+    sizing_.SetShrinkLoadFactor(load_factor);
+  }
+
+  void Compact() {
+    const auto lock = LockTable();  // Acquire global lock
+    Resize(sizing_.FitCapacity(Size(), table_.size()));
+  }
+
+  void Reserve(size_t num_elements) {
+    const auto lock = LockTable();  // Acquire global lock
+    sizing_.Reserve(num_elements);
+    const size_t capacity = sizing_.ReserveCapacity(0, table_.size());
+    if (capacity != table_.size()) {
+      Resize(capacity);
     }
-    return false;
+  }
+
+  [[nodiscard]] size_t BucketCount() const {
+    const ReadLock lock(mutex_);  // Acquire global lock
+    return table_.size();
   }
 
   // --------------------------------------------------------------------------
-  // Check if an element is in the hash set.
+  // Returns the hot-path statistics and the current bucket lengths (see
+  // set_stats.h).
   // --------------------------------------------------------------------------
-  [[nodiscard]] bool Contains(T elem) final {
-    std::lock_guard lock(mutex_);  // Acquire global lock
+  [[nodiscard]] SetStatsSnapshot Stats() const {
+    const ReadLock lock(mutex_);  // Acquire global lock
+    SetStatsSnapshot snapshot;
+    stats_.AddTo(snapshot);
+    for (const Bucket& bucket : table_) {
+      snapshot.CountBucket(bucket.Size());
+    }
+    return snapshot;
+  }
 
-    const size_t index = BucketIndex(elem);
-    const auto& bucket = table_[index];
+  void ResetStats() noexcept { stats_.Reset(); }
 
-    return std::find(bucket.begin(), bucket.end(), elem) != bucket.end();
+  // --------------------------------------------------------------------------
+  // Writes the table, bucket by bucket, to a snapshot at |path| (see
+  // snapshot.h). The global lock is held (shared, if it can be) until the
+  // file is written, so the snapshot is atomic.
+  // --------------------------------------------------------------------------
+  void SaveSnapshot(const std::filesystem::path& path) const
+    requires SnapshotElement<T>
+  {
+    const ReadLock lock(mutex_);  // Acquire global lock
+    SnapshotWriter<T, HashPolicy> writer(path);
+    for (const Bucket& bucket : table_) {
+      writer.AddBucket(bucket);
+    }
+    writer.Finish();
   }
 
   // --------------------------------------------------------------------------
-  // Return the number of stored elements.
+  // Batch operations: the global lock is taken once for the whole batch
+  // (shared by ContainsMany, if it can be), and buckets are prefetched a few
+  // elements ahead of the probe.
   // --------------------------------------------------------------------------
-  [[nodiscard]] size_t Size() const final {
-    std::lock_guard lock(mutex_);  // Acquire global lock
-    return size_;
+  std::vector<bool> AddMany(std::span<const T> elems) final {
+    const auto lock = LockTable();  // Acquire global lock
+    return ForEachLocked(elems, [this](const T& elem) {
+      return AddLocked(elem);
+    });
+  }
+
+  std::vector<bool> RemoveMany(std::span<const T> elems) final {
+    const auto lock = LockTable();  // Acquire global lock
+    return ForEachLocked(elems, [this](const T& elem) {
+      return RemoveLocked(elem);
+    });
+  }
+
+  [[nodiscard]] std::vector<bool> ContainsMany(
+      std::span<const T> elems) final {
+    const auto lock = LockTableForRead();  // Acquire global lock
+    return ForEachLocked(elems, [this](const T& elem) {
+      return ContainsLocked(elem);
+    });
   }
 
  private:
   // --------------------------------------------------------------------------
-  // Helper: compute the bucket index for an element.
+  // Helpers: acquire the global lock, exclusively or for a lookup, counting
+  // whether it had to be waited for (see set_stats.h).
   // --------------------------------------------------------------------------
-  [[nodiscard]] size_t BucketIndex(const T& elem) const noexcept {
-    return std::hash<T>{}(elem) % table_.size();
+  [[nodiscard]] WriteLock LockTable() const {
+    return AcquireLock<WriteLock>(mutex_, stats_);
+  }
+
+  [[nodiscard]] ReadLock LockTableForRead() const {
+    return AcquireLock<ReadLock>(mutex_, stats_);
   }
 
   // --------------------------------------------------------------------------
-  // Resize the table to double capacity and rehash all elements.
-  // Must be called with the global lock held.
+  // Helpers: the single-element operations, for an element or a
+  // heterogeneous key. The key is hashed once, and the element is built from
+  // it only once it is known to be absent. Must be called with the global
+  // lock held, exclusively except for ContainsLocked().
   // --------------------------------------------------------------------------
-  void Resize() {
-    const size_t new_capacity = table_.size() * 2;
-    std::vector<std::vector<T>> new_table(new_capacity);
+  template <typename K>
+  bool AddLocked(K&& key) {
+    const size_t h = HashPolicy::Hash(key);
+    auto& bucket = table_[BucketIndex(h)];
+    stats_.RecordProbe(bucket.Size());
+
+    // Check if element already exists
+    if (bucket.Contains(key, h)) {
+      return false;
+    }
+
+    // Insert new element
+    bucket.Insert(T(std::forward<K>(key)), h);
+    const size_t size = size_.load(std::memory_order_relaxed) + 1;
+    size_.store(size, std::memory_order_relaxed);
+
+    // Resize if load factor exceeded
+    if (size > kLoadFactorThreshold * table_.size()) {
+      Resize(HashPolicy::Capacity(table_.size() * kGrowthFactor));
+    }
+    return true;
+  }
+
+  template <typename K>
+  bool RemoveLocked(const K& key) {
+    const size_t h = HashPolicy::Hash(key);
+    auto& bucket = table_[BucketIndex(h)];
+    stats_.RecordProbe(bucket.Size());
+    if (!bucket.Erase(key, h)) {
+      return false;
+    }
+    const size_t size = size_.load(std::memory_order_relaxed) - 1;
+    size_.store(size, std::memory_order_relaxed);
 
-    for (const auto& bucket : table_) {
-      for (const auto& elem : bucket) {
-        size_t new_index = std::hash<T>{}(elem) % new_capacity;
-        new_table[new_index].push_back(elem);
+    // shrink if load factor fell below the shrink load factor
+    if (sizing_.ShouldShrink(size, table_.size())) {
+      Resize(sizing_.FitCapacity(size, table_.size()));
+    }
+    return true;
+  }
+
+  template <typename K>
+  [[nodiscard]] bool ContainsLocked(const K& key) const {
+    const size_t h = HashPolicy::Hash(key);
+    const auto& bucket = table_[BucketIndex(h)];
+    stats_.RecordProbe(bucket.Size());
+    return bucket.Contains(key, h);
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: apply |op| to every element of a batch, prefetching the buckets
+  // of upcoming elements. Must be called with the global lock held, as |op|
+  // needs it.
+  // --------------------------------------------------------------------------
+  template <typename Op>
+  std::vector<bool> ForEachLocked(std::span<const T> elems, Op&& op) {
+    std::vector<bool> results(elems.size());
+    for (size_t i = 0; i < elems.size(); ++i) {
+      if (i + kBatchPrefetchDistance < elems.size()) {
+        const T& upcoming = elems[i + kBatchPrefetchDistance];
+        PrefetchForRead(&table_[BucketIndex(HashPolicy::Hash(upcoming))]);
       }
+      results[i] = op(elems[i]);
     }
+    return results;
+  }
 
+  // --------------------------------------------------------------------------
+  // Helper: replace the empty table with one sized for |elems| and filled
+  // with them (see bulk_load.h).
+  // --------------------------------------------------------------------------
+  void BulkLoad(std::span<const T> elems, BulkKeys keys) {
+    const size_t capacity =
+        sizing_.ReserveCapacity(elems.size(), table_.size());
+    auto new_allocator = std::make_unique<TableAllocator<Allocator>>();
+    Table new_table(capacity, BucketAllocator(new_allocator->Get()));
+    const size_t workers =
+        RehashWorkerCount(elems.size(), capacity, parallel_rehash_threshold_);
+    size_.store(BulkFill<HashPolicy>(elems, keys, new_table, workers),
+                std::memory_order_relaxed);
     table_.swap(new_table);
+    table_allocator_.swap(new_allocator);
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: compute the bucket index for a hash.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t BucketIndex(size_t h) const noexcept {
+    return HashPolicy::Index(h, table_.size());
+  }
+
+  // --------------------------------------------------------------------------
+  // Resize the table to |new_capacity| buckets and move all elements over.
+  // Must be called with the global lock held.
+  // --------------------------------------------------------------------------
+  void Resize(size_t new_capacity) {
+    stats_.RecordResize();
+    const auto rehash_timer = stats_.TimeRehash();
+    auto new_allocator = std::make_unique<TableAllocator<Allocator>>();
+    Table new_table(new_capacity, BucketAllocator(new_allocator->Get()));
+
+    // Each worker reads its own range of old buckets, which all map to
+    // different new buckets (see parallel_rehash.h). A smaller table merges
+    // old buckets, so it is filled by this thread alone.
+    const size_t workers =
+        new_capacity < table_.size()
+            ? 1
+            : RehashWorkerCount(Size(), table_.size(),
+                                parallel_rehash_threshold_);
+    ForEachBucketRange(table_.size(), workers, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        table_[i].Drain(PolicyHasher<HashPolicy>(), [&](T&& elem, size_t h) {
+          new_table[HashPolicy::Index(h, new_capacity)].Insert(std::move(elem),
+                                                               h);
+        });
+      }
+    });
+
+    // The old buckets are destroyed before their allocator.
+    table_.swap(new_table);
+    table_allocator_.swap(new_allocator);
   }
 
  private:
-  mutable std::mutex mutex_;           // single global lock
-  std::vector<std::vector<T>> table_;  // hash table
-  size_t size_;                        // total elements
+  mutable Mutex mutex_;        // single global lock
+  // What table_ allocates from; declared first, so that it outlives it.
+  std::unique_ptr<TableAllocator<Allocator>> table_allocator_;
+  Table table_;                // hash table
+  // Total elements; only written with the global lock held exclusively.
+  std::atomic<size_t> size_;
+  size_t parallel_rehash_threshold_ = kDefaultParallelRehashThreshold;
+  TableSizing sizing_;         // shrinking and minimum capacity
+  [[no_unique_address]] mutable SetStats stats_;
   static constexpr size_t kLoadFactorThreshold = 4;
+  static constexpr size_t kGrowthFactor = 2;
 };
 
+// ----------------------------------------------------------------------------
+// HashSetCoarseGrained with the reader-writer lock of |LockPolicy| (see
+// lock_policy.h), for read-mostly workloads.
+// ----------------------------------------------------------------------------
+template <typename T, typename Storage = VectorBucketStorage,
+          typename HashPolicy = ModuloHashPolicy<>,
+          typename Allocator = std::allocator<T>,
+          typename LockPolicy = StdLockPolicy>
+using HashSetCoarseGrainedRW =
+    HashSetCoarseGrained<T, Storage, HashPolicy, Allocator,
+                         typename LockPolicy::SharedMutex>;
+
 #endif  // HASH_SET_COARSE_GRAINED_H
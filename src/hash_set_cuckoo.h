@@ -0,0 +1,618 @@
+#ifndef HASH_SET_CUCKOO_H
+#define HASH_SET_CUCKOO_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "src/bulk_load.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_base.h"
+#include "src/lock_policy.h"
+#include "src/sharded_counter.h"
+#include "src/table_sizing.h"
+
+// ============================================================================
+// Concurrent cuckoo hash set
+// ----------------------------------------------------------------------------
+//  - Open addressing with two candidate buckets per element, each bucket
+//    holding kSlotsPerBucket elements inline. A lookup therefore probes at
+//    most 2 * kSlotsPerBucket slots, however the keys cluster, and the table
+//    fills beyond 90% of its slots before it has to grow.
+//  - The first bucket of an element is HashPolicy::Index() of its hash, the
+//    second that of its hash mixed once more (see hash_policy.h).
+//  - Thread-safe via lock striping, as in HashSetStriped: the lock of bucket
+//    b of a table with n buckets is HashPolicy::FoldIndex(b, n, stripes),
+//    so an element's two locks follow from its hash alone and stay the same
+//    when the table grows. Every operation holds both locks of the element
+//    (taken in stripe order), and an element only ever moves between its
+//    own two buckets with both of their locks held, so nobody sees it in
+//    neither.
+//  - An Add that finds both buckets full searches breadth-first for a
+//    cuckoo path: a chain of at most kMaxPathLength elements, each of which
+//    can move to its other bucket, ending at a bucket with a free slot. The
+//    search holds one stripe lock at a time. The path is then carried out
+//    backwards from the free slot, one move at a time under the locks of
+//    its two buckets, and abandoned for a new search if a move finds its
+//    element gone.
+//  - If no path exists, the table doubles: Resize() takes every stripe lock
+//    and reinserts every element by random-walk cuckoo insertion into the
+//    new table, doubling again in the rare case that fails.
+//  - A Remove that leaves the table below the shrink load factor halves it
+//    the same way, as often as needed (see table_sizing.h). The grow load
+//    factor the sizing works from is the 90% of slots cuckoo tables reach,
+//    and every capacity stays a multiple of the stripe count.
+//  - Stripe locks are of the LockPolicy's Mutex type, in the policy's layout
+//    (see lock_policy.h).
+//  - T is stored in the slots themselves and must be default-constructible.
+// ============================================================================
+template <typename T, typename HashPolicy = MaskHashPolicy<>,
+          typename LockPolicy = StdLockPolicy>
+class HashSetCuckoo : public HashSetBase<T> {
+  using StripeMutex = typename LockPolicy::Mutex;
+  using StripeLock = std::unique_lock<StripeMutex>;
+
+  struct Stripe {
+    StripeMutex mutex;
+  };
+  using StripeSlot = LockSlot<LockPolicy, Stripe>;
+
+ public:
+  static constexpr size_t kSlotsPerBucket = 4;
+
+  // --------------------------------------------------------------------------
+  // Creates a set with at least |initial_capacity| buckets of kSlotsPerBucket
+  // slots, guarded by |num_stripes| locks (rounded up to a stripe count the
+  // HashPolicy supports).
+  // --------------------------------------------------------------------------
+  explicit HashSetCuckoo(size_t initial_capacity,
+                         size_t num_stripes = DefaultStripeCount())
+      : table_(new Table(HashPolicy::Capacity(RoundUpToMultiple(
+            initial_capacity, HashPolicy::Capacity(num_stripes))))),
+        stripes_(HashPolicy::Capacity(num_stripes)),
+        sizing_(LockedTable().buckets.size(),
+                kGrowSlotLoadFactor * static_cast<double>(kSlotsPerBucket),
+                kGrowthFactor) {
+    assert(initial_capacity > 0 && "Initial capacity must be > 0");
+    assert(num_stripes > 0 && "Stripe count must be > 0");
+  }
+
+  // --------------------------------------------------------------------------
+  // Builds the set from |elems|, with a table sized for all of them (see
+  // bulk_load.h). Distinct elements are placed by the random-walk insertion
+  // of a resize, without locks; others are added one by one.
+  // --------------------------------------------------------------------------
+  HashSetCuckoo(std::span<const T> elems, BulkKeys keys,
+                size_t initial_capacity = 1,
+                size_t num_stripes = DefaultStripeCount())
+      : HashSetCuckoo(initial_capacity, num_stripes) {
+    BulkLoad(elems, keys);
+  }
+
+  ~HashSetCuckoo() override { delete table_.load(std::memory_order_relaxed); }
+
+  HashSetCuckoo(const HashSetCuckoo&) = delete;
+  HashSetCuckoo& operator=(const HashSetCuckoo&) = delete;
+
+  // --------------------------------------------------------------------------
+  // Default stripe count: more locks per hardware thread than HashSetStriped
+  // uses, as cuckoo path searches take many locks in turn.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] static size_t DefaultStripeCount() noexcept {
+    const size_t hardware_threads =
+        std::max(1u, std::thread::hardware_concurrency());
+    return hardware_threads * kStripesPerThread;
+  }
+
+  // --------------------------------------------------------------------------
+  // Inserts an element if it does not already exist.
+  // Returns true if the insertion occurred, false if the element was already
+  // present.
+  // --------------------------------------------------------------------------
+  bool Add(T elem) final {
+    const size_t h = HashPolicy::Hash(elem);
+    while (true) {
+      size_t capacity;
+      {
+        const LockedBuckets locked = LockBuckets(h);
+        Bucket& first = locked.table->buckets[locked.first];
+        Bucket& second = locked.table->buckets[locked.second];
+        if (first.Find(elem) != kNoSlot || second.Find(elem) != kNoSlot) {
+          return false;
+        }
+        Bucket& target = first.IsFull() ? second : first;
+        const size_t slot = target.FreeSlot();
+        if (slot != kNoSlot) {
+          target.Put(slot, std::move(elem));
+          size_.Increment();
+          return true;
+        }
+        capacity = locked.table->buckets.size();
+      }
+
+      // Both buckets are full: make room along a cuckoo path, or grow.
+      if (MakeRoom(h, capacity) == PathOutcome::kNotFound) {
+        Resize(capacity, ResizeGoal::kGrow);
+      }
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Removes an element if present.
+  // Returns true if removal occurred, false otherwise.
+  // --------------------------------------------------------------------------
+  bool Remove(T elem) final {
+    size_t capacity;
+    {
+      const LockedBuckets locked = LockBuckets(HashPolicy::Hash(elem));
+      bool removed = false;
+      for (const size_t index : {locked.first, locked.second}) {
+        Bucket& bucket = locked.table->buckets[index];
+        const size_t slot = bucket.Find(elem);
+        if (slot != kNoSlot) {
+          bucket.Take(slot);
+          size_.Decrement();
+          removed = true;
+          break;
+        }
+      }
+      if (!removed) {
+        return false;
+      }
+      capacity = locked.table->buckets.size();
+    }
+
+    if (ShouldShrink(capacity)) {
+      Resize(capacity, ResizeGoal::kShrink);
+    }
+    return true;
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns true if the element is present in the set. Probes at most
+  // 2 * kSlotsPerBucket slots.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool Contains(T elem) final {
+    const LockedBuckets locked = LockBuckets(HashPolicy::Hash(elem));
+    return locked.table->buckets[locked.first].Find(elem) != kNoSlot ||
+           locked.table->buckets[locked.second].Find(elem) != kNoSlot;
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the total number of stored elements.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t Size() const final { return size_.Size(); }
+
+  // --------------------------------------------------------------------------
+  // Returns the number of element slots of the current table.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t SlotCount() const noexcept {
+    return slot_count_.load(std::memory_order_relaxed);
+  }
+
+  // --------------------------------------------------------------------------
+  // Computes the fraction of slots in use.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] double LoadFactor() const noexcept {
+    return static_cast<double>(size_.Size()) /
+           static_cast<double>(SlotCount());
+  }
+
+  // --------------------------------------------------------------------------
+  // Table sizing (see table_sizing.h). SetShrinkLoadFactor() sets the
+  // fraction of slots in use below which Remove() shrinks the table, 0
+  // turning shrinking off. Compact() rebuilds the table at the smallest
+  // capacity that fits the elements, and Reserve() grows it so that
+  // |num_elements| fit without further growth. Both lock every stripe, like
+  // a resize.
+  // --------------------------------------------------------------------------
+  void SetShrinkLoadFactor(double slot_load_factor) noexcept {
+    sizing_.SetShrinkLoadFactor(slot_load_factor *
+                                static_cast<double>(kSlotsPerBucket));
+  }
+
+  void Compact() { Resize(0, ResizeGoal::kCompact); }
+
+  void Reserve(size_t num_elements) {
+    sizing_.Reserve(num_elements);
+    Resize(0, ResizeGoal::kReserve);
+  }
+
+ private:
+  static constexpr size_t kNoSlot = kSlotsPerBucket;
+
+  struct Bucket {
+    static constexpr uint32_t kAllOccupied = (1u << kSlotsPerBucket) - 1;
+
+    // Returns the slot holding |elem|, or kNoSlot.
+    [[nodiscard]] size_t Find(const T& elem) const {
+      for (size_t slot = 0; slot < kSlotsPerBucket; ++slot) {
+        if (IsOccupied(slot) && slots[slot] == elem) {
+          return slot;
+        }
+      }
+      return kNoSlot;
+    }
+
+    // Returns the first free slot, or kNoSlot.
+    [[nodiscard]] size_t FreeSlot() const noexcept {
+      return static_cast<size_t>(std::countr_one(occupied));
+    }
+
+    [[nodiscard]] bool IsOccupied(size_t slot) const noexcept {
+      return ((occupied >> slot) & 1u) != 0;
+    }
+
+    [[nodiscard]] bool IsFull() const noexcept {
+      return occupied == kAllOccupied;
+    }
+
+    void Put(size_t slot, T elem) {
+      assert(!IsOccupied(slot));
+      slots[slot] = std::move(elem);
+      occupied |= 1u << slot;
+    }
+
+    T Take(size_t slot) {
+      assert(IsOccupied(slot));
+      occupied &= ~(1u << slot);
+      return std::move(slots[slot]);
+    }
+
+    std::array<T, kSlotsPerBucket> slots{};
+    uint32_t occupied = 0;  // bit i is set if slots[i] holds an element
+  };
+
+  struct Table {
+    explicit Table(size_t capacity) : buckets(capacity) {}
+    std::vector<Bucket> buckets;
+  };
+
+  // The two buckets of a hash, locked, and the table they belong to.
+  struct LockedBuckets {
+    StripeLock first_lock;
+    StripeLock second_lock;
+    Table* table;
+    size_t first;
+    size_t second;
+  };
+
+  // A bucket visited by the cuckoo path search. The element in |slot| of the
+  // parent bucket can move to |bucket|.
+  struct PathNode {
+    size_t bucket;
+    size_t parent;
+    size_t slot;
+    size_t depth;
+  };
+
+  enum class PathOutcome {
+    kFreed,     // a bucket of the hash has a free slot (or got one, briefly)
+    kStale,     // the table changed under the search; try again
+    kNotFound,  // no path within the search bounds
+  };
+
+  // --------------------------------------------------------------------------
+  // Helper: the hash that picks an element's second bucket.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] static size_t SecondHash(size_t h) noexcept {
+    return Murmur3Mixer::Mix(h ^ kSecondHashSalt);
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: round |value| up to a (non-zero) multiple of |multiple|.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] static size_t RoundUpToMultiple(size_t value,
+                                                size_t multiple) noexcept {
+    return std::max<size_t>(1, (value + multiple - 1) / multiple) * multiple;
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: the stripe guarding bucket |index| of a table of |capacity|.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t StripeOf(size_t index, size_t capacity) const noexcept {
+    return HashPolicy::FoldIndex(index, capacity, stripes_.size());
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: the bucket other than |index| that |elem| may live in, or
+  // |index| itself if both of its buckets are the same.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] static size_t OtherBucket(const T& elem, size_t index,
+                                          size_t capacity) {
+    const size_t h = HashPolicy::Hash(elem);
+    const size_t first = HashPolicy::Index(h, capacity);
+    return first != index ? first : HashPolicy::Index(SecondHash(h), capacity);
+  }
+
+  // --------------------------------------------------------------------------
+  // Replaces the empty table with one sized for |elems| and fills it with
+  // them (see bulk_load.h). Only called while the set is being constructed.
+  // --------------------------------------------------------------------------
+  void BulkLoad(std::span<const T> elems, BulkKeys keys) {
+    Table* table = table_.load(std::memory_order_relaxed);
+    auto new_table = std::make_unique<Table>(
+        sizing_.ReserveCapacity(elems.size(), table->buckets.size()));
+    if (keys == BulkKeys::kDistinct) {
+      std::vector<T> homeless;
+      for (T elem : elems) {
+        if (!InsertUnshared(*new_table, elem)) {
+          homeless.push_back(std::move(elem));
+        }
+      }
+      new_table = Rehome(std::move(new_table), std::move(homeless));
+      size_.Add(elems.size());
+    }
+    slot_count_.store(new_table->buckets.size() * kSlotsPerBucket,
+                      std::memory_order_relaxed);
+    table_.store(new_table.release(), std::memory_order_relaxed);
+    delete table;
+
+    if (keys == BulkKeys::kMayRepeat) {
+      for (const T& elem : elems) {
+        Add(elem);
+      }
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns true if a table of |capacity| buckets is below the shrink load
+  // factor and may shrink, using the counter's fast path.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool ShouldShrink(size_t capacity) const noexcept {
+    if (!sizing_.CanShrink(capacity, stripes_.size())) {
+      return false;
+    }
+    const size_t bound = sizing_.ShrinkBound(capacity);
+    return bound > 0 && !size_.Exceeds(bound - 1);
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the current table. It only changes in Resize(), under every
+  // stripe lock, so it is stable while any of them (or resize_mutex_) is
+  // held.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] Table& LockedTable() const noexcept {
+    return *table_.load(std::memory_order_relaxed);
+  }
+
+  // --------------------------------------------------------------------------
+  // Locks stripes |a| and |b| in stripe order, or |a| once if they are the
+  // same.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] std::pair<StripeLock, StripeLock> LockStripes(size_t a,
+                                                              size_t b) const {
+    if (a > b) {
+      std::swap(a, b);
+    }
+    StripeLock first(stripes_[a].mutex);
+    if (a == b) {
+      return {std::move(first), StripeLock()};
+    }
+    return {std::move(first), StripeLock(stripes_[b].mutex)};
+  }
+
+  // --------------------------------------------------------------------------
+  // Locks both buckets of hash |h|. Their stripes follow from the hash, so
+  // they do not depend on the table a resize may be replacing meanwhile.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] LockedBuckets LockBuckets(size_t h) const {
+    const size_t second_h = SecondHash(h);
+    auto [first_lock, second_lock] =
+        LockStripes(HashPolicy::Index(h, stripes_.size()),
+                    HashPolicy::Index(second_h, stripes_.size()));
+    Table& table = LockedTable();
+    return {std::move(first_lock), std::move(second_lock), &table,
+            HashPolicy::Index(h, table.buckets.size()),
+            HashPolicy::Index(second_h, table.buckets.size())};
+  }
+
+  // --------------------------------------------------------------------------
+  // Frees a slot in one of the buckets of hash |h|, both full in the table of
+  // |capacity|, by searching for a cuckoo path and moving its elements.
+  // --------------------------------------------------------------------------
+  PathOutcome MakeRoom(size_t h, size_t capacity) {
+    std::vector<PathNode> nodes;
+    nodes.reserve(kMaxSearchBuckets);
+    nodes.push_back({HashPolicy::Index(h, capacity), kNoParent, 0, 0});
+    nodes.push_back(
+        {HashPolicy::Index(SecondHash(h), capacity), kNoParent, 0, 0});
+
+    size_t free_node = kNoParent;
+    for (size_t i = 0; i < nodes.size() && free_node == kNoParent; ++i) {
+      const PathNode node = nodes[i];
+      const StripeLock lock(stripes_[StripeOf(node.bucket, capacity)].mutex);
+      const Table& table = LockedTable();
+      if (table.buckets.size() != capacity) {
+        return PathOutcome::kStale;
+      }
+      const Bucket& bucket = table.buckets[node.bucket];
+      if (!bucket.IsFull()) {
+        free_node = i;
+      } else if (node.depth < kMaxPathLength) {
+        for (size_t slot = 0; slot < kSlotsPerBucket; ++slot) {
+          const size_t other =
+              OtherBucket(bucket.slots[slot], node.bucket, capacity);
+          if (other != node.bucket && nodes.size() < kMaxSearchBuckets) {
+            nodes.push_back({other, i, slot, node.depth + 1});
+          }
+        }
+      }
+    }
+    if (free_node == kNoParent) {
+      return PathOutcome::kNotFound;
+    }
+
+    // Move the elements of the path, starting next to the free slot, so that
+    // each move frees the slot the next one fills.
+    for (size_t i = free_node; nodes[i].parent != kNoParent;
+         i = nodes[i].parent) {
+      const PathNode& node = nodes[i];
+      const size_t from = nodes[node.parent].bucket;
+      const auto locks = LockStripes(StripeOf(from, capacity),
+                                     StripeOf(node.bucket, capacity));
+      Table& table = LockedTable();
+      if (table.buckets.size() != capacity) {
+        return PathOutcome::kStale;
+      }
+      Bucket& source = table.buckets[from];
+      Bucket& target = table.buckets[node.bucket];
+      const size_t free_slot = target.FreeSlot();
+      if (!source.IsOccupied(node.slot) || free_slot == kNoSlot ||
+          OtherBucket(source.slots[node.slot], from, capacity) !=
+              node.bucket) {
+        return PathOutcome::kStale;
+      }
+      target.Put(free_slot, source.Take(node.slot));
+    }
+    return PathOutcome::kFreed;
+  }
+
+  // --------------------------------------------------------------------------
+  // Inserts |elem| into |table|, which nobody else can reach, by random-walk
+  // cuckoo insertion. Returns false, leaving in |elem| the element that was
+  // left without a slot, if that takes more than kMaxKicks displacements.
+  // --------------------------------------------------------------------------
+  static bool InsertUnshared(Table& table, T& elem) {
+    const size_t capacity = table.buckets.size();
+    size_t from = kNoParent;  // the bucket |elem| was evicted from
+    for (size_t kick = 0; kick <= kMaxKicks; ++kick) {
+      const size_t h = HashPolicy::Hash(elem);
+      const size_t first = HashPolicy::Index(h, capacity);
+      const size_t second = HashPolicy::Index(SecondHash(h), capacity);
+      for (const size_t index : {first, second}) {
+        Bucket& bucket = table.buckets[index];
+        const size_t slot = bucket.FreeSlot();
+        if (slot != kNoSlot) {
+          bucket.Put(slot, std::move(elem));
+          return true;
+        }
+      }
+      // Evict an element from the bucket |elem| did not come from.
+      const size_t index = from == first ? second : first;
+      std::swap(elem, table.buckets[index].slots[kick % kSlotsPerBucket]);
+      from = index;
+    }
+    return false;
+  }
+
+  // --------------------------------------------------------------------------
+  // Moves every element of |from| into a new table of at least |capacity|
+  // buckets, doubling it until every element fits, and returns it.
+  // --------------------------------------------------------------------------
+  static std::unique_ptr<Table> Rehash(Table& from, size_t capacity) {
+    auto to = std::make_unique<Table>(capacity);
+    std::vector<T> homeless;
+    MoveElements(from, *to, homeless);
+    return Rehome(std::move(to), std::move(homeless));
+  }
+
+  // --------------------------------------------------------------------------
+  // Doubles |to| until the |homeless| elements fit in it too, and returns it.
+  // --------------------------------------------------------------------------
+  static std::unique_ptr<Table> Rehome(std::unique_ptr<Table> to,
+                                       std::vector<T> homeless) {
+    while (!homeless.empty()) {
+      auto larger =
+          std::make_unique<Table>(HashPolicy::Capacity(to->buckets.size() * 2));
+      std::vector<T> pending = std::move(homeless);
+      homeless.clear();
+      MoveElements(*to, *larger, homeless);
+      for (T& elem : pending) {
+        if (!InsertUnshared(*larger, elem)) {
+          homeless.push_back(std::move(elem));
+        }
+      }
+      to = std::move(larger);
+    }
+    return to;
+  }
+
+  // Moves every element of |from| into |to|, and those that found no slot
+  // into |homeless|.
+  static void MoveElements(Table& from, Table& to, std::vector<T>& homeless) {
+    for (Bucket& bucket : from.buckets) {
+      for (size_t slot = 0; slot < kSlotsPerBucket; ++slot) {
+        if (bucket.IsOccupied(slot)) {
+          T elem = bucket.Take(slot);
+          if (!InsertUnshared(to, elem)) {
+            homeless.push_back(std::move(elem));
+          }
+        }
+      }
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Resizes the table for |goal|. Growing and shrinking are skipped if
+  // another thread has since replaced the table of |capacity| buckets, or,
+  // for shrinking, if the table no longer needs to; Compact() and Reserve()
+  // pass no capacity. Acquires every stripe lock, in order.
+  // --------------------------------------------------------------------------
+  void Resize(size_t capacity, ResizeGoal goal) {
+    // Serialize resizes. Unlike in HashSetStriped, waiters do wait: their Add
+    // needs the larger table before it can go on.
+    const std::lock_guard<std::mutex> resize_lock(resize_mutex_);
+    std::vector<StripeLock> all_locks;
+    all_locks.reserve(stripes_.size());
+    for (StripeSlot& stripe : stripes_) {
+      all_locks.emplace_back(stripe.mutex);
+    }
+
+    Table& old_table = LockedTable();
+    const size_t old_capacity = old_table.buckets.size();
+    const bool automatic =
+        goal == ResizeGoal::kGrow || goal == ResizeGoal::kShrink;
+    if (automatic && old_capacity != capacity) {
+      return;
+    }
+    const size_t size = size_.Size();
+    const size_t divisor = stripes_.size();
+    size_t new_capacity = sizing_.FitCapacity(size, old_capacity, divisor);
+    if (goal == ResizeGoal::kGrow) {
+      new_capacity = HashPolicy::Capacity(old_capacity * 2);
+    } else if (goal == ResizeGoal::kShrink &&
+               !sizing_.ShouldShrink(size, old_capacity, divisor)) {
+      return;
+    } else if (goal == ResizeGoal::kReserve) {
+      new_capacity = sizing_.ReserveCapacity(0, old_capacity);
+    }
+    if (new_capacity == old_capacity && goal != ResizeGoal::kCompact) {
+      return;
+    }
+    std::unique_ptr<Table> new_table = Rehash(old_table, new_capacity);
+    slot_count_.store(new_table->buckets.size() * kSlotsPerBucket,
+                      std::memory_order_relaxed);
+    table_.store(new_table.release(), std::memory_order_release);
+    delete &old_table;  // only ever read under a stripe lock
+  }
+
+  std::atomic<Table*> table_;            // owned, replaced by Resize()
+  mutable std::vector<StripeSlot> stripes_;
+  std::atomic<size_t> slot_count_{
+      table_.load(std::memory_order_relaxed)->buckets.size() *
+      kSlotsPerBucket};
+  std::mutex resize_mutex_;  // serializes Resize()
+  ShardedCounter size_;      // sharded element count
+  TableSizing sizing_;       // shrinking and minimum capacity
+  static constexpr size_t kStripesPerThread = 16;
+  static constexpr double kGrowSlotLoadFactor = 0.9;
+  static constexpr size_t kGrowthFactor = 2;
+  static constexpr size_t kMaxPathLength = 5;
+  static constexpr size_t kMaxSearchBuckets = 512;
+  static constexpr size_t kMaxKicks = 500;
+  static constexpr size_t kNoParent = ~size_t{0};
+  static constexpr size_t kSecondHashSalt = 0x9e3779b97f4a7c15ULL;
+};
+
+#endif  // HASH_SET_CUCKOO_H
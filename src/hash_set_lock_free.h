@@ -0,0 +1,450 @@
+#ifndef HASH_SET_LOCK_FREE_H
+#define HASH_SET_LOCK_FREE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "src/bulk_load.h"
+#include "src/epoch.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_base.h"
+#include "src/parallel_rehash.h"
+#include "src/sharded_counter.h"
+#include "src/table_sizing.h"
+
+// ============================================================================
+// Lock-free open-addressing hash set
+// ----------------------------------------------------------------------------
+//  - Stores elements directly in a flat array of atomic 64-bit slots, probed
+//    linearly from the element's home slot.
+//  - Each slot moves only forward through the states
+//      empty -> full(elem) -> tombstone
+//    so a probe sequence never changes behind a reader's back.
+//  - Add claims the first empty slot on the probe sequence with a CAS. Two
+//    threads adding the same element race for the same slot, so no
+//    duplicates can appear.
+//  - Remove turns a full slot into a tombstone with a CAS. Tombstones are
+//    never reused; they are discarded by the next resize.
+//  - Contains is wait-free: it performs at most one pass over the table and
+//    writes no shared memory other than its own epoch record.
+//  - Resize freezes every slot of the old table, copies the surviving
+//    elements into a new table and publishes it. Writers that meet a frozen
+//    slot wait for the new table; readers keep using the frozen (immutable)
+//    old table until they next load the table pointer. Every operation is
+//    pinned to the epoch domain, and superseded tables are retired to it.
+//  - The new table is the smallest one at which the live elements use less
+//    than a quarter of the slots, growing the table or keeping its capacity.
+//    It only shrinks once removals leave the table below the shrink load
+//    factor, which makes a Remove resize it too (see table_sizing.h).
+//  - Only integral element types of at most 32 bits are supported, as an
+//    element is packed into a slot together with its state.
+//  - Home slots are chosen by the HashPolicy (see hash_policy.h). Linear
+//    probing needs well-spread home slots: with the identity std::hash<int>,
+//    a run of consecutive keys forms a single cluster that every miss has to
+//    scan to its end. The default policy therefore mixes the hash first.
+// ============================================================================
+template <typename T, typename HashPolicy = MaskHashPolicy<>>
+class HashSetLockFree : public HashSetBase<T> {
+  static_assert(std::is_integral_v<T> && sizeof(T) <= sizeof(uint32_t),
+                "HashSetLockFree packs elements into 64-bit slots and only "
+                "supports integral types of at most 32 bits");
+
+ public:
+  explicit HashSetLockFree(size_t initial_capacity)
+      : table_(new Table(SlotCount(initial_capacity))),
+        sizing_(table_.load(std::memory_order_relaxed)->slots.size(),
+                kGrowLoadFactor, kGrowthFactor) {
+    assert(initial_capacity > 0 && "Initial capacity must be > 0");
+  }
+
+  // --------------------------------------------------------------------------
+  // Builds the set from |elems|, with a table sized for all of them, filled
+  // on several threads above the parallel rehash threshold (see
+  // bulk_load.h). Distinct elements claim the first empty slot of their
+  // probe sequence; others go through the usual Add() probe.
+  // --------------------------------------------------------------------------
+  HashSetLockFree(std::span<const T> elems, BulkKeys keys,
+                  size_t initial_capacity = 1)
+      : HashSetLockFree(initial_capacity) {
+    BulkLoad(elems, keys);
+  }
+
+  ~HashSetLockFree() override { delete table_.load(std::memory_order_relaxed); }
+
+  HashSetLockFree(const HashSetLockFree&) = delete;
+  HashSetLockFree& operator=(const HashSetLockFree&) = delete;
+
+  // --------------------------------------------------------------------------
+  // Inserts an element if it does not already exist.
+  // Returns true if the insertion occurred, false if the element was already
+  // present.
+  // --------------------------------------------------------------------------
+  bool Add(T elem) final {
+    EpochGuard epoch_guard;
+    while (true) {
+      Table* table = table_.load(std::memory_order_acquire);
+      const Outcome outcome = TryAdd(*table, elem);
+      if (outcome == Outcome::kSucceeded) {
+        size_.Increment();
+        if (table->used.Exceeds(MaxUsed(table->slots.size()))) {
+          Resize(table, ResizeGoal::kGrow);
+        }
+        return true;
+      }
+      if (outcome == Outcome::kFailed) {
+        return false;
+      }
+      // The table is full or being migrated: make sure a new table exists
+      // and try again there.
+      Resize(table, ResizeGoal::kGrow);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Removes an element if present.
+  // Returns true if removal occurred, false otherwise.
+  // --------------------------------------------------------------------------
+  bool Remove(T elem) final {
+    EpochGuard epoch_guard;
+    while (true) {
+      Table* table = table_.load(std::memory_order_acquire);
+      const Outcome outcome = TryRemove(*table, elem);
+      if (outcome == Outcome::kSucceeded) {
+        size_.Decrement();
+        if (ShouldShrink(*table)) {
+          Resize(table, ResizeGoal::kShrink);
+        }
+        return true;
+      }
+      if (outcome == Outcome::kFailed) {
+        return false;
+      }
+      Resize(table, ResizeGoal::kGrow);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns true if the element is present in the set. Wait-free.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool Contains(T elem) final {
+    EpochGuard epoch_guard;
+    const Table& table = *table_.load(std::memory_order_acquire);
+    const size_t capacity = table.slots.size();
+    const uint64_t wanted = kFull | Encode(elem);
+
+    size_t index = HomeSlot(elem, capacity);
+    for (size_t probes = 0; probes < capacity; ++probes) {
+      const uint64_t word =
+          table.slots[index].load(std::memory_order_acquire) & ~kFrozen;
+      if (word == kEmpty) {
+        return false;
+      }
+      if (word == wanted) {
+        return true;
+      }
+      index = NextSlot(index, capacity);
+    }
+    return false;
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the total number of stored elements.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t Size() const final { return size_.Size(); }
+
+  // --------------------------------------------------------------------------
+  // Sets the number of elements from which Resize() freezes and copies the
+  // table on several threads (see parallel_rehash.h).
+  // --------------------------------------------------------------------------
+  void SetParallelRehashThreshold(size_t num_elements) noexcept {
+    parallel_rehash_threshold_.store(num_elements, std::memory_order_relaxed);
+  }
+
+  // --------------------------------------------------------------------------
+  // Table sizing (see table_sizing.h). SetShrinkLoadFactor() sets the
+  // fraction of slots holding live elements below which Remove() shrinks the
+  // table, 0 turning shrinking off. Compact() rebuilds the table at the
+  // smallest capacity that fits the elements, and Reserve() grows it so that
+  // |num_elements| fit without further growth. Both block other writers for
+  // as long as a resize does.
+  // --------------------------------------------------------------------------
+  void SetShrinkLoadFactor(double load_factor) noexcept {
+    sizing_.SetShrinkLoadFactor(load_factor);
+  }
+
+  void Compact() {
+    EpochGuard epoch_guard;
+    while (!Resize(table_.load(std::memory_order_acquire),
+                   ResizeGoal::kCompact)) {
+    }
+  }
+
+  void Reserve(size_t num_elements) {
+    sizing_.Reserve(num_elements);
+    EpochGuard epoch_guard;
+    while (true) {
+      Table* table = table_.load(std::memory_order_acquire);
+      const size_t capacity = table->slots.size();
+      if (capacity >= sizing_.MinCapacity() ||
+          Resize(table, ResizeGoal::kReserve)) {
+        return;
+      }
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the number of slots of the current table.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t Capacity() const {
+    const EpochGuard epoch_guard;
+    return table_.load(std::memory_order_acquire)->slots.size();
+  }
+
+ private:
+  // Slot layout: bit 63 marks a frozen slot, bits 32..33 hold the state and
+  // the low 32 bits hold the element.
+  static constexpr uint64_t kEmpty = 0;
+  static constexpr uint64_t kFull = uint64_t{1} << 32;
+  static constexpr uint64_t kTombstone = uint64_t{2} << 32;
+  static constexpr uint64_t kStateMask = uint64_t{3} << 32;
+  static constexpr uint64_t kFrozen = uint64_t{1} << 63;
+
+  static constexpr size_t kMinCapacity = 8;
+
+  enum class Outcome {
+    kSucceeded,  // the operation took effect
+    kFailed,     // the operation completed without effect
+    kRetry,      // the table is full or frozen; retry on a new table
+  };
+
+  struct Table {
+    explicit Table(size_t capacity) : slots(capacity) {}
+
+    std::vector<std::atomic<uint64_t>> slots;
+    ShardedCounter used;  // non-empty slots, tombstones included
+  };
+
+  static uint64_t Encode(T elem) noexcept {
+    return static_cast<uint64_t>(static_cast<uint32_t>(elem));
+  }
+
+  static size_t HomeSlot(T elem, size_t capacity) noexcept {
+    return HashPolicy::Index(HashPolicy::Hash(elem), capacity);
+  }
+
+  static size_t NextSlot(size_t index, size_t capacity) noexcept {
+    return index + 1 == capacity ? 0 : index + 1;
+  }
+
+  static size_t SlotCount(size_t requested) noexcept {
+    return HashPolicy::Capacity(std::max(requested, kMinCapacity));
+  }
+
+  // Tables are rebuilt once three quarters of their slots have been used.
+  static size_t MaxUsed(size_t capacity) noexcept { return capacity / 4 * 3; }
+
+  // Whether |table| is below the shrink load factor and may shrink, using
+  // the counter's fast path.
+  bool ShouldShrink(const Table& table) const noexcept {
+    const size_t capacity = table.slots.size();
+    if (!sizing_.CanShrink(capacity)) {
+      return false;
+    }
+    const size_t bound = sizing_.ShrinkBound(capacity);
+    return bound > 0 && !size_.Exceeds(bound - 1);
+  }
+
+  static Outcome TryAdd(Table& table, T elem) {
+    const size_t capacity = table.slots.size();
+    const uint64_t desired = kFull | Encode(elem);
+
+    size_t index = HomeSlot(elem, capacity);
+    for (size_t probes = 0; probes < capacity; ++probes) {
+      auto& slot = table.slots[index];
+      uint64_t word = slot.load(std::memory_order_acquire);
+      if (word == kEmpty) {
+        if (slot.compare_exchange_strong(word, desired,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+          table.used.Increment();
+          return Outcome::kSucceeded;
+        }
+        // Lost the race for this slot; |word| now holds its new contents.
+      }
+      if ((word & kFrozen) != 0) {
+        return Outcome::kRetry;
+      }
+      if (word == desired) {
+        return Outcome::kFailed;
+      }
+      index = NextSlot(index, capacity);
+    }
+    return Outcome::kRetry;
+  }
+
+  // --------------------------------------------------------------------------
+  // Stores |word|, a full slot whose element is in no slot of |table| yet,
+  // in the first empty slot of its probe sequence. The table must have
+  // one, and may be filled by other threads meanwhile.
+  // --------------------------------------------------------------------------
+  static void PlaceDistinct(Table& table, uint64_t word) {
+    const size_t capacity = table.slots.size();
+    const T elem = static_cast<T>(static_cast<uint32_t>(word));
+    size_t index = HomeSlot(elem, capacity);
+    uint64_t empty = kEmpty;
+    while (!table.slots[index].compare_exchange_strong(
+        empty, word, std::memory_order_relaxed)) {
+      empty = kEmpty;
+      index = NextSlot(index, capacity);
+    }
+    table.used.Increment();
+  }
+
+  static Outcome TryRemove(Table& table, T elem) {
+    const size_t capacity = table.slots.size();
+    const uint64_t wanted = kFull | Encode(elem);
+
+    size_t index = HomeSlot(elem, capacity);
+    for (size_t probes = 0; probes < capacity; ++probes) {
+      auto& slot = table.slots[index];
+      uint64_t word = slot.load(std::memory_order_acquire);
+      if (word == wanted) {
+        if (slot.compare_exchange_strong(word, kTombstone,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+          return Outcome::kSucceeded;
+        }
+        // The slot was frozen, or another thread removed the element first;
+        // in the latter case a re-added copy can only live further along.
+      }
+      if ((word & kFrozen) != 0) {
+        return Outcome::kRetry;
+      }
+      if (word == kEmpty) {
+        return Outcome::kFailed;
+      }
+      index = NextSlot(index, capacity);
+    }
+    return Outcome::kFailed;
+  }
+
+  // --------------------------------------------------------------------------
+  // Replaces the empty table with one sized for |elems| and filled with them
+  // (see bulk_load.h). Only called while the set is being constructed.
+  // --------------------------------------------------------------------------
+  void BulkLoad(std::span<const T> elems, BulkKeys keys) {
+    Table* table = table_.load(std::memory_order_relaxed);
+    size_t capacity = sizing_.ReserveCapacity(0, table->slots.size());
+    while (elems.size() * 4 >= capacity) {
+      capacity = HashPolicy::Capacity(capacity * 2);
+    }
+    auto fresh = std::make_unique<Table>(capacity);
+    const size_t workers = RehashWorkerCount(
+        elems.size(), capacity,
+        parallel_rehash_threshold_.load(std::memory_order_relaxed));
+    ForEachBucketRange(elems.size(), workers, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        if (keys == BulkKeys::kDistinct) {
+          PlaceDistinct(*fresh, kFull | Encode(elems[i]));
+          size_.Increment();
+        } else if (TryAdd(*fresh, elems[i]) == Outcome::kSucceeded) {
+          size_.Increment();
+        }
+      }
+    });
+    table_.store(fresh.release(), std::memory_order_relaxed);
+    delete table;
+  }
+
+  // --------------------------------------------------------------------------
+  // Replaces |expected| with a freshly built table, sized for |goal|, unless
+  // another thread already did so; returns whether this call replaced it.
+  // Threads that find a frozen slot call this too, which blocks them until
+  // the migration in progress has been published.
+  // --------------------------------------------------------------------------
+  bool Resize(Table* expected, ResizeGoal goal) {
+    std::lock_guard<std::mutex> resize_lock(resize_mutex_);
+    if (table_.load(std::memory_order_acquire) != expected) {
+      return false;
+    }
+
+    // Large tables are frozen and copied by several threads, each taking a
+    // range of old slots (see parallel_rehash.h).
+    const size_t workers = RehashWorkerCount(
+        size_.Size(), expected->slots.size(),
+        parallel_rehash_threshold_.load(std::memory_order_relaxed));
+
+    // Freeze every slot; after this the old table is immutable.
+    std::atomic<size_t> live{0};
+    ForEachBucketRange(
+        expected->slots.size(), workers, [&](size_t begin, size_t end) {
+          size_t range_live = 0;
+          for (size_t i = begin; i < end; ++i) {
+            const uint64_t word =
+                expected->slots[i].fetch_or(kFrozen, std::memory_order_acq_rel);
+            if ((word & kStateMask) == kFull) {
+              ++range_live;
+            }
+          }
+          live.fetch_add(range_live, std::memory_order_relaxed);
+        });
+
+    // Grow while live elements would fill more than a quarter of the table;
+    // otherwise rebuild at the same capacity to discard tombstones. Below
+    // the shrink load factor, or for Compact(), shrink to fit instead.
+    const size_t num_live = live.load(std::memory_order_relaxed);
+    size_t new_capacity = expected->slots.size();
+    if (goal == ResizeGoal::kCompact ||
+        sizing_.ShouldShrink(num_live, new_capacity)) {
+      new_capacity = sizing_.FitCapacity(num_live, new_capacity);
+    }
+    while (num_live * 4 >= new_capacity) {
+      new_capacity = HashPolicy::Capacity(new_capacity * 2);
+    }
+    new_capacity = sizing_.ReserveCapacity(0, new_capacity);
+
+    // Probe sequences in the new table cross range boundaries, so slots are
+    // claimed with a CAS; the table is still private to the workers.
+    auto fresh = std::make_unique<Table>(new_capacity);
+    ForEachBucketRange(
+        expected->slots.size(), workers, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            const uint64_t word =
+                expected->slots[i].load(std::memory_order_relaxed) & ~kFrozen;
+            if ((word & kStateMask) != kFull) {
+              continue;
+            }
+            PlaceDistinct(*fresh, word);
+          }
+        });
+
+    table_.store(fresh.release(), std::memory_order_release);
+
+    // Readers may still be scanning the old table; it is freed once they
+    // have all unpinned.
+    EpochDomain::Global().Retire(expected);
+    return true;
+  }
+
+  std::atomic<Table*> table_;  // current table
+  ShardedCounter size_;        // sharded element count
+  std::mutex resize_mutex_;    // serialize Resize()
+  std::atomic<size_t> parallel_rehash_threshold_{
+      kDefaultParallelRehashThreshold};
+  TableSizing sizing_;  // shrinking and minimum capacity
+
+  // The live load factor a rebuild leaves is below a quarter, which is the
+  // grow load factor over the growth factor (see table_sizing.h).
+  static constexpr double kGrowLoadFactor = 0.5;
+  static constexpr size_t kGrowthFactor = 2;
+};
+
+#endif  // HASH_SET_LOCK_FREE_H
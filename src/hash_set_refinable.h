@@ -4,107 +4,704 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
-#include <functional>
+#include <concepts>
+#include <filesystem>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <shared_mutex>
+#include <span>
+#include <utility>
 #include <vector>
 
+#include "src/arena.h"
+#include "src/batch_order.h"
+#include "src/bucket_storage.h"
+#include "src/bulk_load.h"
+#include "src/epoch.h"
+#include "src/hash_policy.h"
 #include "src/hash_set_base.h"
+#include "src/lock_policy.h"
+#include "src/parallel_rehash.h"
+#include "src/set_stats.h"
+#include "src/sharded_counter.h"
+#include "src/snapshot.h"
+#include "src/table_sizing.h"
 
-template <typename T>
+// How HashSetRefinable moves its elements into a new table.
+enum class ResizeMode {
+  // Lock every bucket and rehash the whole table, on several threads once
+  // the set passes its parallel rehash threshold.
+  kStopTheWorld,
+  // Publish the larger table next to the old one and migrate buckets in
+  // chunks. Every operation that runs into the migration moves the bucket it
+  // needs plus one chunk, so no single operation pays for the whole rehash.
+  kIncremental,
+};
+
+// Buckets allocate through the Allocator, which may give every table an arena
+// of its own (see arena.h), and are guarded by locks of the LockPolicy's
+// SharedMutex type, each on a cache line of its own if the policy's layout is
+// padded (see lock_policy.h). Lock contention, probes and resizes
+// are counted in builds with HASH_SET_STATS (see set_stats.h). The table
+// grows by a factor of 4, and shrinks the same way, by the resize mode, once
+// removals leave it below the shrink load factor (see table_sizing.h).
+template <typename T, typename Storage = VectorBucketStorage,
+          typename HashPolicy = ModuloHashPolicy<>,
+          typename Allocator = std::allocator<T>,
+          typename LockPolicy = StdLockPolicy>
 class HashSetRefinable : public HashSetBase<T> {
+  using Bucket = typename Storage::template Bucket<T, Allocator>;
+  using BucketAllocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Bucket>;
+  using BucketMutex = typename LockPolicy::SharedMutex;
+  using ExclusiveLock = std::unique_lock<BucketMutex>;
+  using SharedLock = std::shared_lock<BucketMutex>;
+
+  // The lock of a bucket, and whether the bucket has been migrated into the
+  // next table, which is guarded by the lock.
+  struct BucketLock {
+    BucketMutex mutex;
+    bool migrated = false;
+  };
+  using BucketLockSlot = LockSlot<LockPolicy, BucketLock>;
+
  public:
-  explicit HashSetRefinable(size_t initial_capacity) : size_(0) {
+  explicit HashSetRefinable(size_t initial_capacity,
+                            ResizeMode resize_mode = ResizeMode::kStopTheWorld)
+      : resize_mode_(resize_mode),
+        state_(new TableState(HashPolicy::Capacity(initial_capacity))),
+        sizing_(state_.load(std::memory_order_relaxed)->buckets.size(),
+                kLoadFactorThreshold, kGrowthFactor) {
     assert(initial_capacity > 0 && "Initial capacity must be > 0");
-    auto initial_state = std::make_shared<TableState>(initial_capacity);
-    std::atomic_store(&state_, initial_state);
   }
 
-  bool Add(T elem) final {
-    while (true) {
-      auto state = std::atomic_load(&state_);
-      const size_t index = BucketIndex(elem, *state);
-      std::unique_lock<std::shared_mutex> bucket_lock(state->locks[index]);
-      if (state != std::atomic_load(&state_)) {
-        continue;
-      }
+  // Builds the set from |elems| in one pass, with a table sized for all of
+  // them (see bulk_load.h).
+  HashSetRefinable(std::span<const T> elems, BulkKeys keys,
+                   size_t initial_capacity = 1,
+                   ResizeMode resize_mode = ResizeMode::kStopTheWorld)
+      : HashSetRefinable(initial_capacity, resize_mode) {
+    BulkLoad(elems, keys);
+  }
 
-      auto& bucket = state->buckets[index];
-      if (std::find(bucket.begin(), bucket.end(), elem) != bucket.end()) {
-        return false;
-      }
+  // Builds the set from a snapshot (see snapshot.h), adopting its layout:
+  // the first table has the snapshot's bucket count, and every bucket is
+  // copied from the snapshot's bucket of the same index without hashing its
+  // elements, on several threads past the parallel rehash threshold.
+  explicit HashSetRefinable(const MappedSnapshot<T, HashPolicy>& snapshot,
+                            ResizeMode resize_mode = ResizeMode::kStopTheWorld)
+    requires SnapshotElement<T>
+      : HashSetRefinable(1, resize_mode) {
+    AdoptSnapshot(snapshot);
+  }
 
-      bucket.push_back(elem);
-      const size_t new_size = size_.fetch_add(1, std::memory_order_relaxed) + 1;
+  // Superseded tables belong to the epoch domain; the current table and the
+  // one it may be migrating into belong to the set.
+  ~HashSetRefinable() override {
+    TableState* state = state_.load(std::memory_order_relaxed);
+    delete state->next.load(std::memory_order_relaxed);
+    delete state;
+  }
 
-      const bool should_resize =
-          new_size > kLoadFactorThreshold * state->buckets.size();
+  HashSetRefinable(const HashSetRefinable&) = delete;
+  HashSetRefinable& operator=(const HashSetRefinable&) = delete;
+
+  bool Add(T elem) final { return AddKey(std::move(elem)); }
+
+  // Builds the element from |key| only if it is absent.
+  template <HeterogeneousKey<T, HashPolicy> K>
+    requires std::constructible_from<T, K>
+  bool Add(K&& key) {
+    return AddKey(std::forward<K>(key));
+  }
+
+  bool Remove(T elem) final { return RemoveKey(elem); }
+
+  template <HeterogeneousKey<T, HashPolicy> K>
+  bool Remove(const K& key) {
+    return RemoveKey(key);
+  }
+
+  [[nodiscard]] bool Contains(T elem) final { return ContainsKey(elem); }
+
+  template <HeterogeneousKey<T, HashPolicy> K>
+  [[nodiscard]] bool Contains(const K& key) {
+    return ContainsKey(key);
+  }
+
+  // Element access, for maps built on the set (see hash_map.h). Visit()
+  // calls |f| with the element equal to |key|, under a shared lock of its
+  // bucket, and returns whether there was one. AddOrModify() applies
+  // |modify| to that element under the exclusive lock, or inserts |make()|
+  // if there is none, and returns whether it inserted; |modify| must leave
+  // the element equal to |key|, and |make()| may move from it.
+  template <LookupKey<T, HashPolicy> K, typename F>
+  bool Visit(const K& key, F&& f) {
+    const size_t h = HashPolicy::Hash(key);
+    EpochGuard epoch_guard;
+    size_t index;
+    SharedLock bucket_lock;
+    const TableState* state = LockBucket(h, index, bucket_lock);
+    const auto& bucket = state->buckets[index];
+    stats_.RecordProbe(bucket.Size());
+    const T* elem = bucket.Find(key, h);
+    if (elem == nullptr) {
+      return false;
+    }
+    f(*elem);
+    return true;
+  }
+
+  template <LookupKey<T, HashPolicy> K, typename Make, typename Modify>
+  bool AddOrModify(const K& key, Make&& make, Modify&& modify) {
+    const size_t h = HashPolicy::Hash(key);
+    EpochGuard epoch_guard;
+    size_t index;
+    ExclusiveLock bucket_lock;
+    TableState* state = LockBucket(h, index, bucket_lock);
+    auto& bucket = state->buckets[index];
+    stats_.RecordProbe(bucket.Size());
+    if (bucket.Modify(key, h, modify)) {
+      return false;
+    }
+
+    T elem = make();
+    assert(HashPolicy::Hash(elem) == h && "make() must build |key|");
+    bucket.Insert(std::move(elem), h);
+    size_.Increment();
+    const bool should_resize = ShouldResize(*state);
+
+    bucket_lock.unlock();
+    if (should_resize) {
+      MaybeResize(state, ResizeGoal::kGrow);
+    }
+    return true;
+  }
+
+  // Batch operations: elements are grouped by bucket, so that each bucket
+  // lock is taken once per batch.
+  std::vector<bool> AddMany(std::span<const T> elems) final {
+    return ForEachByBucket<ExclusiveLock>(
+        elems, ResizeGoal::kGrow,
+        [this](TableState& state, size_t index, const T& elem, size_t h) {
+          return AddLocked(state, index, elem, h);
+        });
+  }
+
+  std::vector<bool> RemoveMany(std::span<const T> elems) final {
+    return ForEachByBucket<ExclusiveLock>(
+        elems, ResizeGoal::kShrink,
+        [this](TableState& state, size_t index, const T& elem, size_t h) {
+          return RemoveLocked(state, index, elem, h);
+        });
+  }
+
+  [[nodiscard]] std::vector<bool> ContainsMany(
+      std::span<const T> elems) final {
+    return ForEachByBucket<SharedLock>(
+        elems, /*resize_goal=*/std::nullopt,
+        [this](TableState& state, size_t index, const T& elem, size_t h) {
+          return ContainsLocked(state, index, elem, h);
+        });
+  }
+
+  [[nodiscard]] size_t Size() const final { return size_.Size(); }
+
+  // Calls |f(elem)| for every element. Buckets are visited one at a time
+  // under a shared bucket lock, so writers only wait for the bucket being
+  // visited. A migration in progress is finished first, and later resizes
+  // are postponed until the traversal ends. Elements present throughout are
+  // visited exactly once; elements added or removed meanwhile at most once.
+  // |f| must not call back into the set.
+  template <typename F>
+  void ForEach(F&& f) {
+    ForEachParallel(1, f);
+  }
+
+  // As ForEach(), but the buckets are split into |num_workers| ranges that
+  // are traversed on as many threads (see parallel_rehash.h), and |f| is
+  // called from all of them concurrently.
+  template <typename F>
+  void ForEachParallel(size_t num_workers, F&& f) {
+    VisitBuckets(num_workers,
+                 [&f](const Bucket& bucket) { bucket.ForEach(f); });
+  }
+
+  // Returns the hot-path statistics and the current bucket lengths (see
+  // set_stats.h). The bucket lengths are taken like a ForEach() traversal.
+  [[nodiscard]] SetStatsSnapshot Stats() {
+    SetStatsSnapshot snapshot;
+    VisitBuckets(1, [&snapshot](const Bucket& bucket) {
+      snapshot.CountBucket(bucket.Size());
+    });
+    stats_.AddTo(snapshot);
+    return snapshot;
+  }
+
+  void ResetStats() noexcept { stats_.Reset(); }
+
+  // Writes the table, bucket by bucket, to a snapshot at |path| (see
+  // snapshot.h). The buckets are taken like a ForEach() traversal, so the
+  // snapshot is not atomic unless the set is quiescent.
+  void SaveSnapshot(const std::filesystem::path& path)
+    requires SnapshotElement<T>
+  {
+    SnapshotWriter<T, HashPolicy> writer(path);
+    VisitBuckets(1, [&writer](const Bucket& bucket) {
+      writer.AddBucket(bucket);
+    });
+    writer.Finish();
+  }
+
+  // Sets the number of elements from which a stop-the-world resize migrates
+  // buckets on several threads (see parallel_rehash.h). Incremental resizes
+  // are already spread over the threads that use the set.
+  void SetParallelRehashThreshold(size_t num_elements) noexcept {
+    parallel_rehash_threshold_.store(num_elements, std::memory_order_relaxed);
+  }
+
+  // Table sizing (see table_sizing.h). SetShrinkLoadFactor() sets the load
+  // factor below which Remove() shrinks the table, 0 turning shrinking off.
+  // Compact() rebuilds the table at the smallest capacity that fits the
+  // elements, and Reserve() grows it so that |num_elements| fit without
+  // further growth. Both finish a migration in progress and then resize
+  // stop-the-world, whatever the resize mode.
+  void SetShrinkLoadFactor(double load_factor) noexcept {
+    sizing_.SetShrinkLoadFactor(load_factor);
+  }
+
+  void Compact() {
+    EpochGuard epoch_guard;
+    std::unique_lock<std::mutex> resize_guard(resize_mutex_);
+    TableState* state = FinishMigration();
+    StartResize(state,
+                sizing_.FitCapacity(size_.Size(), state->buckets.size()),
+                ResizeMode::kStopTheWorld, resize_guard);
+  }
+
+  void Reserve(size_t num_elements) {
+    EpochGuard epoch_guard;
+    std::unique_lock<std::mutex> resize_guard(resize_mutex_);
+    TableState* state = FinishMigration();
+    const size_t capacity = state->buckets.size();
+    sizing_.Reserve(num_elements);
+    const size_t new_capacity = sizing_.ReserveCapacity(0, capacity);
+    if (new_capacity != capacity) {
+      StartResize(state, new_capacity, ResizeMode::kStopTheWorld,
+                  resize_guard);
+    }
+  }
+
+  // The bucket count of the current table; a migration in progress is
+  // finished first.
+  [[nodiscard]] size_t BucketCount() {
+    EpochGuard epoch_guard;
+    const std::lock_guard<std::mutex> resize_guard(resize_mutex_);
+    return FinishMigration()->buckets.size();
+  }
+
+ private:
+  struct TableState {
+    explicit TableState(size_t capacity)
+        : buckets(capacity, BucketAllocator(allocator.Get())),
+          locks(capacity) {}
+
+    // Declared first, so that it outlives the buckets.
+    [[no_unique_address]] TableAllocator<Allocator> allocator;
+    std::vector<Bucket, BucketAllocator> buckets;
+    std::vector<BucketLockSlot> locks;
+
+    // Resize bookkeeping. |next| is the table this one is being migrated
+    // into; it never changes once set and is not owned by this table.
+    std::atomic<TableState*> next{nullptr};
+    std::atomic<size_t> migration_cursor{0};  // next chunk to hand out
+    std::atomic<size_t> migrated_buckets{0};
+  };
+
+  // Calls |visit(bucket)| for every bucket, as described for ForEach() and
+  // ForEachParallel().
+  template <typename Visit>
+  void VisitBuckets(size_t num_workers, Visit&& visit) {
+    EpochGuard epoch_guard;
+    TableState* state;
+    bool should_grow = false;
+    bool should_shrink = false;
+    {
+      // No resize can start while this is held.
+      const std::lock_guard<std::mutex> resize_guard(resize_mutex_);
+      state = FinishMigration();
+      ForEachBucketRange(
+          state->buckets.size(), num_workers, [&](size_t begin, size_t end) {
+            for (size_t index = begin; index < end; ++index) {
+              const SharedLock bucket_lock(state->locks[index].mutex);
+              visit(state->buckets[index]);
+            }
+          });
+      should_grow = ShouldResize(*state);
+      should_shrink = ShouldShrink(*state);
+    }
+    if (should_grow) {
+      MaybeResize(state, ResizeGoal::kGrow);  // one writers skipped meanwhile
+    } else if (should_shrink) {
+      MaybeResize(state, ResizeGoal::kShrink);
+    }
+  }
+
+  // Replaces the empty table with one sized for |elems| and filled with them
+  // (see bulk_load.h). Only called while the set is being constructed.
+  void BulkLoad(std::span<const T> elems, BulkKeys keys) {
+    TableState* state = state_.load(std::memory_order_relaxed);
+    const size_t capacity =
+        sizing_.ReserveCapacity(elems.size(), state->buckets.size());
+    auto new_state = std::make_unique<TableState>(capacity);
+    size_.Add(BulkFill<HashPolicy>(
+        elems, keys, new_state->buckets,
+        RehashWorkerCount(
+            elems.size(), capacity,
+            parallel_rehash_threshold_.load(std::memory_order_relaxed))));
+    state_.store(new_state.release(), std::memory_order_relaxed);
+    delete state;
+  }
+
+  // Replaces the empty table with the layout and elements of |snapshot|.
+  // Only called while the set is being constructed.
+  void AdoptSnapshot(const MappedSnapshot<T, HashPolicy>& snapshot) {
+    TableState* state = state_.load(std::memory_order_relaxed);
+    const size_t capacity = snapshot.BucketCount();
+    auto new_state = std::make_unique<TableState>(capacity);
+    ForEachBucketRange(
+        capacity,
+        RehashWorkerCount(
+            snapshot.Size(), capacity,
+            parallel_rehash_threshold_.load(std::memory_order_relaxed)),
+        [&](size_t begin, size_t end) {
+          for (size_t index = begin; index < end; ++index) {
+            Bucket& bucket = new_state->buckets[index];
+            for (const T& elem : snapshot.Bucket(index)) {
+              size_t h = 0;
+              if constexpr (Bucket::kStoresHashes) {
+                h = HashPolicy::Hash(elem);
+              }
+              bucket.Insert(elem, h);
+            }
+          }
+        });
+    size_.Add(snapshot.Size());
+    state_.store(new_state.release(), std::memory_order_relaxed);
+    delete state;
+  }
+
+  static size_t BucketIndex(size_t h, const TableState& state) {
+    return HashPolicy::Index(h, state.buckets.size());
+  }
+
+  // Add, Remove and Contains for an element or a heterogeneous key. The key
+  // is hashed once, and the element is built from it (by a move when it is
+  // one) only once it is known to be absent.
+  template <typename K>
+  bool AddKey(K&& key) {
+    const size_t h = HashPolicy::Hash(key);
+    EpochGuard epoch_guard;
+    size_t index;
+    ExclusiveLock bucket_lock;
+    TableState* state = LockBucket(h, index, bucket_lock);
+
+    if (!AddLocked(*state, index, std::forward<K>(key), h)) {
+      return false;
+    }
+
+    const bool should_resize = ShouldResize(*state);
+
+    bucket_lock.unlock();
+    if (should_resize) {
+      MaybeResize(state, ResizeGoal::kGrow);
+    }
+
+    return true;
+  }
 
+  template <typename K>
+  bool RemoveKey(const K& key) {
+    const size_t h = HashPolicy::Hash(key);
+    EpochGuard epoch_guard;
+    size_t index;
+    ExclusiveLock bucket_lock;
+    TableState* state = LockBucket(h, index, bucket_lock);
+
+    if (!RemoveLocked(*state, index, key, h)) {
+      return false;
+    }
+
+    const bool should_shrink = ShouldShrink(*state);
+
+    bucket_lock.unlock();
+    if (should_shrink) {
+      MaybeResize(state, ResizeGoal::kShrink);
+    }
+
+    return true;
+  }
+
+  template <typename K>
+  [[nodiscard]] bool ContainsKey(const K& key) {
+    const size_t h = HashPolicy::Hash(key);
+    EpochGuard epoch_guard;
+    size_t index;
+    SharedLock bucket_lock;
+    TableState* state = LockBucket(h, index, bucket_lock);
+    return ContainsLocked(*state, index, key, h);
+  }
+
+  // The single-element operations on bucket |index| of |state|, which must be
+  // locked (exclusively, but for Contains), for a key with hash |h|.
+  template <typename K>
+  bool AddLocked(TableState& state, size_t index, K&& key, size_t h) {
+    auto& bucket = state.buckets[index];
+    stats_.RecordProbe(bucket.Size());
+    if (bucket.Contains(key, h)) {
+      return false;
+    }
+
+    bucket.Insert(T(std::forward<K>(key)), h);
+    size_.Increment();
+    return true;
+  }
+
+  template <typename K>
+  bool RemoveLocked(TableState& state, size_t index, const K& key, size_t h) {
+    auto& bucket = state.buckets[index];
+    stats_.RecordProbe(bucket.Size());
+    if (!bucket.Erase(key, h)) {
+      return false;
+    }
+
+    size_.Decrement();
+    return true;
+  }
+
+  template <typename K>
+  bool ContainsLocked(const TableState& state, size_t index, const K& key,
+                      size_t h) {
+    const auto& bucket = state.buckets[index];
+    stats_.RecordProbe(bucket.Size());
+    return bucket.Contains(key, h);
+  }
+
+  bool ShouldResize(const TableState& state) const {
+    return size_.Exceeds(kLoadFactorThreshold * state.buckets.size());
+  }
+
+  // Whether |state| is below the shrink load factor and may shrink (see
+  // table_sizing.h), using the counter's fast path as above.
+  bool ShouldShrink(const TableState& state) const {
+    const size_t capacity = state.buckets.size();
+    if (!sizing_.CanShrink(capacity)) {
+      return false;
+    }
+    const size_t bound = sizing_.ShrinkBound(capacity);
+    return bound > 0 && !size_.Exceeds(bound - 1);
+  }
+
+  bool NeedsResize(const TableState& state, ResizeGoal goal) const {
+    return goal == ResizeGoal::kGrow ? ShouldResize(state)
+                                     : ShouldShrink(state);
+  }
+
+  // Applies |op| to every element of a batch, holding a |Lock| on its bucket.
+  // Buckets are computed against the table current at the start of the
+  // batch; elements that a concurrent resize moved to another bucket are
+  // retried one by one at the end. If there is a |resize_goal|, the table is
+  // resized for it after each bucket once it is met.
+  template <typename Lock, typename Op>
+  std::vector<bool> ForEachByBucket(std::span<const T> elems,
+                                    std::optional<ResizeGoal> resize_goal,
+                                    Op&& op) {
+    const size_t n = elems.size();
+    std::vector<bool> results(n);
+
+    EpochGuard epoch_guard;
+    const TableState* snapshot = state_.load(std::memory_order_acquire);
+    std::vector<size_t> hashes(n);
+    std::vector<size_t> bucket_of(n);
+    for (size_t i = 0; i < n; ++i) {
+      hashes[i] = HashPolicy::Hash(elems[i]);
+      bucket_of[i] = BucketIndex(hashes[i], *snapshot);
+    }
+    const std::vector<size_t> order = BatchOrder(bucket_of);
+
+    std::vector<size_t> leftovers;
+    const auto apply = [&](const size_t* first, const size_t* last) {
+      size_t index;
+      Lock bucket_lock;
+      TableState* state = LockBucket(hashes[*first], index, bucket_lock);
+      for (const size_t* it = first; it != last; ++it) {
+        if (BucketIndex(hashes[*it], *state) != index) {
+          leftovers.push_back(*it);
+          continue;
+        }
+        results[*it] = op(*state, index, elems[*it], hashes[*it]);
+      }
+
+      const bool should_resize =
+          resize_goal.has_value() && NeedsResize(*state, *resize_goal);
       bucket_lock.unlock();
       if (should_resize) {
-        MaybeResize(state);
+        MaybeResize(state, *resize_goal);
       }
+    };
 
-      return true;
+    size_t begin = 0;
+    while (begin < n) {
+      size_t end = begin + 1;
+      while (end < n && bucket_of[order[end]] == bucket_of[order[begin]]) {
+        ++end;
+      }
+      if (begin + kBatchPrefetchDistance < n) {
+        const size_t upcoming = order[begin + kBatchPrefetchDistance];
+        PrefetchForRead(&snapshot->buckets[bucket_of[upcoming]]);
+      }
+      apply(order.data() + begin, order.data() + end);
+      begin = end;
     }
+
+    // A leftover is processed on its own, so it always matches the bucket
+    // that gets locked for it and is never deferred again.
+    for (size_t k = 0; k < leftovers.size(); ++k) {
+      const size_t i = leftovers[k];
+      apply(&i, &i + 1);
+    }
+    return results;
   }
 
-  bool Remove(T elem) final {
+  // Locks the bucket of hash |h| exclusively in the newest table it can be
+  // found in. Tables that are being (or have been) migrated are followed
+  // through |next|, moving the bucket across first if nobody has yet. The
+  // caller must be pinned to the epoch domain for as long as it uses the
+  // result.
+  TableState* LockBucket(size_t h, size_t& index, ExclusiveLock& bucket_lock) {
+    TableState* state = state_.load(std::memory_order_acquire);
     while (true) {
-      auto state = std::atomic_load(&state_);
-      const size_t index = BucketIndex(elem, *state);
-      std::unique_lock<std::shared_mutex> bucket_lock(state->locks[index]);
-      if (state != std::atomic_load(&state_)) {
-        continue;
-      }
-
-      auto& bucket = state->buckets[index];
-      for (auto it = bucket.begin(); it != bucket.end(); ++it) {
-        if (*it == elem) {
-          bucket.erase(it);
-          size_.fetch_sub(1, std::memory_order_relaxed);
-          return true;
-        }
+      index = BucketIndex(h, *state);
+      bucket_lock =
+          AcquireLock<ExclusiveLock>(state->locks[index].mutex, stats_);
+      TableState* next = state->next.load(std::memory_order_acquire);
+      if (next == nullptr) {
+        return state;
       }
 
-      return false;
+      MigrateBucket(*state, *next, index);
+      bucket_lock.unlock();
+      HelpMigrate(*state, *next);
+      state = next;
     }
   }
 
-  [[nodiscard]] bool Contains(T elem) final {
+  // As above, but takes a shared lock. Migrating a bucket still needs it
+  // exclusively, so that is done under a separate lock.
+  TableState* LockBucket(size_t h, size_t& index, SharedLock& bucket_lock) {
+    TableState* state = state_.load(std::memory_order_acquire);
     while (true) {
-      auto state = std::atomic_load(&state_);
-      const size_t index = BucketIndex(elem, *state);
-      std::shared_lock<std::shared_mutex> bucket_lock(state->locks[index]);
-      if (state != std::atomic_load(&state_)) {
-        continue;
+      index = BucketIndex(h, *state);
+      bucket_lock = AcquireLock<SharedLock>(state->locks[index].mutex, stats_);
+      TableState* next = state->next.load(std::memory_order_acquire);
+      if (next == nullptr) {
+        return state;
       }
 
-      const auto& bucket = state->buckets[index];
-      return std::find(bucket.begin(), bucket.end(), elem) != bucket.end();
+      const bool migrated = state->locks[index].migrated;
+      bucket_lock.unlock();
+      if (!migrated) {
+        ExclusiveLock exclusive(state->locks[index].mutex);
+        MigrateBucket(*state, *next, index);
+      }
+      HelpMigrate(*state, *next);
+      state = next;
     }
   }
 
-  [[nodiscard]] size_t Size() const final {
-    return size_.load(std::memory_order_acquire);
+  // Moves bucket |index| of |from| into |to|. Must be called with the lock of
+  // the bucket held exclusively. When |to| is a multiple of the size of
+  // |from|, the destination buckets receive elements from this bucket only,
+  // and nobody touches them until it is marked as migrated. A smaller |to|
+  // merges several buckets into one, which operations on the buckets already
+  // migrated may be using, so it is locked too; locks are always taken in
+  // the old table first.
+  void MigrateBucket(TableState& from, TableState& to, size_t index) {
+    if (from.locks[index].migrated) {
+      return;
+    }
+
+    ExclusiveLock merged_bucket_lock;
+    if (to.buckets.size() < from.buckets.size()) {
+      merged_bucket_lock = ExclusiveLock(
+          to.locks[HashPolicy::FoldIndex(index, from.buckets.size(),
+                                         to.buckets.size())]
+              .mutex);
+    }
+
+    from.buckets[index].Drain(PolicyHasher<HashPolicy>(),
+                              [&to](T&& elem, size_t h) {
+                                to.buckets[BucketIndex(h, to)].Insert(
+                                    std::move(elem), h);
+                              });
+    from.locks[index].migrated = true;
+
+    // Whoever moves the last bucket publishes the new table and retires the
+    // old one; threads still holding |from| are pinned and keep it alive.
+    const size_t migrated =
+        from.migrated_buckets.fetch_add(1, std::memory_order_acq_rel) + 1;
+    if (migrated == from.buckets.size()) {
+      state_.store(&to, std::memory_order_release);
+      EpochDomain::Global().Retire(&from);
+    }
   }
 
- private:
-  struct TableState {
-    explicit TableState(size_t capacity) : buckets(capacity), locks(capacity) {}
+  // Migrates every bucket of the current table that has not been yet, if it
+  // is being migrated, and returns the table that is then current. Must be
+  // called with resize_mutex_ held and the epoch pinned.
+  TableState* FinishMigration() {
+    TableState* state = state_.load(std::memory_order_acquire);
+    TableState* next = state->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      return state;
+    }
 
-    std::vector<std::vector<T>> buckets;
-    std::vector<std::shared_mutex> locks;
-  };
+    // Every bucket is migrated before we get its lock, so whoever moved the
+    // last one has published |next| by the end.
+    const auto rehash_timer = stats_.TimeRehash();
+    for (size_t index = 0; index < state->buckets.size(); ++index) {
+      ExclusiveLock bucket_lock(state->locks[index].mutex);
+      MigrateBucket(*state, *next, index);
+    }
+    assert(state_.load(std::memory_order_acquire) == next);
+    return next;
+  }
+
+  // Migrates the next unclaimed chunk of buckets of |from|, if any.
+  void HelpMigrate(TableState& from, TableState& to) {
+    const size_t capacity = from.buckets.size();
+    if (from.migrated_buckets.load(std::memory_order_relaxed) == capacity) {
+      return;
+    }
 
-  static size_t BucketIndex(const T& elem, const TableState& state) {
-    return std::hash<T>{}(elem) % state.buckets.size();
+    const size_t begin = from.migration_cursor.fetch_add(
+        kMigrationChunk, std::memory_order_relaxed);
+    const size_t end = std::min(begin + kMigrationChunk, capacity);
+    if (begin >= end) {
+      return;
+    }
+    const auto rehash_timer = stats_.TimeRehash();
+    for (size_t index = begin; index < end; ++index) {
+      ExclusiveLock bucket_lock(from.locks[index].mutex);
+      MigrateBucket(from, to, index);
+    }
   }
 
-  void MaybeResize(const std::shared_ptr<TableState>& expected_state) {
-    if (size_.load(std::memory_order_relaxed) <=
-        kLoadFactorThreshold * expected_state->buckets.size()) {
+  // Resizes the table for |goal| if |expected_state| is still current, no
+  // other resize is running and the goal is still met.
+  void MaybeResize(const TableState* expected_state, ResizeGoal goal) {
+    if (!NeedsResize(*expected_state, goal)) {
       return;
     }
 
@@ -113,40 +710,81 @@ class HashSetRefinable : public HashSetBase<T> {
       return;
     }
 
-    auto current_state = std::atomic_load(&state_);
-    if (current_state != expected_state) {
+    TableState* current_state = state_.load(std::memory_order_acquire);
+    if (current_state != expected_state ||
+        current_state->next.load(std::memory_order_acquire) != nullptr) {
       return;
     }
 
-    if (size_.load(std::memory_order_relaxed) <=
-        kLoadFactorThreshold * current_state->buckets.size()) {
+    if (!NeedsResize(*current_state, goal)) {
       return;
     }
 
-    std::vector<std::unique_lock<std::shared_mutex>> bucket_guards;
-    bucket_guards.reserve(current_state->locks.size());
-    for (auto& lock : current_state->locks) {
-      bucket_guards.emplace_back(lock);
+    const size_t capacity = current_state->buckets.size();
+    const size_t new_capacity =
+        goal == ResizeGoal::kGrow
+            ? HashPolicy::Capacity(capacity * kGrowthFactor)
+            : sizing_.FitCapacity(size_.Size(), capacity);
+    if (new_capacity == capacity) {
+      return;
     }
+    StartResize(current_state, new_capacity, resize_mode_, resize_guard);
+  }
 
-    const size_t new_capacity = current_state->buckets.size() * 4;
-    auto new_state = std::make_shared<TableState>(new_capacity);
-    for (const auto& bucket : current_state->buckets) {
-      for (const auto& elem : bucket) {
-        const size_t new_index =
-            std::hash<T>{}(elem) % new_state->buckets.size();
-        new_state->buckets[new_index].push_back(elem);
-      }
+  // Moves the elements of |current_state|, which must have no next table,
+  // into a new table of |new_capacity| buckets, by |mode|. Must be called
+  // with |resize_guard| holding resize_mutex_ and the epoch pinned; an
+  // incremental resize releases it once the new table is published.
+  void StartResize(TableState* current_state, size_t new_capacity,
+                   ResizeMode mode,
+                   std::unique_lock<std::mutex>& resize_guard) {
+    stats_.RecordResize();
+    auto* new_state = new TableState(new_capacity);
+
+    if (mode == ResizeMode::kIncremental) {
+      current_state->next.store(new_state, std::memory_order_release);
+      resize_guard.unlock();
+      HelpMigrate(*current_state, *new_state);
+      return;
     }
 
-    std::atomic_store(&state_, new_state);
+    const auto rehash_timer = stats_.TimeRehash();
+    std::vector<ExclusiveLock> bucket_guards;
+    bucket_guards.reserve(current_state->locks.size());
+    for (BucketLock& lock : current_state->locks) {
+      bucket_guards.emplace_back(lock.mutex);
+    }
+
+    // Every bucket lock is held here on behalf of the rehash workers, which
+    // migrate disjoint ranges of buckets (see parallel_rehash.h). A smaller
+    // table merges buckets, so it is filled by this thread alone.
+    current_state->next.store(new_state, std::memory_order_release);
+    const size_t capacity = current_state->buckets.size();
+    const size_t workers =
+        new_capacity < capacity
+            ? 1
+            : RehashWorkerCount(
+                  size_.Size(), capacity,
+                  parallel_rehash_threshold_.load(std::memory_order_relaxed));
+    ForEachBucketRange(capacity, workers, [&](size_t begin, size_t end) {
+      for (size_t index = begin; index < end; ++index) {
+        MigrateBucket(*current_state, *new_state, index);
+      }
+    });
   }
 
   static constexpr size_t kLoadFactorThreshold = 4;
+  static constexpr size_t kGrowthFactor = 4;
+  static constexpr size_t kMigrationChunk = 64;
 
-  mutable std::mutex resize_mutex_;
-  std::shared_ptr<TableState> state_;
-  std::atomic<size_t> size_;
+  const ResizeMode resize_mode_;
+  mutable std::mutex resize_mutex_;  // serialize resizes and traversals
+  std::atomic<TableState*> state_;  // current table
+  ShardedCounter size_;
+  [[no_unique_address]] SetStats stats_;
+  std::atomic<size_t> parallel_rehash_threshold_{
+      kDefaultParallelRehashThreshold};
+  TableSizing sizing_;  // shrinking and minimum capacity
 };
 
 #endif  // HASH_SET_REFINABLE_H
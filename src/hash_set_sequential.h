@@ -1,116 +1,358 @@
 #ifndef HASH_SET_SEQUENTIAL_H
 #define HASH_SET_SEQUENTIAL_H
 
-#include <algorithm>
 #include <cassert>
-#include <functional>
+#include <concepts>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <utility>
 #include <vector>
 
+#include "src/arena.h"
+#include "src/batch_order.h"
+#include "src/bucket_storage.h"
+#include "src/bulk_load.h"
+#include "src/hash_policy.h"
 #include "src/hash_set_base.h"
+#include "src/parallel_rehash.h"
+#include "src/set_stats.h"
+#include "src/snapshot.h"
+#include "src/table_sizing.h"
 
 // ============================================================================
 // Sequential (single-threaded) hash set implementation.
 // ----------------------------------------------------------------------------
 //  - Not thread-safe.
-//  - Uses std::vector<std::vector<T>> as the table.
+//  - Uses a std::vector of buckets as the table; the bucket layout is chosen
+//    by the Storage policy (see bucket_storage.h).
+//  - Hashing and bucket indexing are chosen by the HashPolicy (see
+//    hash_policy.h).
+//  - Buckets allocate through the Allocator, which may give every table an
+//    arena of its own (see arena.h).
+//  - Probes and resizes are counted in builds with HASH_SET_STATS (see
+//    set_stats.h).
 //  - Simple chaining for collision resolution.
-//  - Automatically resizes when load factor exceeds threshold.
+//  - Automatically resizes when load factor exceeds threshold, and shrinks
+//    when it falls below the shrink load factor (see table_sizing.h).
 // ============================================================================
 
-template <typename T>
+template <typename T, typename Storage = VectorBucketStorage,
+          typename HashPolicy = ModuloHashPolicy<>,
+          typename Allocator = std::allocator<T>>
 class HashSetSequential : public HashSetBase<T> {
+  using Bucket = typename Storage::template Bucket<T, Allocator>;
+  using BucketAllocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Bucket>;
+  using Table = std::vector<Bucket, BucketAllocator>;
+
  public:
   explicit HashSetSequential(size_t initial_capacity)
-      : table_(initial_capacity), size_(0) {
+      : table_allocator_(std::make_unique<TableAllocator<Allocator>>()),
+        table_(HashPolicy::Capacity(initial_capacity),
+               BucketAllocator(table_allocator_->Get())),
+        size_(0),
+        sizing_(table_.size(), kLoadFactorThreshold, kGrowthFactor) {
     assert(initial_capacity > 0 && "Initial capacity must be > 0");
   }
 
+  // --------------------------------------------------------------------------
+  // Builds the set from |elems| in one pass, with a table sized for all of
+  // them (see bulk_load.h). The capacity never shrinks below
+  // |initial_capacity|.
+  // --------------------------------------------------------------------------
+  HashSetSequential(std::span<const T> elems, BulkKeys keys,
+                    size_t initial_capacity = 1)
+      : HashSetSequential(initial_capacity) {
+    BulkLoad(elems, keys);
+  }
+
   // --------------------------------------------------------------------------
   // Insert an element if not already present.
   // Returns true if insertion occurred, false if element already exists.
   // --------------------------------------------------------------------------
-  bool Add(T elem) final {
-    size_t index = BucketIndex(elem);
-    auto& bucket = table_[index];
+  bool Add(T elem) final { return AddKey(std::move(elem)); }
 
-    // check if already exists
-    if (std::find(bucket.begin(), bucket.end(), elem) != bucket.end()) {
+  // Builds the element from |key| only if it is absent.
+  template <HeterogeneousKey<T, HashPolicy> K>
+    requires std::constructible_from<T, K>
+  bool Add(K&& key) {
+    return AddKey(std::forward<K>(key));
+  }
+
+  // --------------------------------------------------------------------------
+  // Remove an element if present.
+  // Returns true if removal occurred, false otherwise.
+  // --------------------------------------------------------------------------
+  bool Remove(T elem) final { return RemoveKey(elem); }
+
+  template <HeterogeneousKey<T, HashPolicy> K>
+  bool Remove(const K& key) {
+    return RemoveKey(key);
+  }
+
+  // --------------------------------------------------------------------------
+  // Check if an element is in the hash set.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool Contains(T elem) final { return ContainsKey(elem); }
+
+  template <HeterogeneousKey<T, HashPolicy> K>
+  [[nodiscard]] bool Contains(const K& key) {
+    return ContainsKey(key);
+  }
+
+  // --------------------------------------------------------------------------
+  // Element access, for maps built on the set (see hash_map.h). Visit()
+  // calls |f| with the element equal to |key| and returns whether there was
+  // one. AddOrModify() applies |modify| to that element, or inserts |make()|
+  // if there is none, and returns whether it inserted; |modify| must leave
+  // the element equal to |key|, and |make()| may move from it.
+  // --------------------------------------------------------------------------
+  template <LookupKey<T, HashPolicy> K, typename F>
+  bool Visit(const K& key, F&& f) const {
+    const size_t h = HashPolicy::Hash(key);
+    const auto& bucket = table_[BucketIndex(h)];
+    stats_.RecordProbe(bucket.Size());
+    const T* elem = bucket.Find(key, h);
+    if (elem == nullptr) {
       return false;
     }
+    f(*elem);
+    return true;
+  }
 
-    // insert new element
-    bucket.push_back(elem);
+  template <LookupKey<T, HashPolicy> K, typename Make, typename Modify>
+  bool AddOrModify(const K& key, Make&& make, Modify&& modify) {
+    const size_t h = HashPolicy::Hash(key);
+    auto& bucket = table_[BucketIndex(h)];
+    stats_.RecordProbe(bucket.Size());
+    if (bucket.Modify(key, h, modify)) {
+      return false;
+    }
+
+    T elem = make();
+    assert(HashPolicy::Hash(elem) == h && "make() must build |key|");
+    bucket.Insert(std::move(elem), h);
     ++size_;
 
     // resize if load factor exceeded
     if (size_ > kLoadFactorThreshold * table_.size()) {
-      Resize();
+      Resize(HashPolicy::Capacity(table_.size() * kGrowthFactor));
     }
     return true;
   }
 
   // --------------------------------------------------------------------------
-  // Remove an element if present.
-  // Returns true if removal occurred, false otherwise.
+  // Batch lookup: the lookups are interleaved, so that the cache misses of
+  // about 2 * kBatchPrefetchDistance of them overlap (see batch_order.h).
+  // Batch Add and Remove keep the one-by-one default, as they may resize
+  // the table under the lookups in flight.
   // --------------------------------------------------------------------------
-  bool Remove(T elem) final {
-    size_t index = BucketIndex(elem);
-    auto& bucket = table_[index];
+  [[nodiscard]] std::vector<bool> ContainsMany(
+      std::span<const T> elems) final {
+    struct Lookup {
+      size_t hash;
+      const Bucket* bucket;
+    };
+    std::vector<bool> results(elems.size());
+    InterleaveLookups<Lookup>(
+        elems.size(),
+        [&](size_t i) {
+          const size_t h = HashPolicy::Hash(elems[i]);
+          const Bucket* bucket = &table_[BucketIndex(h)];
+          PrefetchForRead(bucket);
+          return Lookup{h, bucket};
+        },
+        [](const Lookup& lookup) { lookup.bucket->PrefetchElements(); },
+        [&](size_t i, const Lookup& lookup) {
+          stats_.RecordProbe(lookup.bucket->Size());
+          results[i] = lookup.bucket->Contains(elems[i], lookup.hash);
+        });
+    return results;
+  }
 
-    for (auto it = bucket.begin(); it != bucket.end(); ++it) {
-      if (*it == elem) {
-        bucket.erase(it);
-        --size_;
-        return true;
-      }
-    }
-    return false;
+  // --------------------------------------------------------------------------
+  // Return the number of stored elements.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t Size() const final { return size_; }
+
+  // --------------------------------------------------------------------------
+  // Sets the number of elements from which Resize() rehashes on several
+  // threads (see parallel_rehash.h).
+  // --------------------------------------------------------------------------
+  void SetParallelRehashThreshold(size_t num_elements) noexcept {
+    parallel_rehash_threshold_ = num_elements;
   }
 
   // --------------------------------------------------------------------------
-  // Check if an element is in the hash set.
+  // Table sizing (see table_sizing.h). SetShrinkLoadFactor() sets the load
+  // factor below which Remove() shrinks the table, 0 turning shrinking off.
+  // Compact() rebuilds the table at the smallest capacity that fits the
+  // elements, and Reserve() grows it so that |num_elements| fit without
+  // further growth.
   // --------------------------------------------------------------------------
-  [[nodiscard]] bool Contains(T elem) final {
-    const size_t index = BucketIndex(elem);
-    const auto& bucket = table_[index];
+  void SetShrinkLoadFactor(double load_factor) noexcept {
+    sizing_.SetShrinkLoadFactor(load_factor);
+  }
+
+  void Compact() { Resize(sizing_.FitCapacity(size_, table_.size())); }
 
-    return std::find(bucket.begin(), bucket.end(), elem) != bucket.end();
+  void Reserve(size_t num_elements) {
+    sizing_.Reserve(num_elements);
+    const size_t capacity = sizing_.ReserveCapacity(0, table_.size());
+    if (capacity != table_.size()) {
+      Resize(capacity);
+    }
   }
 
+  [[nodiscard]] size_t BucketCount() const noexcept { return table_.size(); }
+
   // --------------------------------------------------------------------------
-  // Return the number of stored elements.
+  // Returns the hot-path statistics and the current bucket lengths (see
+  // set_stats.h).
   // --------------------------------------------------------------------------
-  [[nodiscard]] size_t Size() const final { return size_; }
+  [[nodiscard]] SetStatsSnapshot Stats() const {
+    SetStatsSnapshot snapshot;
+    stats_.AddTo(snapshot);
+    for (const Bucket& bucket : table_) {
+      snapshot.CountBucket(bucket.Size());
+    }
+    return snapshot;
+  }
+
+  void ResetStats() noexcept { stats_.Reset(); }
+
+  // --------------------------------------------------------------------------
+  // Writes the table, bucket by bucket, to a snapshot at |path| (see
+  // snapshot.h).
+  // --------------------------------------------------------------------------
+  void SaveSnapshot(const std::filesystem::path& path) const
+    requires SnapshotElement<T>
+  {
+    SnapshotWriter<T, HashPolicy> writer(path);
+    for (const Bucket& bucket : table_) {
+      writer.AddBucket(bucket);
+    }
+    writer.Finish();
+  }
 
  private:
   // --------------------------------------------------------------------------
-  // Helper: compute the bucket index for an element.
+  // Helpers: Add, Remove and Contains for an element or a heterogeneous key.
+  // The key is hashed once, and the element is built from it (by a move
+  // when it is one) only once it is known to be absent.
   // --------------------------------------------------------------------------
-  [[nodiscard]] size_t BucketIndex(const T& elem) const noexcept {
-    return std::hash<T>{}(elem) % table_.size();
+  template <typename K>
+  bool AddKey(K&& key) {
+    const size_t h = HashPolicy::Hash(key);
+    auto& bucket = table_[BucketIndex(h)];
+    stats_.RecordProbe(bucket.Size());
+
+    // check if already exists
+    if (bucket.Contains(key, h)) {
+      return false;
+    }
+
+    // insert new element
+    bucket.Insert(T(std::forward<K>(key)), h);
+    ++size_;
+
+    // resize if load factor exceeded
+    if (size_ > kLoadFactorThreshold * table_.size()) {
+      Resize(HashPolicy::Capacity(table_.size() * kGrowthFactor));
+    }
+    return true;
+  }
+
+  template <typename K>
+  bool RemoveKey(const K& key) {
+    const size_t h = HashPolicy::Hash(key);
+    auto& bucket = table_[BucketIndex(h)];
+    stats_.RecordProbe(bucket.Size());
+    if (!bucket.Erase(key, h)) {
+      return false;
+    }
+    --size_;
+
+    // shrink if load factor fell below the shrink load factor
+    if (sizing_.ShouldShrink(size_, table_.size())) {
+      Resize(sizing_.FitCapacity(size_, table_.size()));
+    }
+    return true;
+  }
+
+  template <typename K>
+  [[nodiscard]] bool ContainsKey(const K& key) const {
+    const size_t h = HashPolicy::Hash(key);
+    const auto& bucket = table_[BucketIndex(h)];
+    stats_.RecordProbe(bucket.Size());
+    return bucket.Contains(key, h);
   }
 
   // --------------------------------------------------------------------------
-  // Resize the table to double capacity and rehash all elements.
+  // Helper: replace the empty table with one sized for |elems| and filled
+  // with them (see bulk_load.h).
   // --------------------------------------------------------------------------
-  void Resize() {
-    const size_t new_capacity = table_.size() * 2;
-    std::vector<std::vector<T>> new_table(new_capacity);
+  void BulkLoad(std::span<const T> elems, BulkKeys keys) {
+    const size_t capacity =
+        sizing_.ReserveCapacity(elems.size(), table_.size());
+    auto new_allocator = std::make_unique<TableAllocator<Allocator>>();
+    Table new_table(capacity, BucketAllocator(new_allocator->Get()));
+    size_ = BulkFill<HashPolicy>(
+        elems, keys, new_table,
+        RehashWorkerCount(elems.size(), capacity, parallel_rehash_threshold_));
+    table_.swap(new_table);
+    table_allocator_.swap(new_allocator);
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: compute the bucket index for a hash.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t BucketIndex(size_t h) const noexcept {
+    return HashPolicy::Index(h, table_.size());
+  }
 
-    for (const auto& bucket : table_) {
-      for (const auto& elem : bucket) {
-        size_t new_index = std::hash<T>{}(elem) % new_capacity;
-        new_table[new_index].push_back(elem);
+  // --------------------------------------------------------------------------
+  // Resize the table to |new_capacity| buckets and move all elements over.
+  // --------------------------------------------------------------------------
+  void Resize(size_t new_capacity) {
+    stats_.RecordResize();
+    const auto rehash_timer = stats_.TimeRehash();
+    auto new_allocator = std::make_unique<TableAllocator<Allocator>>();
+    Table new_table(new_capacity, BucketAllocator(new_allocator->Get()));
+
+    // Each worker reads its own range of old buckets, which all map to
+    // different new buckets (see parallel_rehash.h). A smaller table merges
+    // old buckets, so it is filled by this thread alone.
+    const size_t workers =
+        new_capacity < table_.size()
+            ? 1
+            : RehashWorkerCount(size_, table_.size(),
+                                parallel_rehash_threshold_);
+    ForEachBucketRange(table_.size(), workers, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        table_[i].Drain(PolicyHasher<HashPolicy>(), [&](T&& elem, size_t h) {
+          new_table[HashPolicy::Index(h, new_capacity)].Insert(std::move(elem),
+                                                               h);
+        });
       }
-    }
+    });
 
+    // The old buckets are destroyed before their allocator.
     table_.swap(new_table);
+    table_allocator_.swap(new_allocator);
   }
 
  private:
-  std::vector<std::vector<T>> table_;  // hash table
-  size_t size_;                        // total elements
+  // What table_ allocates from; declared first, so that it outlives it.
+  std::unique_ptr<TableAllocator<Allocator>> table_allocator_;
+  Table table_;                // hash table
+  size_t size_;                // total elements
+  size_t parallel_rehash_threshold_ = kDefaultParallelRehashThreshold;
+  TableSizing sizing_;         // shrinking and minimum capacity
+  [[no_unique_address]] mutable SetStats stats_;
   static constexpr size_t kLoadFactorThreshold = 4;
+  static constexpr size_t kGrowthFactor = 2;
 };
 
 #endif  // HASH_SET_SEQUENTIAL_H
@@ -0,0 +1,317 @@
+#ifndef HASH_SET_SHARDED_H
+#define HASH_SET_SHARDED_H
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "src/batch_order.h"
+#include "src/bulk_load.h"
+#include "src/cache_line.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_base.h"
+#include "src/numa.h"
+#include "src/set_stats.h"
+#include "src/table_sizing.h"
+
+// ============================================================================
+// NUMA-sharded hash set
+// ----------------------------------------------------------------------------
+//  - A front-end over a power-of-two number of shards, each an independent
+//    Inner set (HashSetStriped, HashSetRefinable, HashSetCuckoo, ...). An
+//    element belongs to the shard named by the top bits of its HashPolicy
+//    hash, so each shard sees its own slice of the hash space, and the low
+//    bits the inner sets index with stay evenly spread.
+//  - Shard i lives on NUMA node i % NumaNodeCount() (see numa.h). It is
+//    built on a thread pinned to that node, under a memory policy that
+//    prefers it, so its table, locks and counters start out there.
+//    On a machine with a single node, shards are not placed at all.
+//  - Every operation runs inside a ScopedNumaNode of its shard, so that the
+//    tables a shard allocates later, when it grows, come from its node too
+//    if the shard allocates through an ArenaAllocator (see arena.h). Shards
+//    that use the global heap instead grow wherever the resizing thread's
+//    memory is.
+//  - Batch operations are split by shard and passed on, so the inner sets
+//    still group them by lock.
+//  - Each shard shrinks on its own as elements are removed from it (see
+//    table_sizing.h); Compact() and Reserve() are passed on to every shard.
+// ============================================================================
+template <typename T, typename Inner, typename HashPolicy = MaskHashPolicy<>>
+class HashSetSharded : public HashSetBase<T> {
+ public:
+  // --------------------------------------------------------------------------
+  // Creates |num_shards| shards (rounded up to a power of two), which share
+  // |initial_capacity| between them.
+  // --------------------------------------------------------------------------
+  explicit HashSetSharded(size_t initial_capacity,
+                          size_t num_shards = DefaultShardCount())
+      : shards_(std::bit_ceil(std::max<size_t>(num_shards, 1))),
+        shard_shift_(kHashBits -
+                     static_cast<size_t>(std::countr_zero(shards_.size()))) {
+    assert(initial_capacity > 0 && "Initial capacity must be > 0");
+    const size_t shard_capacity = ShardCapacity(initial_capacity);
+    BuildShards([shard_capacity](size_t /*index*/) {
+      return std::make_unique<Inner>(shard_capacity);
+    });
+  }
+
+  // --------------------------------------------------------------------------
+  // Builds the set from |elems|: they are split by shard, and every shard is
+  // bulk-loaded with its own (see bulk_load.h).
+  // --------------------------------------------------------------------------
+  HashSetSharded(std::span<const T> elems, BulkKeys keys,
+                 size_t initial_capacity = 1,
+                 size_t num_shards = DefaultShardCount())
+    requires std::constructible_from<Inner, std::span<const T>, BulkKeys,
+                                     size_t>
+      : shards_(std::bit_ceil(std::max<size_t>(num_shards, 1))),
+        shard_shift_(kHashBits -
+                     static_cast<size_t>(std::countr_zero(shards_.size()))) {
+    assert(initial_capacity > 0 && "Initial capacity must be > 0");
+    std::vector<std::vector<T>> parts(shards_.size());
+    for (const T& elem : elems) {
+      parts[ShardIndex(HashPolicy::Hash(elem))].push_back(elem);
+    }
+    const size_t shard_capacity = ShardCapacity(initial_capacity);
+    BuildShards([&parts, keys, shard_capacity](size_t index) {
+      auto set = std::make_unique<Inner>(std::span<const T>(parts[index]),
+                                         keys, shard_capacity);
+      std::vector<T>().swap(parts[index]);
+      return set;
+    });
+  }
+
+  HashSetSharded(const HashSetSharded&) = delete;
+  HashSetSharded& operator=(const HashSetSharded&) = delete;
+
+  // --------------------------------------------------------------------------
+  // Default shard count: one per NUMA node.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] static size_t DefaultShardCount() { return NumaNodeCount(); }
+
+  bool Add(T elem) final {
+    Shard& shard = ShardOf(HashPolicy::Hash(elem));
+    const ScopedNumaNode arena_node(shard.node);
+    return shard.set->Add(std::move(elem));
+  }
+
+  bool Remove(T elem) final {
+    Shard& shard = ShardOf(HashPolicy::Hash(elem));
+    const ScopedNumaNode arena_node(shard.node);
+    return shard.set->Remove(std::move(elem));
+  }
+
+  [[nodiscard]] bool Contains(T elem) final {
+    Shard& shard = ShardOf(HashPolicy::Hash(elem));
+    const ScopedNumaNode arena_node(shard.node);
+    return shard.set->Contains(std::move(elem));
+  }
+
+  std::vector<bool> AddMany(std::span<const T> elems) final {
+    return ForEachByShard(elems, [](Inner& set, std::span<const T> batch) {
+      return set.AddMany(batch);
+    });
+  }
+
+  std::vector<bool> RemoveMany(std::span<const T> elems) final {
+    return ForEachByShard(elems, [](Inner& set, std::span<const T> batch) {
+      return set.RemoveMany(batch);
+    });
+  }
+
+  [[nodiscard]] std::vector<bool> ContainsMany(
+      std::span<const T> elems) final {
+    return ForEachByShard(elems, [](Inner& set, std::span<const T> batch) {
+      return set.ContainsMany(batch);
+    });
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the total number of stored elements, summed over the shards.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t Size() const final {
+    size_t size = 0;
+    for (const Shard& shard : shards_) {
+      size += shard.set->Size();
+    }
+    return size;
+  }
+
+  [[nodiscard]] size_t ShardCount() const noexcept { return shards_.size(); }
+
+  // --------------------------------------------------------------------------
+  // Returns shard |index| and the NUMA node it was placed on, which is
+  // kAnyNumaNode on a machine with a single node.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] Inner& GetShard(size_t index) noexcept {
+    return *shards_[index].set;
+  }
+
+  [[nodiscard]] size_t ShardNode(size_t index) const noexcept {
+    return shards_[index].node;
+  }
+
+  // --------------------------------------------------------------------------
+  // Statistics summed over the shards (see set_stats.h).
+  // --------------------------------------------------------------------------
+  [[nodiscard]] SetStatsSnapshot Stats() const
+    requires ReportsSetStats<Inner>
+  {
+    SetStatsSnapshot snapshot;
+    for (const Shard& shard : shards_) {
+      snapshot.Merge(shard.set->Stats());
+    }
+    return snapshot;
+  }
+
+  void ResetStats()
+    requires ReportsSetStats<Inner>
+  {
+    for (Shard& shard : shards_) {
+      shard.set->ResetStats();
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Table sizing, applied to every shard (see table_sizing.h). Reserve()
+  // gives each shard an equal part of |num_elements|, as the hash spreads
+  // elements evenly over them.
+  // --------------------------------------------------------------------------
+  void SetShrinkLoadFactor(double load_factor)
+    requires SizesTable<Inner>
+  {
+    for (Shard& shard : shards_) {
+      shard.set->SetShrinkLoadFactor(load_factor);
+    }
+  }
+
+  void Compact()
+    requires SizesTable<Inner>
+  {
+    for (Shard& shard : shards_) {
+      const ScopedNumaNode arena_node(shard.node);
+      shard.set->Compact();
+    }
+  }
+
+  void Reserve(size_t num_elements)
+    requires SizesTable<Inner>
+  {
+    const size_t shard_elements =
+        (num_elements + shards_.size() - 1) / shards_.size();
+    for (Shard& shard : shards_) {
+      const ScopedNumaNode arena_node(shard.node);
+      shard.set->Reserve(shard_elements);
+    }
+  }
+
+ private:
+  static constexpr size_t kHashBits = std::numeric_limits<size_t>::digits;
+
+  // Shards are read by every operation and never written after
+  // construction, but keeping each on a line of its own stops the line of a
+  // neighbouring shard from sharing a node with the wrong set.
+  struct alignas(kCacheLineSize) Shard {
+    std::unique_ptr<Inner> set;
+    size_t node = kAnyNumaNode;
+  };
+
+  [[nodiscard]] size_t ShardCapacity(size_t initial_capacity) const noexcept {
+    return std::max<size_t>(1, initial_capacity / shards_.size());
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: place shard i on NUMA node i % NumaNodeCount() and set it to
+  // |make(i)|, called on a thread pinned to that node if there are several.
+  // With a single node there is no locality to gain, so shards are left on
+  // kAnyNumaNode and their arenas allocate from the plain heap.
+  // --------------------------------------------------------------------------
+  template <typename Make>
+  void BuildShards(Make&& make) {
+    const size_t nodes = NumaNodeCount();
+    if (nodes == 1) {
+      for (size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i].node = kAnyNumaNode;
+        shards_[i].set = make(i);
+      }
+      return;
+    }
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      shards_[i].node = i % nodes;
+    }
+
+    std::vector<std::thread> builders;
+    builders.reserve(shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      builders.emplace_back([this, &make, i] {
+        Shard& shard = shards_[i];
+        PinThreadToNumaNode(shard.node);
+        const ScopedNumaMemoryPolicy memory_policy(shard.node);
+        const ScopedNumaNode arena_node(shard.node);
+        shard.set = make(i);
+      });
+    }
+    for (std::thread& builder : builders) {
+      builder.join();
+    }
+  }
+
+  // The shift is kHashBits for a single shard, which must not be applied.
+  [[nodiscard]] size_t ShardIndex(size_t h) const noexcept {
+    return shard_shift_ == kHashBits ? 0 : h >> shard_shift_;
+  }
+
+  [[nodiscard]] Shard& ShardOf(size_t h) noexcept {
+    return shards_[ShardIndex(h)];
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: split a batch by shard, pass each shard its elements through
+  // |op(set, batch)|, and put the results back in input order.
+  // --------------------------------------------------------------------------
+  template <typename Op>
+  std::vector<bool> ForEachByShard(std::span<const T> elems, Op&& op) {
+    const size_t n = elems.size();
+    std::vector<size_t> shard_of(n);
+    for (size_t i = 0; i < n; ++i) {
+      shard_of[i] = ShardIndex(HashPolicy::Hash(elems[i]));
+    }
+    const std::vector<size_t> order = BatchOrder(shard_of);
+
+    std::vector<bool> results(n);
+    std::vector<T> batch;
+    size_t begin = 0;
+    while (begin < n) {
+      size_t end = begin + 1;
+      while (end < n && shard_of[order[end]] == shard_of[order[begin]]) {
+        ++end;
+      }
+      batch.clear();
+      for (size_t k = begin; k < end; ++k) {
+        batch.push_back(elems[order[k]]);
+      }
+
+      Shard& shard = shards_[shard_of[order[begin]]];
+      const ScopedNumaNode arena_node(shard.node);
+      const std::vector<bool> batch_results = op(*shard.set, batch);
+      for (size_t k = begin; k < end; ++k) {
+        results[order[k]] = batch_results[k - begin];
+      }
+      begin = end;
+    }
+    return results;
+  }
+
+  std::vector<Shard> shards_;  // power-of-two count
+  size_t shard_shift_;         // kHashBits - log2(shard count)
+};
+
+#endif  // HASH_SET_SHARDED_H
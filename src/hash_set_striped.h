@@ -4,28 +4,143 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
-#include <functional>
+#include <concepts>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "src/arena.h"
+#include "src/batch_order.h"
+#include "src/bucket_storage.h"
+#include "src/bulk_load.h"
+#include "src/epoch.h"
+#include "src/hash_policy.h"
 #include "src/hash_set_base.h"
+#include "src/lock_policy.h"
+#include "src/parallel_rehash.h"
+#include "src/set_stats.h"
+#include "src/sharded_counter.h"
+#include "src/snapshot.h"
+#include "src/table_sizing.h"
 
 // ============================================================================
 // Striped Hash Set
 // ----------------------------------------------------------------------------
-//  - Thread-safe via per-bucket locking (finer granularity).
-//  - Uses a fixed number of locks, one per bucket, created at initialization.
-//  - Automatically resizes when load factor exceeds threshold.
-//  - Resize operation locks all buckets.
+//  - Thread-safe via lock striping: lock i guards every bucket whose
+//    elements hash to stripe i, i.e. HashPolicy::Index(h, num_stripes) == i.
+//  - The stripe count is independent of the bucket count; by default it
+//    scales with std::thread::hardware_concurrency().
+//  - The table always holds a multiple of the stripe count buckets, so a
+//    bucket never straddles two stripes.
+//  - Bucket layout is chosen by the Storage policy (see bucket_storage.h).
+//  - Buckets allocate through the Allocator, which may give every table an
+//    arena of its own (see arena.h).
+//  - Hashing and bucket indexing are chosen by the HashPolicy (see
+//    hash_policy.h). The stripe count is rounded to a size the policy
+//    supports as well.
+//  - The stripe locks are of the LockPolicy's Mutex type, and each stripe
+//    (its lock and seqlock version) gets a cache line of its own if the
+//    policy's layout is padded (see lock_policy.h).
+//  - Lock contention (also per stripe), probes and resizes are counted in
+//    builds with HASH_SET_STATS (see set_stats.h). Optimistic lookups are
+//    not counted as probes.
+//  - Automatically resizes when load factor exceeds threshold, and shrinks
+//    when it falls below the shrink load factor (see table_sizing.h).
+//  - Resize operation locks all stripes, and may double the stripe count a
+//    bounded number of times so that lock throughput grows with the table.
+//    Shrinking keeps the stripe count, and the table a multiple of it.
+//  - With a Storage whose buckets support optimistic reads (InlineBucketStorage
+//    of a trivially copyable, lock-free atomic T), Contains() does not lock:
+//    every stripe carries a seqlock version that writers make odd while they
+//    modify one of its buckets, and a reader that saw the same even version
+//    before and after scanning a bucket has read a consistent bucket. It falls
+//    back to the stripe lock after a few conflicts, or when the element could
+//    be in an overflowing bucket's spill vector; a larger inline capacity N
+//    makes the latter rare. Replaced tables are then freed through the epoch
+//    domain (see epoch.h), as readers may still be scanning them.
 // ============================================================================
-template <typename T>
+template <typename T, typename Storage = VectorBucketStorage,
+          typename HashPolicy = ModuloHashPolicy<>,
+          typename Allocator = std::allocator<T>,
+          typename LockPolicy = StdLockPolicy>
 class HashSetStriped : public HashSetBase<T> {
+  using Bucket = typename Storage::template Bucket<T, Allocator>;
+  using BucketAllocator =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<Bucket>;
+
+  struct Table {
+    explicit Table(size_t capacity)
+        : buckets(capacity, BucketAllocator(allocator.Get())) {}
+    // Declared first, so that it outlives the buckets.
+    [[no_unique_address]] TableAllocator<Allocator> allocator;
+    std::vector<Bucket, BucketAllocator> buckets;
+  };
+
+  using StripeMutex = typename LockPolicy::Mutex;
+  using StripeLock = std::unique_lock<StripeMutex>;
+
+  struct Stripe {
+    StripeMutex mutex;
+    std::atomic<uint64_t> version{0};  // seqlock, odd while a write is open
+    [[no_unique_address]] StatCounter contentions;
+  };
+  using StripeSlot = LockSlot<LockPolicy, Stripe>;
+
  public:
-  explicit HashSetStriped(size_t initial_capacity)
-      : table_(initial_capacity),
-        locks_(initial_capacity),  // one lock per bucket
-        size_(0) {
+  // --------------------------------------------------------------------------
+  // Creates a set with at least |initial_capacity| buckets guarded by
+  // |num_stripes| locks (rounded up to a stripe count the HashPolicy
+  // supports). Each Resize() that grows the table also doubles the stripe
+  // count, until it has done so |max_stripe_growths| times. Every lock that
+  // will ever be used is allocated up front.
+  // --------------------------------------------------------------------------
+  explicit HashSetStriped(size_t initial_capacity,
+                          size_t num_stripes = DefaultStripeCount(),
+                          size_t max_stripe_growths = 0)
+      : table_(new Table(HashPolicy::Capacity(RoundUpToMultiple(
+            initial_capacity, HashPolicy::Capacity(num_stripes))))),
+        bucket_count_(LockedTable().buckets.size()),
+        stripes_(HashPolicy::Capacity(num_stripes) << max_stripe_growths),
+        num_stripes_(HashPolicy::Capacity(num_stripes)),
+        stripe_growths_left_(max_stripe_growths),
+        sizing_(LockedTable().buckets.size(), kLoadFactorThreshold,
+                kGrowthFactor) {
     assert(initial_capacity > 0 && "Initial capacity must be > 0");
+    assert(num_stripes > 0 && "Stripe count must be > 0");
+  }
+
+  // --------------------------------------------------------------------------
+  // Builds the set from |elems| in one pass, with a table sized for all of
+  // them (see bulk_load.h). The stripe count grows as if the table had grown
+  // to that size one resize at a time.
+  // --------------------------------------------------------------------------
+  HashSetStriped(std::span<const T> elems, BulkKeys keys,
+                 size_t initial_capacity = 1,
+                 size_t num_stripes = DefaultStripeCount(),
+                 size_t max_stripe_growths = 0)
+      : HashSetStriped(initial_capacity, num_stripes, max_stripe_growths) {
+    BulkLoad(elems, keys);
+  }
+
+  ~HashSetStriped() override { delete table_.load(std::memory_order_relaxed); }
+
+  HashSetStriped(const HashSetStriped&) = delete;
+  HashSetStriped& operator=(const HashSetStriped&) = delete;
+
+  // --------------------------------------------------------------------------
+  // Default stripe count: a few locks per hardware thread, so that threads
+  // rarely collide on a stripe even when the table is small.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] static size_t DefaultStripeCount() noexcept {
+    const size_t hardware_threads =
+        std::max(1u, std::thread::hardware_concurrency());
+    return hardware_threads * kStripesPerThread;
   }
 
   // --------------------------------------------------------------------------
@@ -33,126 +148,822 @@ class HashSetStriped : public HashSetBase<T> {
   // Returns true if the insertion occurred, false if the element was already
   // present.
   // --------------------------------------------------------------------------
-  bool Add(T elem) final {
-    const size_t h = std::hash<T>{}(elem);
-    const size_t lock_index = h % locks_.size();  // lock by hash only
-    std::unique_lock<std::mutex> lock(locks_[lock_index]);
+  bool Add(T elem) final { return AddKey(std::move(elem)); }
 
-    const size_t index = h % table_.size();  // bucket uses current table size
-    auto& bucket = table_[index];
+  // Builds the element from |key| only if it is absent.
+  template <HeterogeneousKey<T, HashPolicy> K>
+    requires std::constructible_from<T, K>
+  bool Add(K&& key) {
+    return AddKey(std::forward<K>(key));
+  }
 
-    // Check for duplicates
-    if (std::find(bucket.begin(), bucket.end(), elem) != bucket.end()) {
+  // --------------------------------------------------------------------------
+  // Removes an element if present.
+  // Returns true if removal occurred, false otherwise.
+  // --------------------------------------------------------------------------
+  bool Remove(T elem) final { return RemoveKey(elem); }
+
+  template <HeterogeneousKey<T, HashPolicy> K>
+  bool Remove(const K& key) {
+    return RemoveKey(key);
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns true if the element is present in the set. Only lookups by T
+  // take the optimistic path; heterogeneous keys always lock.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool Contains(T elem) final {
+    const size_t h = HashPolicy::Hash(elem);
+    if constexpr (kOptimisticReads) {
+      const EpochGuard epoch_guard;
+      return ContainsOptimistically(elem, h);
+    } else {
+      const StripeLock guard = LockStripe(h);
+      return ContainsLocked(elem, h);
+    }
+  }
+
+  template <HeterogeneousKey<T, HashPolicy> K>
+  [[nodiscard]] bool Contains(const K& key) {
+    const size_t h = HashPolicy::Hash(key);
+    const StripeLock guard = LockStripe(h);
+    return ContainsLocked(key, h);
+  }
+
+  // --------------------------------------------------------------------------
+  // Element access, for maps built on the set (see hash_map.h). Visit()
+  // calls |f| with the element equal to |key|, under its stripe lock, and
+  // returns whether there was one. AddOrModify() applies |modify| to that
+  // element, or inserts |make()| if there is none, and returns whether it
+  // inserted; |modify| must leave the element equal to |key|, and |make()|
+  // may move from it. Both lock even with optimistic reads, so that |f| never
+  // sees an element that a writer is changing.
+  // --------------------------------------------------------------------------
+  template <LookupKey<T, HashPolicy> K, typename F>
+  bool Visit(const K& key, F&& f) const {
+    const size_t h = HashPolicy::Hash(key);
+    const StripeLock guard = LockStripe(h);
+    const Table& table = LockedTable();
+    const auto& bucket =
+        table.buckets[HashPolicy::Index(h, table.buckets.size())];
+    stats_.RecordProbe(bucket.Size());
+    const T* elem = bucket.Find(key, h);
+    if (elem == nullptr) {
       return false;
     }
+    f(*elem);
+    return true;
+  }
 
-    // Insert new element
-    bucket.push_back(elem);
-    ++size_;  // atomic
+  template <LookupKey<T, HashPolicy> K, typename Make, typename Modify>
+  bool AddOrModify(const K& key, Make&& make, Modify&& modify) {
+    const size_t h = HashPolicy::Hash(key);
+    StripeLock lock = LockStripe(h);
+    Table& table = LockedTable();
+    auto& bucket = table.buckets[HashPolicy::Index(h, table.buckets.size())];
+    stats_.RecordProbe(bucket.Size());
+
+    {
+      const StripeWriteScope write_scope = BeginStripeWrite(h);
+      if (bucket.Modify(key, h, modify)) {
+        return false;
+      }
+      T elem = make();
+      assert(HashPolicy::Hash(elem) == h && "make() must build |key|");
+      bucket.Insert(std::move(elem), h);
+    }
+    size_.Increment();  // sharded, touches this thread's shard only
 
     // Check load factor and resize if needed
-    if (LoadFactor() > kLoadFactorThreshold) {
+    if (ExceedsLoadFactor()) {
       lock.unlock();  // release this bucket's lock before resizing
-      Resize();  // locks all buckets internally (serialized by resize_mutex_)
+      Resize(ResizeGoal::kGrow);  // locks all buckets internally
     }
     return true;
   }
 
   // --------------------------------------------------------------------------
-  // Removes an element if present.
-  // Returns true if removal occurred, false otherwise.
+  // Batch operations. Elements are grouped by stripe so that every stripe
+  // lock is taken once per batch instead of once per element.
   // --------------------------------------------------------------------------
-  bool Remove(T elem) final {
-    const size_t h = std::hash<T>{}(elem);
-    const size_t lock_index = h % locks_.size();  // lock by hash only
-    std::lock_guard<std::mutex> guard(locks_[lock_index]);
+  std::vector<bool> AddMany(std::span<const T> elems) final {
+    return ForEachByStripe(elems, ResizeGoal::kGrow,
+                           [this](const T& elem, size_t h) {
+                             return AddLocked(elem, h);
+                           });
+  }
 
-    const size_t index = h % table_.size();
-    auto& bucket = table_[index];
+  std::vector<bool> RemoveMany(std::span<const T> elems) final {
+    return ForEachByStripe(elems, ResizeGoal::kShrink,
+                           [this](const T& elem, size_t h) {
+                             return RemoveLocked(elem, h);
+                           });
+  }
 
-    for (auto it = bucket.begin(); it != bucket.end(); ++it) {
-      if (*it == elem) {
-        bucket.erase(it);
-        --size_;  // atomic
-        return true;
-      }
+  // --------------------------------------------------------------------------
+  // Batch lookup. With optimistic reads, the lookups take no lock and are
+  // interleaved across the whole batch (see InterleaveLookups() in
+  // batch_order.h); otherwise they are grouped by stripe, and interleaved
+  // within each group like the other batch operations.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] std::vector<bool> ContainsMany(
+      std::span<const T> elems) final {
+    if constexpr (kOptimisticReads) {
+      return ContainsManyOptimistically(elems);
+    } else {
+      return ForEachByStripe(elems, /*resize_goal=*/std::nullopt,
+                             [this](const T& elem, size_t h) {
+                               return ContainsLocked(elem, h);
+                             });
     }
-    return false;
   }
 
   // --------------------------------------------------------------------------
-  // Returns true if the element is present in the set.
+  // Returns the total number of stored elements.
   // --------------------------------------------------------------------------
-  [[nodiscard]] bool Contains(T elem) final {
-    const size_t h = std::hash<T>{}(elem);
-    const size_t lock_index = h % locks_.size();  // lock by hash only
-    std::lock_guard<std::mutex> guard(locks_[lock_index]);
+  [[nodiscard]] size_t Size() const final {
+    // Sum the counter shards without locking
+    return size_.Size();
+  }
 
-    const size_t index = h % table_.size();
-    const auto& bucket = table_[index];
+  // --------------------------------------------------------------------------
+  // Computes the current load factor, without locking: the bucket count is
+  // the one Resize() last published, as the table itself may be freed
+  // meanwhile.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] double LoadFactor() const {
+    return static_cast<double>(size_.Size()) /
+           static_cast<double>(bucket_count_.load(std::memory_order_relaxed));
+  }
 
-    return std::find(bucket.begin(), bucket.end(), elem) != bucket.end();
+  // --------------------------------------------------------------------------
+  // Sets the number of elements from which Resize() rehashes on several
+  // threads (see parallel_rehash.h).
+  // --------------------------------------------------------------------------
+  void SetParallelRehashThreshold(size_t num_elements) noexcept {
+    parallel_rehash_threshold_.store(num_elements, std::memory_order_relaxed);
   }
 
   // --------------------------------------------------------------------------
-  // Returns the total number of stored elements.
+  // Table sizing (see table_sizing.h). SetShrinkLoadFactor() sets the load
+  // factor below which Remove() shrinks the table, 0 turning shrinking off.
+  // Compact() rebuilds the table at the smallest capacity that fits the
+  // elements, and Reserve() grows it so that |num_elements| fit without
+  // further growth. Both lock every stripe, like a resize.
   // --------------------------------------------------------------------------
-  [[nodiscard]] size_t Size() const final {
-    // Return current element count atomically without locking
-    return size_.load(std::memory_order_relaxed);
+  void SetShrinkLoadFactor(double load_factor) noexcept {
+    sizing_.SetShrinkLoadFactor(load_factor);
+  }
+
+  void Compact() { Resize(ResizeGoal::kCompact); }
+
+  void Reserve(size_t num_elements) {
+    sizing_.Reserve(num_elements);
+    Resize(ResizeGoal::kReserve);
+  }
+
+  [[nodiscard]] size_t BucketCount() const {
+    const std::lock_guard<std::mutex> resize_lock(resize_mutex_);
+    return LockedTable().buckets.size();
   }
 
   // --------------------------------------------------------------------------
-  // Computes the current load factor.
+  // Returns the number of lock stripes currently in use.
   // --------------------------------------------------------------------------
-  [[nodiscard]] double LoadFactor() const noexcept {
-    return static_cast<double>(size_.load()) /
-           static_cast<double>(table_.size());
+  [[nodiscard]] size_t StripeCount() const noexcept {
+    return num_stripes_.load(std::memory_order_acquire);
+  }
+
+  // --------------------------------------------------------------------------
+  // Calls |f(elem)| for every element. Buckets are visited one at a time
+  // under their stripe lock, so writers only wait for the bucket being
+  // visited, and resizes are postponed until the traversal ends. Elements
+  // present throughout are visited exactly once; elements added or removed
+  // meanwhile at most once. |f| must not call back into the set.
+  // --------------------------------------------------------------------------
+  template <typename F>
+  void ForEach(F&& f) {
+    ForEachParallel(1, f);
+  }
+
+  // --------------------------------------------------------------------------
+  // As ForEach(), but the buckets are split into |num_workers| ranges that
+  // are traversed on as many threads (see parallel_rehash.h), and |f| is
+  // called from all of them concurrently.
+  // --------------------------------------------------------------------------
+  template <typename F>
+  void ForEachParallel(size_t num_workers, F&& f) {
+    VisitBuckets(num_workers,
+                 [&f](const Bucket& bucket) { bucket.ForEach(f); });
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the hot-path statistics and the current bucket lengths (see
+  // set_stats.h). The bucket lengths are taken like a ForEach() traversal.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] SetStatsSnapshot Stats() {
+    SetStatsSnapshot snapshot;
+    VisitBuckets(1, [&snapshot](const Bucket& bucket) {
+      snapshot.CountBucket(bucket.Size());
+    });
+    stats_.AddTo(snapshot);
+    if constexpr (kSetStatsEnabled) {
+      const size_t stripes = StripeCount();
+      for (size_t i = 0; i < stripes; ++i) {
+        snapshot.contended_per_stripe.push_back(stripes_[i].contentions.Load());
+      }
+    }
+    return snapshot;
+  }
+
+  void ResetStats() noexcept {
+    stats_.Reset();
+    for (Stripe& stripe : stripes_) {
+      stripe.contentions.Reset();
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Writes the table, bucket by bucket, to a snapshot at |path| (see
+  // snapshot.h). The buckets are taken like a ForEach() traversal, so the
+  // snapshot is not atomic unless the set is quiescent.
+  // --------------------------------------------------------------------------
+  void SaveSnapshot(const std::filesystem::path& path)
+    requires SnapshotElement<T>
+  {
+    SnapshotWriter<T, HashPolicy> writer(path);
+    VisitBuckets(1, [&writer](const Bucket& bucket) {
+      writer.AddBucket(bucket);
+    });
+    writer.Finish();
   }
 
  private:
   // --------------------------------------------------------------------------
-  // Resizes the hash table.
+  // Helper: calls |visit(bucket)| for every bucket, as described for
+  // ForEach() and ForEachParallel().
+  // --------------------------------------------------------------------------
+  template <typename Visit>
+  void VisitBuckets(size_t num_workers, Visit&& visit) {
+    bool should_resize = false;
+    {
+      // Pins the table and the stripe count: both only change in Resize().
+      const std::lock_guard<std::mutex> resize_lock(resize_mutex_);
+      const Table& table = LockedTable();
+      const size_t capacity = table.buckets.size();
+      const size_t stripes = num_stripes_.load(std::memory_order_relaxed);
+      ForEachBucketRange(capacity, num_workers, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          const std::lock_guard<StripeMutex> lock(
+              stripes_[HashPolicy::FoldIndex(i, capacity, stripes)].mutex);
+          visit(table.buckets[i]);
+        }
+      });
+      should_resize = ExceedsLoadFactor();
+    }
+    if (should_resize) {
+      Resize(ResizeGoal::kGrow);  // one that writers skipped meanwhile
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Helpers: Add and Remove for an element or a heterogeneous key. The key is
+  // hashed once, and the element is built from it (by a move when it is one)
+  // only once it is known to be absent.
+  // --------------------------------------------------------------------------
+  template <typename K>
+  bool AddKey(K&& key) {
+    const size_t h = HashPolicy::Hash(key);
+    StripeLock lock = LockStripe(h);
+
+    if (!AddLocked(std::forward<K>(key), h)) {
+      return false;
+    }
+
+    // Check load factor and resize if needed
+    if (ExceedsLoadFactor()) {
+      lock.unlock();  // release this bucket's lock before resizing
+      Resize(ResizeGoal::kGrow);  // locks all buckets internally
+    }
+    return true;
+  }
+
+  template <typename K>
+  bool RemoveKey(const K& key) {
+    const size_t h = HashPolicy::Hash(key);
+    StripeLock lock = LockStripe(h);
+
+    if (!RemoveLocked(key, h)) {
+      return false;
+    }
+
+    // Check load factor and shrink if needed
+    if (BelowShrinkLoadFactor()) {
+      lock.unlock();
+      Resize(ResizeGoal::kShrink);
+    }
+    return true;
+  }
+
+  // --------------------------------------------------------------------------
+  // Helpers: the single-element operations on a key with hash |h|.
+  // Must be called with the stripe lock for |h| held.
+  // --------------------------------------------------------------------------
+  template <typename K>
+  bool AddLocked(K&& key, size_t h) {
+    Table& table = LockedTable();
+    const size_t index = HashPolicy::Index(h, table.buckets.size());
+    auto& bucket = table.buckets[index];
+    stats_.RecordProbe(bucket.Size());
+
+    // Check for duplicates
+    if (bucket.Contains(key, h)) {
+      return false;
+    }
+
+    // Insert new element
+    {
+      const StripeWriteScope write_scope = BeginStripeWrite(h);
+      bucket.Insert(T(std::forward<K>(key)), h);
+    }
+    size_.Increment();  // sharded, touches this thread's shard only
+    return true;
+  }
+
+  template <typename K>
+  bool RemoveLocked(const K& key, size_t h) {
+    Table& table = LockedTable();
+    const size_t index = HashPolicy::Index(h, table.buckets.size());
+    auto& bucket = table.buckets[index];
+    stats_.RecordProbe(bucket.Size());
+
+    // A miss writes nothing, so it must not make optimistic readers of the
+    // stripe retry; without them the write scope is free and Erase() alone
+    // finds out.
+    if (kOptimisticReads && !bucket.Contains(key, h)) {
+      return false;
+    }
+    {
+      const StripeWriteScope write_scope = BeginStripeWrite(h);
+      if (!bucket.Erase(key, h)) {
+        return false;
+      }
+    }
+    size_.Decrement();  // sharded, touches this thread's shard only
+    return true;
+  }
+
+  template <typename K>
+  [[nodiscard]] bool ContainsLocked(const K& key, size_t h) const {
+    const Table& table = LockedTable();
+    const size_t index = HashPolicy::Index(h, table.buckets.size());
+    const auto& bucket = table.buckets[index];
+    stats_.RecordProbe(bucket.Size());
+
+    return bucket.Contains(key, h);
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: one lock-free attempt at Contains(), for buckets that support
+  // optimistic reads. Returns std::nullopt if a writer interfered, and
+  // kUnknown if the bucket has to be searched under its lock. Must be called
+  // with the epoch pinned.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] std::optional<OptimisticLookup> TryContainsOptimistic(
+      const T& elem, size_t h) const noexcept {
+    const size_t stripes = num_stripes_.load(std::memory_order_acquire);
+    const std::atomic<uint64_t>& version =
+        stripes_[HashPolicy::Index(h, stripes)].version;
+    const uint64_t before = version.load(std::memory_order_acquire);
+    if ((before & 1) != 0) {
+      return std::nullopt;  // a write is in progress
+    }
+
+    const Table& table = *table_.load(std::memory_order_acquire);
+    const OptimisticLookup lookup =
+        table.buckets[HashPolicy::Index(h, table.buckets.size())]
+            .ContainsOptimistic(elem);
+
+    // A stripe split moves the bucket to a stripe whose version we did not
+    // read, so the stripe count has to be unchanged as well.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version.load(std::memory_order_relaxed) != before ||
+        num_stripes_.load(std::memory_order_relaxed) != stripes) {
+      return std::nullopt;
+    }
+    return lookup;
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: Contains() for buckets that support optimistic reads, i.e. a few
+  // lock-free attempts before falling back to the stripe lock. Must be
+  // called with the epoch pinned.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool ContainsOptimistically(const T& elem, size_t h) const {
+    for (size_t attempt = 0; attempt < kOptimisticAttempts; ++attempt) {
+      const std::optional<OptimisticLookup> lookup =
+          TryContainsOptimistic(elem, h);
+      if (!lookup.has_value()) {
+        continue;  // raced with a writer
+      }
+      if (*lookup == OptimisticLookup::kUnknown) {
+        break;
+      }
+      return *lookup == OptimisticLookup::kFound;
+    }
+    const StripeLock guard = LockStripe(h);
+    return ContainsLocked(elem, h);
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: ContainsMany() with optimistic reads. The inline slots are part
+  // of the bucket, so the pipeline has no element storage to fetch, and a
+  // table replaced by a resize meanwhile stays readable while the epoch is
+  // pinned.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] std::vector<bool> ContainsManyOptimistically(
+      std::span<const T> elems) const {
+    std::vector<bool> results(elems.size());
+    const EpochGuard epoch_guard;
+    InterleaveLookups<size_t>(
+        elems.size(),
+        [&](size_t i) {
+          const size_t h = HashPolicy::Hash(elems[i]);
+          const Table& table = *table_.load(std::memory_order_acquire);
+          PrefetchForRead(
+              &table.buckets[HashPolicy::Index(h, table.buckets.size())]);
+          return h;
+        },
+        [](size_t /*h*/) {},
+        [&](size_t i, size_t h) {
+          results[i] = ContainsOptimistically(elems[i], h);
+        });
+    return results;
+  }
+
+  // --------------------------------------------------------------------------
+  // Seqlock write side: while a scope is alive, the version of its stripe is
+  // odd, so optimistic readers of that stripe retry. Only the holder of the
+  // stripe lock opens one. A scope without a version does nothing; that is
+  // all writers get for buckets without optimistic reads.
+  // --------------------------------------------------------------------------
+  class StripeWriteScope {
+   public:
+    explicit StripeWriteScope(std::atomic<uint64_t>* version) noexcept
+        : version_(version) {
+      if (version_ != nullptr) {
+        version_->store(version_->load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+      }
+    }
+
+    StripeWriteScope(StripeWriteScope&& other) noexcept
+        : version_(std::exchange(other.version_, nullptr)) {}
+    StripeWriteScope& operator=(StripeWriteScope&&) = delete;
+
+    ~StripeWriteScope() {
+      if (version_ != nullptr) {
+        version_->store(version_->load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+      }
+    }
+
+   private:
+    std::atomic<uint64_t>* version_;
+  };
+
+  [[nodiscard]] StripeWriteScope BeginStripeWrite(size_t h) noexcept {
+    if constexpr (kOptimisticReads) {
+      const size_t stripes = num_stripes_.load(std::memory_order_relaxed);
+      return StripeWriteScope(&stripes_[HashPolicy::Index(h, stripes)].version);
+    } else {
+      return StripeWriteScope(nullptr);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the current table. It only changes in Resize(), under every
+  // stripe lock and resize_mutex_, so it is stable while any of them is held.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] Table& LockedTable() const noexcept {
+    return *table_.load(std::memory_order_relaxed);
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: apply |op| to every element of a batch, one stripe at a time.
+  // Within a stripe, the lookups are interleaved (see InterleaveLookups() in
+  // batch_order.h): the table is stable while the stripe lock is held, and
+  // buckets of the stripe can be read to prefetch their elements. If there
+  // is a |resize_goal|, whether it is met is checked after each stripe, and
+  // the table resized for it once the stripe lock is released.
+  // --------------------------------------------------------------------------
+  template <typename Op>
+  std::vector<bool> ForEachByStripe(std::span<const T> elems,
+                                    std::optional<ResizeGoal> resize_goal,
+                                    Op&& op) {
+    const size_t n = elems.size();
+    std::vector<bool> results(n);
+    std::vector<size_t> hashes(n);
+    for (size_t i = 0; i < n; ++i) {
+      hashes[i] = HashPolicy::Hash(elems[i]);
+    }
+
+    const size_t stripes = StripeCount();
+    std::vector<size_t> stripe_of(n);
+    for (size_t i = 0; i < n; ++i) {
+      stripe_of[i] = HashPolicy::Index(hashes[i], stripes);
+    }
+    const std::vector<size_t> order = BatchOrder(stripe_of);
+
+    // Elements whose stripe split while the batch was running.
+    std::vector<size_t> leftovers;
+
+    size_t begin = 0;
+    while (begin < n) {
+      size_t end = begin + 1;
+      while (end < n && stripe_of[order[end]] == stripe_of[order[begin]]) {
+        ++end;
+      }
+
+      bool should_resize = false;
+      {
+        const StripeLock lock = LockStripe(hashes[order[begin]]);
+        const size_t current_stripes =
+            num_stripes_.load(std::memory_order_relaxed);
+        const size_t stripe =
+            HashPolicy::Index(hashes[order[begin]], current_stripes);
+        const Table& table = LockedTable();
+        // Elements that moved to another stripe are left alone, buckets
+        // included, since that stripe's lock is not held.
+        InterleaveLookups<const Bucket*>(
+            end - begin,
+            [&](size_t k) -> const Bucket* {
+              const size_t i = order[begin + k];
+              if (HashPolicy::Index(hashes[i], current_stripes) != stripe) {
+                return nullptr;
+              }
+              const Bucket* bucket = &table.buckets[HashPolicy::Index(
+                  hashes[i], table.buckets.size())];
+              PrefetchForRead(bucket);
+              return bucket;
+            },
+            [](const Bucket* bucket) {
+              if (bucket != nullptr) {
+                bucket->PrefetchElements();
+              }
+            },
+            [&](size_t k, const Bucket* bucket) {
+              const size_t i = order[begin + k];
+              if (bucket == nullptr) {
+                leftovers.push_back(i);
+                return;
+              }
+              results[i] = op(elems[i], hashes[i]);
+            });
+        should_resize = resize_goal.has_value() && NeedsResize(*resize_goal);
+      }
+      if (should_resize) {
+        Resize(*resize_goal);
+      }
+      begin = end;
+    }
+
+    for (const size_t i : leftovers) {
+      bool should_resize = false;
+      {
+        const StripeLock lock = LockStripe(hashes[i]);
+        results[i] = op(elems[i], hashes[i]);
+        should_resize = resize_goal.has_value() && NeedsResize(*resize_goal);
+      }
+      if (should_resize) {
+        Resize(*resize_goal);
+      }
+    }
+    return results;
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: round |value| up to a (non-zero) multiple of |multiple|.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] static size_t RoundUpToMultiple(size_t value,
+                                                size_t multiple) noexcept {
+    return std::max<size_t>(1, (value + multiple - 1) / multiple) * multiple;
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: LoadFactor() > kLoadFactorThreshold, using the counter's
+  // approximate fast path. Must be called with a stripe lock or
+  // resize_mutex_ held.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool ExceedsLoadFactor() const noexcept {
+    return size_.Exceeds(static_cast<size_t>(
+        kLoadFactorThreshold *
+        static_cast<double>(LockedTable().buckets.size())));
+  }
+
+  // --------------------------------------------------------------------------
+  // Helper: whether the table is below the shrink load factor and may shrink
+  // (see table_sizing.h), using the counter's fast path as above. Must be
+  // called with a stripe lock or resize_mutex_ held.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool BelowShrinkLoadFactor() const noexcept {
+    const size_t capacity = LockedTable().buckets.size();
+    if (!sizing_.CanShrink(capacity,
+                           num_stripes_.load(std::memory_order_relaxed))) {
+      return false;
+    }
+    const size_t bound = sizing_.ShrinkBound(capacity);
+    return bound > 0 && !size_.Exceeds(bound - 1);
+  }
+
+  // Whether a batch should resize the table for |goal|.
+  [[nodiscard]] bool NeedsResize(ResizeGoal goal) const noexcept {
+    return goal == ResizeGoal::kGrow ? ExceedsLoadFactor()
+                                     : BelowShrinkLoadFactor();
+  }
+
+  // --------------------------------------------------------------------------
+  // Locks the stripe guarding hash |h|. If Resize() changed the stripe count
+  // while we were waiting, the stripe may be the wrong one, so try again.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] StripeLock LockStripe(size_t h) const {
+    while (true) {
+      const size_t stripes = num_stripes_.load(std::memory_order_acquire);
+      Stripe& stripe = stripes_[HashPolicy::Index(h, stripes)];
+      StripeLock lock =
+          AcquireLock<StripeLock>(stripe.mutex, stats_, &stripe.contentions);
+      if (stripes == num_stripes_.load(std::memory_order_relaxed)) {
+        return lock;
+      }
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Replaces the empty table with one sized for |elems| and filled with them
+  // (see bulk_load.h). Only called while the set is being constructed.
+  // --------------------------------------------------------------------------
+  void BulkLoad(std::span<const T> elems, BulkKeys keys) {
+    const size_t old_capacity = LockedTable().buckets.size();
+    const size_t capacity =
+        sizing_.ReserveCapacity(elems.size(), old_capacity);
+    auto new_table = std::make_unique<Table>(capacity);
+    size_.Add(BulkFill<HashPolicy>(
+        elems, keys, new_table->buckets,
+        RehashWorkerCount(
+            elems.size(), capacity,
+            parallel_rehash_threshold_.load(std::memory_order_relaxed))));
+    delete table_.exchange(new_table.release(), std::memory_order_relaxed);
+    bucket_count_.store(capacity, std::memory_order_relaxed);
+
+    size_t stripes = num_stripes_.load(std::memory_order_relaxed);
+    for (size_t grown = old_capacity;
+         grown < capacity && stripe_growths_left_ > 0; grown *= kGrowthFactor) {
+      --stripe_growths_left_;
+      stripes *= 2;
+    }
+    num_stripes_.store(stripes, std::memory_order_relaxed);
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the capacity |goal| calls for, or |capacity| if it no longer
+  // applies because another thread resized first. Must be called with every
+  // stripe lock held.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t NewCapacity(ResizeGoal goal, size_t capacity,
+                                   size_t stripes) const {
+    const size_t size = size_.Size();
+    if (goal == ResizeGoal::kGrow) {
+      return static_cast<double>(size) >
+                     kLoadFactorThreshold * static_cast<double>(capacity)
+                 ? HashPolicy::Capacity(capacity * kGrowthFactor)
+                 : capacity;
+    }
+    if (goal == ResizeGoal::kShrink) {
+      return sizing_.ShouldShrink(size, capacity, stripes)
+                 ? sizing_.FitCapacity(size, capacity, stripes)
+                 : capacity;
+    }
+    if (goal == ResizeGoal::kCompact) {
+      return sizing_.FitCapacity(size, capacity, stripes);
+    }
+    return sizing_.ReserveCapacity(0, capacity);
+  }
+
+  // --------------------------------------------------------------------------
+  // Resizes the hash table for |goal|.
   // Acquires all bucket locks to ensure thread safety during rehashing.
   // --------------------------------------------------------------------------
-  void Resize() {
-    // Serialize resizes to avoid concurrent rehash by multiple threads
-    std::unique_lock<std::mutex> resize_lock(resize_mutex_);
+  void Resize(ResizeGoal goal) {
+    // Serialize resizes to avoid concurrent rehash by multiple threads. The
+    // holder is either resizing already or traversing, and then resizes
+    // itself afterwards if needed, so there is no point in waiting, unless
+    // the caller asked for a resize explicitly.
+    std::unique_lock<std::mutex> resize_lock(resize_mutex_, std::defer_lock);
+    if (goal == ResizeGoal::kGrow || goal == ResizeGoal::kShrink) {
+      if (!resize_lock.try_lock()) {
+        return;
+      }
+    } else {
+      resize_lock.lock();
+    }
 
-    // Acquire all locks in a fixed order to prevent deadlock
-    std::vector<std::unique_lock<std::mutex>> all_locks;
-    all_locks.reserve(locks_.size());
-    for (auto& m : locks_) {
-      all_locks.emplace_back(m);
+    // Acquire all active locks in a fixed order to prevent deadlock. The
+    // stripe count only changes in here, so it is stable under resize_lock.
+    const size_t stripes = num_stripes_.load(std::memory_order_relaxed);
+    std::vector<StripeLock> all_locks;
+    all_locks.reserve(stripes);
+    for (size_t i = 0; i < stripes; ++i) {
+      all_locks.emplace_back(stripes_[i].mutex);
     }
 
     // Check if another thread has already resized
-    if (LoadFactor() <= kLoadFactorThreshold) {
+    Table& old_table = LockedTable();
+    const size_t old_capacity = old_table.buckets.size();
+    const size_t new_capacity = NewCapacity(goal, old_capacity, stripes);
+    if (new_capacity == old_capacity && goal != ResizeGoal::kCompact) {
       return;
     }
+    stats_.RecordResize();
+    const auto rehash_timer = stats_.TimeRehash();
+    auto new_table = std::make_unique<Table>(new_capacity);
 
-    const size_t new_capacity = table_.size() * 2;
-    std::vector<std::vector<T>> new_table(new_capacity);
+    // Rehash all elements into the new table. Each worker reads its own range
+    // of old buckets, which all map to different new buckets (see
+    // parallel_rehash.h), unless the table shrinks and merges old buckets;
+    // then this thread rehashes alone. Optimistic readers may keep scanning
+    // the old table meanwhile, so it is only copied from; otherwise nobody
+    // else can reach it and the elements are moved.
+    const size_t workers =
+        new_capacity < old_capacity
+            ? 1
+            : RehashWorkerCount(
+                  size_.Size(), old_capacity,
+                  parallel_rehash_threshold_.load(std::memory_order_relaxed));
+    ForEachBucketRange(old_capacity, workers, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        if constexpr (kOptimisticReads) {
+          old_table.buckets[i].ForEach([&](const T& elem) {
+            const size_t h = HashPolicy::Hash(elem);
+            new_table->buckets[HashPolicy::Index(h, new_capacity)].Insert(elem,
+                                                                          h);
+          });
+        } else {
+          old_table.buckets[i].Drain(
+              PolicyHasher<HashPolicy>(), [&](T&& elem, size_t h) {
+                new_table->buckets[HashPolicy::Index(h, new_capacity)].Insert(
+                    std::move(elem), h);
+              });
+        }
+      }
+    });
 
-    // Rehash all elements into the new table
-    for (const auto& bucket : table_) {
-      for (const auto& elem : bucket) {
-        size_t new_index = std::hash<T>{}(elem) % new_capacity;
-        new_table[new_index].push_back(elem);
+    {
+      // Optimistic readers that overlap the switch must not validate.
+      std::vector<StripeWriteScope> write_scopes;
+      if constexpr (kOptimisticReads) {
+        write_scopes.reserve(stripes);
+        for (size_t i = 0; i < stripes; ++i) {
+          write_scopes.emplace_back(&stripes_[i].version);
+        }
       }
-    }
 
-    table_.swap(new_table);
+      table_.store(new_table.release(), std::memory_order_release);
+      bucket_count_.store(new_capacity, std::memory_order_relaxed);
 
-    // The lock set remains the same — locks_ are not resized.
+      // Doubling the stripe count keeps it a divisor of the (grown) bucket
+      // count. Threads blocked on an old stripe notice the new count once
+      // they get their lock and retry with the right one.
+      if (new_capacity > old_capacity && stripe_growths_left_ > 0) {
+        --stripe_growths_left_;
+        num_stripes_.store(stripes * 2, std::memory_order_release);
+      }
+    }
+
+    if constexpr (kOptimisticReads) {
+      EpochDomain::Global().Retire(&old_table);
+    } else {
+      delete &old_table;  // only read under a stripe lock or resize_mutex_
+    }
   }
 
  private:
-  std::vector<std::vector<T>> table_;      // buckets
-  mutable std::vector<std::mutex> locks_;  // one lock per bucket
-  mutable std::mutex resize_mutex_;        // serialize Resize()
-  std::atomic<size_t> size_;               // atomic element count
+  std::atomic<Table*> table_;              // owned, replaced by Resize()
+  std::atomic<size_t> bucket_count_;       // of table_, for LoadFactor()
+  mutable std::vector<StripeSlot> stripes_;  // first num_stripes_ used
+  std::atomic<size_t> num_stripes_;        // active stripe count
+  size_t stripe_growths_left_;             // guarded by resize_mutex_
+  mutable std::mutex resize_mutex_;        // serialize Resize(), ForEach()
+  ShardedCounter size_;                    // sharded element count
+  [[no_unique_address]] mutable SetStats stats_;
+  std::atomic<size_t> parallel_rehash_threshold_{
+      kDefaultParallelRehashThreshold};
+  TableSizing sizing_;  // shrinking and minimum capacity
   static constexpr double kLoadFactorThreshold = 4.0;
+  static constexpr size_t kGrowthFactor = 2;
+  static constexpr size_t kStripesPerThread = 4;
+  static constexpr bool kOptimisticReads = Bucket::kSupportsOptimisticReads;
+  static constexpr size_t kOptimisticAttempts = 4;
 };
 
 #endif  // HASH_SET_STRIPED_H
@@ -0,0 +1,333 @@
+#ifndef LOCK_POLICY_H
+#define LOCK_POLICY_H
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+
+#include "src/cache_line.h"
+
+// ============================================================================
+// Lock policies
+// ----------------------------------------------------------------------------
+// The LockPolicy template parameter of HashSetStriped and HashSetRefinable
+// picks the type and layout of their stripe and bucket locks (and that of
+// HashSetCoarseGrainedRW the type of its global lock), so that lock choice
+// can be benchmarked independently of the table algorithm:
+//  - Mutex: an exclusive lock (BasicLockable, with try_lock()), used for the
+//    stripes of HashSetStriped.
+//  - SharedMutex: a reader-writer lock (also with lock_shared(),
+//    try_lock_shared() and unlock_shared()), used for the buckets of
+//    HashSetRefinable.
+//  - kLayout: whether each lock, with the few words the set keeps next to it,
+//    gets a cache line of its own (see LockLayout). PaddedLockPolicy<P> pads
+//    the locks of policy P.
+// Locks that serialize resizes and traversals are always std::mutex: they are
+// taken rarely and held for long.
+//
+// The critical sections of a bucket operation last a few dozen nanoseconds,
+// much less than the futex sleep and wakeup std::mutex falls back to under
+// contention. SpinParkLockPolicy therefore spins for a while before it parks,
+// adapting the spin length to how long recent acquisitions of each lock had
+// to wait.
+// ============================================================================
+
+// Locks that can also be taken shared, such as the SharedMutex of a policy.
+template <typename M>
+concept SharedLockable = requires(M& mutex) {
+  mutex.lock_shared();
+  { mutex.try_lock_shared() } -> std::convertible_to<bool>;
+  mutex.unlock_shared();
+};
+
+// Hints to the CPU that the caller is busy-waiting.
+inline void CpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Adaptive spin length shared by the locks below. Each lock remembers a
+// running average of how many spins its contended acquisitions needed, and
+// spins up to twice that before parking, like glibc's adaptive mutexes.
+// ----------------------------------------------------------------------------
+class AdaptiveSpin {
+ public:
+  [[nodiscard]] uint32_t Limit() const noexcept {
+    return std::min(2 * average_.load(std::memory_order_relaxed) + kMinSpins,
+                    kMaxSpins);
+  }
+
+  // Folds the spins of an acquisition into the average. Updates may race;
+  // the average is only a hint.
+  void Record(uint32_t spins) noexcept {
+    const uint32_t average = average_.load(std::memory_order_relaxed);
+    average_.store(average - average / 8 + spins / 8,
+                   std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr uint32_t kMinSpins = 16;
+  static constexpr uint32_t kMaxSpins = 1024;
+
+  std::atomic<uint32_t> average_{0};
+};
+
+// ----------------------------------------------------------------------------
+// Exclusive lock that spins, then parks on its state word (through
+// std::atomic::wait, a futex on Linux). An uncontended lock() or unlock() is
+// a single atomic operation; unlock() only wakes anybody if a thread parked.
+// ----------------------------------------------------------------------------
+class SpinParkMutex {
+ public:
+  SpinParkMutex() = default;
+  SpinParkMutex(const SpinParkMutex&) = delete;
+  SpinParkMutex& operator=(const SpinParkMutex&) = delete;
+
+  void lock() noexcept {
+    if (!try_lock()) {
+      LockSlow();
+    }
+  }
+
+  [[nodiscard]] bool try_lock() noexcept {
+    uint32_t expected = kUnlocked;
+    return state_.compare_exchange_strong(expected, kLocked,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+  }
+
+  void unlock() noexcept {
+    if (state_.exchange(kUnlocked, std::memory_order_release) == kParked) {
+      state_.notify_one();
+    }
+  }
+
+ private:
+  static constexpr uint32_t kUnlocked = 0;
+  static constexpr uint32_t kLocked = 1;
+  static constexpr uint32_t kParked = 2;  // locked, and a thread may wait
+
+  void LockSlow() noexcept {
+    const uint32_t limit = spin_.Limit();
+    for (uint32_t spins = 0; spins < limit; ++spins) {
+      CpuRelax();
+      if (state_.load(std::memory_order_relaxed) == kUnlocked && try_lock()) {
+        spin_.Record(spins);
+        return;
+      }
+    }
+    spin_.Record(limit);
+
+    // Whoever takes the lock from here on marks it parked, so that its
+    // unlock() wakes the next waiter.
+    while (state_.exchange(kParked, std::memory_order_acquire) != kUnlocked) {
+      state_.wait(kParked, std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<uint32_t> state_{kUnlocked};
+  AdaptiveSpin spin_;
+};
+
+// ----------------------------------------------------------------------------
+// Reader-writer lock that spins, then parks, with a reader-biased fast path:
+// lock_shared() is a single fetch_add as long as no writer holds the lock.
+// Readers do not wait for writers that are only waiting, so a steady stream
+// of readers can starve writers; the sets only hold shared locks for one
+// bucket lookup, which keeps such streams short.
+// ----------------------------------------------------------------------------
+class SpinParkSharedMutex {
+ public:
+  SpinParkSharedMutex() = default;
+  SpinParkSharedMutex(const SpinParkSharedMutex&) = delete;
+  SpinParkSharedMutex& operator=(const SpinParkSharedMutex&) = delete;
+
+  void lock() noexcept {
+    uint32_t expected = 0;
+    if (!state_.compare_exchange_strong(expected, kWriter,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed)) {
+      LockSlow();
+    }
+  }
+
+  [[nodiscard]] bool try_lock() noexcept {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    while ((state & ~kParked) == 0) {
+      if (state_.compare_exchange_weak(state, state | kWriter,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Parked threads may wait for readers and for the writer alike, so they are
+  // all woken; the flag is set again by those that have to go on waiting.
+  void unlock() noexcept {
+    if ((state_.fetch_and(~(kWriter | kParked), std::memory_order_release) &
+         kParked) != 0) {
+      state_.notify_all();
+    }
+  }
+
+  void lock_shared() noexcept {
+    // Optimistically count ourselves in; a writer holding the lock ignores
+    // the count. Backing out is an unlock_shared(), as a writer that came
+    // after the writer left may be waiting for the count to drop.
+    if ((state_.fetch_add(kReader, std::memory_order_acquire) & kWriter) ==
+        0) {
+      return;
+    }
+    unlock_shared();
+    LockSharedSlow();
+  }
+
+  [[nodiscard]] bool try_lock_shared() noexcept {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    while ((state & kWriter) == 0) {
+      if (state_.compare_exchange_weak(state, state + kReader,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The last reader out wakes the parked threads, which a writer may be
+  // among, and clears the flag unless somebody got in first.
+  void unlock_shared() noexcept {
+    const uint32_t state =
+        state_.fetch_sub(kReader, std::memory_order_release) - kReader;
+    if (state == kParked) {
+      uint32_t expected = kParked;
+      if (state_.compare_exchange_strong(expected, 0,
+                                         std::memory_order_relaxed)) {
+        state_.notify_all();
+      }
+    }
+  }
+
+ private:
+  // State word: the writer bit, the parked bit and the reader count above.
+  static constexpr uint32_t kWriter = 1;
+  static constexpr uint32_t kParked = 2;
+  static constexpr uint32_t kReader = 4;
+
+  void LockSlow() noexcept {
+    const uint32_t limit = spin_.Limit();
+    for (uint32_t spins = 0; spins < limit; ++spins) {
+      CpuRelax();
+      if (try_lock()) {
+        spin_.Record(spins);
+        return;
+      }
+    }
+    spin_.Record(limit);
+    WaitFor([](uint32_t state) { return (state & ~kParked) == 0; }, kWriter);
+  }
+
+  void LockSharedSlow() noexcept {
+    const uint32_t limit = spin_.Limit();
+    for (uint32_t spins = 0; spins < limit; ++spins) {
+      CpuRelax();
+      if (try_lock_shared()) {
+        spin_.Record(spins);
+        return;
+      }
+    }
+    spin_.Record(limit);
+    WaitFor([](uint32_t state) { return (state & kWriter) == 0; }, kReader);
+  }
+
+  // Parks until |can_acquire| holds for the state, then adds |delta| to it.
+  template <typename CanAcquire>
+  void WaitFor(CanAcquire can_acquire, uint32_t delta) noexcept {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    while (true) {
+      if (can_acquire(state)) {
+        if (state_.compare_exchange_weak(state, state + delta,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+          return;
+        }
+        continue;
+      }
+      if ((state & kParked) == 0 &&
+          !state_.compare_exchange_weak(state, state | kParked,
+                                        std::memory_order_relaxed)) {
+        continue;
+      }
+      state_.wait(state | kParked, std::memory_order_relaxed);
+      state = state_.load(std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<uint32_t> state_{0};
+  AdaptiveSpin spin_;
+};
+
+// ----------------------------------------------------------------------------
+// How a set lays out its lock slots: a lock plus the small header the set
+// keeps next to it (a stripe's seqlock version, a bucket's migration flag).
+// ----------------------------------------------------------------------------
+enum class LockLayout {
+  // Slots are packed next to each other, so several share a cache line, and
+  // neighbouring slots taken by different cores invalidate each other's line
+  // on every acquisition.
+  kPacked,
+  // Every slot is aligned to a cache line of its own, at the cost of a line
+  // per lock.
+  kPadded,
+};
+
+// ----------------------------------------------------------------------------
+// |Slot| on a cache line of its own.
+// ----------------------------------------------------------------------------
+template <typename Slot>
+struct alignas(kCacheLineSize) CacheLinePadded : Slot {};
+
+// ----------------------------------------------------------------------------
+// The type of a lock slot |Slot| of a set with |LockPolicy|.
+// ----------------------------------------------------------------------------
+template <typename LockPolicy, typename Slot>
+using LockSlot = std::conditional_t<LockPolicy::kLayout == LockLayout::kPadded,
+                                    CacheLinePadded<Slot>, Slot>;
+
+// ----------------------------------------------------------------------------
+// The standard library's locks, packed (the default).
+// ----------------------------------------------------------------------------
+struct StdLockPolicy {
+  using Mutex = std::mutex;
+  using SharedMutex = std::shared_mutex;
+  static constexpr LockLayout kLayout = LockLayout::kPacked;
+};
+
+// ----------------------------------------------------------------------------
+// Spin-then-park locks, packed.
+// ----------------------------------------------------------------------------
+struct SpinParkLockPolicy {
+  using Mutex = SpinParkMutex;
+  using SharedMutex = SpinParkSharedMutex;
+  static constexpr LockLayout kLayout = LockLayout::kPacked;
+};
+
+// ----------------------------------------------------------------------------
+// The locks of |Base|, padded.
+// ----------------------------------------------------------------------------
+template <typename Base>
+struct PaddedLockPolicy : Base {
+  static constexpr LockLayout kLayout = LockLayout::kPadded;
+};
+
+#endif  // LOCK_POLICY_H
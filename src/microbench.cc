@@ -0,0 +1,418 @@
+#include "src/microbench.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <utility>
+
+#include "src/workload.h"
+
+namespace microbench {
+
+namespace {
+
+constexpr const char* kCaseNames[kNumCases] = {
+    "contains_hit", "contains_miss", "contains_many_hit", "add_hit",
+    "remove_miss",  "add_miss",      "remove_hit",        "add_resizing"};
+
+constexpr const char* kPerfEventNames[kNumPerfEvents] = {
+    "core_cycles", "instructions", "cache_misses", "branch_misses"};
+
+void PrintUsage(const char* program) {
+  std::cerr
+      << "Usage: " << program << " [--flag=value ...]\n"
+      << "  --impls=a,b,...          implementations to run (default: all)\n"
+      << "  --cases=a,b,...          cases to run (default: all of "
+      << kCaseNames[0];
+  for (size_t i = 1; i < kNumCases; i++) {
+    std::cerr << ',' << kCaseNames[i];
+  }
+  std::cerr
+      << ")\n"
+      << "  --size=65536             elements in the set\n"
+      << "  --ops=262144             operations per case\n"
+      << "  --batch_size=1024        operations per timed batch\n"
+      << "  --initial_capacity=16    initial capacity of each set\n"
+      << "  --counters=on            on | off (hardware counters)\n"
+      << "  --seed=1                 seed of the key shuffle\n"
+      << "  --format=csv             csv | json\n"
+      << "  --baseline=FILE          CSV of an earlier run to compare with\n"
+      << "  --max_regression_pct=10  median growth reported as a regression"
+      << std::endl;
+}
+
+bool ParseNames(const std::string& text, std::vector<std::string>& names) {
+  names.clear();
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (item.empty()) {
+      return false;
+    }
+    names.push_back(item);
+  }
+  return !names.empty();
+}
+
+bool ParseCases(const std::string& text, std::vector<Case>& cases) {
+  std::vector<std::string> names;
+  if (!ParseNames(text, names)) {
+    return false;
+  }
+  cases.clear();
+  for (const std::string& name : names) {
+    const auto* found =
+        std::find(std::begin(kCaseNames), std::end(kCaseNames), name);
+    if (found == std::end(kCaseNames)) {
+      return false;
+    }
+    cases.push_back(
+        static_cast<Case>(static_cast<size_t>(found - kCaseNames)));
+  }
+  return true;
+}
+
+bool ParseSize(const std::string& value, size_t& number) {
+  if (value.empty() ||
+      value.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  number = std::stoul(value);
+  return true;
+}
+
+bool ParseFlag(const std::string& name, const std::string& value,
+               Config& config) {
+  if (name == "impls") {
+    return ParseNames(value, config.implementations);
+  }
+  if (name == "cases") {
+    return ParseCases(value, config.cases);
+  }
+  if (name == "size") {
+    // ContainsMany() batches are taken from the elements of the set.
+    return ParseSize(value, config.size) &&
+           config.size >= 2 * kContainsManyBatch &&
+           config.size <= size_t{1} << 30;
+  }
+  if (name == "ops") {
+    return ParseSize(value, config.ops) && config.ops > 0 &&
+           config.ops <= size_t{1} << 30;
+  }
+  if (name == "batch_size") {
+    return ParseSize(value, config.batch_size) && config.batch_size > 0;
+  }
+  if (name == "initial_capacity") {
+    return ParseSize(value, config.initial_capacity) &&
+           config.initial_capacity > 0;
+  }
+  if (name == "counters") {
+    if (value == "on" || value == "off") {
+      config.counters = value == "on";
+      return true;
+    }
+    return false;
+  }
+  if (name == "seed") {
+    size_t seed = 0;
+    if (!ParseSize(value, seed)) {
+      return false;
+    }
+    config.seed = seed;
+    return true;
+  }
+  if (name == "format") {
+    if (value == "csv") {
+      config.format = Format::kCsv;
+      return true;
+    }
+    if (value == "json") {
+      config.format = Format::kJson;
+      return true;
+    }
+    return false;
+  }
+  if (name == "baseline") {
+    config.baseline = value;
+    return !value.empty();
+  }
+  if (name == "max_regression_pct") {
+    char* end = nullptr;
+    config.max_regression_percent = std::strtod(value.c_str(), &end);
+    return end != value.c_str() && *end == '\0' &&
+           config.max_regression_percent >= 0;
+  }
+  return false;
+}
+
+// Shuffles |keys| in place (Fisher-Yates).
+void Shuffle(std::vector<int>& keys, workload::Random& random) {
+  for (size_t i = keys.size(); i > 1; i--) {
+    std::swap(keys[i - 1], keys[random.Next() % i]);
+  }
+}
+
+// Per-operation count of |event| in |result|, if it was counted.
+std::optional<double> PerOp(const Result& result, PerfEvent event) {
+  const std::optional<uint64_t> count = result.counters.Count(event);
+  if (!count.has_value() || result.ops == 0) {
+    return std::nullopt;
+  }
+  return static_cast<double>(*count) / static_cast<double>(result.ops);
+}
+
+using BaselineKey = std::pair<std::string, std::string>;  // impl, case
+
+// Reads the median cycles per case of an earlier CSV run.
+bool ReadBaseline(const std::string& path,
+                  std::map<BaselineKey, double>& baseline) {
+  std::ifstream file(path);
+  std::string line;
+  if (!std::getline(file, line)) {
+    return false;
+  }
+  const auto split = [](const std::string& text) {
+    std::vector<std::string> fields;
+    std::stringstream stream(text);
+    std::string field;
+    while (std::getline(stream, field, ',')) {
+      fields.push_back(field);
+    }
+    return fields;
+  };
+  const std::vector<std::string> header = split(line);
+  const auto column = [&header](const std::string& name) {
+    return static_cast<size_t>(
+        std::find(header.begin(), header.end(), name) - header.begin());
+  };
+  const size_t implementation = column("implementation");
+  const size_t op_case = column("case");
+  const size_t cycles = column("cycles_p50");
+  const size_t last = std::max({implementation, op_case, cycles});
+  if (last >= header.size()) {
+    return false;
+  }
+  while (std::getline(file, line)) {
+    // Trailing empty fields, such as unavailable counters, are not split.
+    const std::vector<std::string> fields = split(line);
+    if (fields.size() > last) {
+      baseline[{fields[implementation], fields[op_case]}] =
+          std::strtod(fields[cycles].c_str(), nullptr);
+    }
+  }
+  return true;
+}
+
+// Change of the median against the baseline, in percent, if the baseline
+// has the case.
+std::optional<double> ChangePercent(
+    const std::map<BaselineKey, double>& baseline, const Result& result,
+    double* baseline_cycles) {
+  const auto found =
+      baseline.find({result.implementation, CaseName(result.op_case)});
+  if (found == baseline.end() || found->second <= 0) {
+    return std::nullopt;
+  }
+  *baseline_cycles = found->second;
+  return (result.cycles_p50 / found->second - 1) * 100;
+}
+
+void PrintCsv(const std::vector<Result>& results,
+              const std::map<BaselineKey, double>* baseline) {
+  std::cout << "implementation,case,ops,batch_size,cycles_min,cycles_p50,"
+               "cycles_p99,cycles_max,ns_p50";
+  for (const char* name : kPerfEventNames) {
+    std::cout << ',' << name;
+  }
+  if (baseline != nullptr) {
+    std::cout << ",baseline_cycles_p50,change_pct";
+  }
+  std::cout << '\n';
+
+  for (const Result& result : results) {
+    std::cout << result.implementation << ',' << CaseName(result.op_case)
+              << ',' << result.ops << ',' << result.batch_size << ','
+              << result.cycles_min << ',' << result.cycles_p50 << ','
+              << result.cycles_p99 << ',' << result.cycles_max << ','
+              << result.ns_p50;
+    for (size_t event = 0; event < kNumPerfEvents; event++) {
+      std::cout << ',';
+      if (const auto per_op = PerOp(result, static_cast<PerfEvent>(event))) {
+        std::cout << *per_op;
+      }
+    }
+    if (baseline != nullptr) {
+      double baseline_cycles = 0;
+      const std::optional<double> change =
+          ChangePercent(*baseline, result, &baseline_cycles);
+      std::cout << ',';
+      if (change.has_value()) {
+        std::cout << baseline_cycles << ',' << *change;
+      } else {
+        std::cout << ',';
+      }
+    }
+    std::cout << '\n';
+  }
+  std::cout << std::flush;
+}
+
+void PrintJson(const Config& config, const std::vector<Result>& results,
+               const std::map<BaselineKey, double>* baseline) {
+  std::cout << "{\n"
+            << "  \"config\": {\"size\": " << config.size
+            << ", \"ops\": " << config.ops
+            << ", \"batch_size\": " << config.batch_size
+            << ", \"initial_capacity\": " << config.initial_capacity
+            << ", \"seed\": " << config.seed << "},\n"
+            << "  \"results\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& result = results[i];
+    std::cout << (i == 0 ? "\n" : ",\n") << "    {\"implementation\": \""
+              << result.implementation << "\", \"case\": \""
+              << CaseName(result.op_case) << "\", \"ops\": " << result.ops
+              << ", \"batch_size\": " << result.batch_size
+              << ", \"cycles_min\": " << result.cycles_min
+              << ", \"cycles_p50\": " << result.cycles_p50
+              << ", \"cycles_p99\": " << result.cycles_p99
+              << ", \"cycles_max\": " << result.cycles_max
+              << ", \"ns_p50\": " << result.ns_p50;
+    for (size_t event = 0; event < kNumPerfEvents; event++) {
+      std::cout << ", \"" << kPerfEventNames[event] << "\": ";
+      if (const auto per_op = PerOp(result, static_cast<PerfEvent>(event))) {
+        std::cout << *per_op;
+      } else {
+        std::cout << "null";
+      }
+    }
+    if (baseline != nullptr) {
+      double baseline_cycles = 0;
+      const std::optional<double> change =
+          ChangePercent(*baseline, result, &baseline_cycles);
+      if (change.has_value()) {
+        std::cout << ", \"baseline_cycles_p50\": " << baseline_cycles
+                  << ", \"change_pct\": " << *change;
+      }
+    }
+    std::cout << "}";
+  }
+  std::cout << "\n  ]\n}" << std::endl;
+}
+
+}  // namespace
+
+const char* CaseName(Case op_case) {
+  return kCaseNames[static_cast<size_t>(op_case)];
+}
+
+bool ParseArgs(int argc, char** argv, Config& config) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || equals == std::string::npos ||
+        !ParseFlag(arg.substr(2, equals - 2), arg.substr(equals + 1),
+                   config)) {
+      std::cerr << argv[0] << ": invalid argument '" << arg << "'"
+                << std::endl;
+      PrintUsage(argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+Keys MakeKeys(const Config& config) {
+  // Even keys are present and odd ones absent, so that both are spread over
+  // the same range.
+  Keys keys;
+  keys.present.reserve(config.size);
+  for (size_t i = 0; i < config.size; i++) {
+    keys.present.push_back(static_cast<int>(2 * i));
+  }
+  keys.absent.reserve(config.ops);
+  for (size_t i = 0; i < config.ops; i++) {
+    keys.absent.push_back(static_cast<int>(2 * i + 1));
+  }
+  workload::Random random(config.seed);
+  Shuffle(keys.present, random);
+  Shuffle(keys.absent, random);
+  return keys;
+}
+
+int RunSuite(const Config& config,
+             const std::vector<Implementation>& implementations) {
+  for (const std::string& name : config.implementations) {
+    if (std::none_of(implementations.begin(), implementations.end(),
+                     [&name](const Implementation& implementation) {
+                       return implementation.name == name;
+                     })) {
+      std::cerr << "Unknown implementation '" << name << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  std::map<BaselineKey, double> baseline;
+  if (!config.baseline.empty() && !ReadBaseline(config.baseline, baseline)) {
+    std::cerr << "Cannot read the baseline '" << config.baseline << "'"
+              << std::endl;
+    return 1;
+  }
+  if (config.counters && !PerfCounters().Available()) {
+    std::cerr << "Hardware counters are not available; their columns stay "
+                 "empty"
+              << std::endl;
+  }
+
+  std::vector<Result> results;
+  for (const Implementation& implementation : implementations) {
+    if (!config.implementations.empty() &&
+        std::find(config.implementations.begin(), config.implementations.end(),
+                  implementation.name) == config.implementations.end()) {
+      continue;
+    }
+    std::cerr << "Running " << implementation.name << std::endl;
+    for (const Result& result :
+         implementation.run(implementation.name, config)) {
+      results.push_back(result);
+    }
+  }
+
+  const std::map<BaselineKey, double>* compared =
+      config.baseline.empty() ? nullptr : &baseline;
+  std::cout << std::fixed << std::setprecision(2);
+  if (config.format == Format::kJson) {
+    PrintJson(config, results, compared);
+  } else {
+    PrintCsv(results, compared);
+  }
+
+  int exit_code = 0;
+  std::cerr << std::fixed << std::setprecision(2);
+  for (const Result& result : results) {
+    if (result.wrong_results != 0) {
+      std::cerr << result.implementation << " " << CaseName(result.op_case)
+                << ": " << result.wrong_results << " wrong results"
+                << std::endl;
+      exit_code = 1;
+    }
+    double baseline_cycles = 0;
+    const std::optional<double> change =
+        compared != nullptr
+            ? ChangePercent(baseline, result, &baseline_cycles)
+            : std::nullopt;
+    if (change.has_value() && *change > config.max_regression_percent) {
+      std::cerr << "Regression: " << result.implementation << " "
+                << CaseName(result.op_case) << " " << baseline_cycles
+                << " -> " << result.cycles_p50 << " cycles (+" << *change
+                << "%)" << std::endl;
+      exit_code = 1;
+    }
+  }
+  return exit_code;
+}
+
+}  // namespace microbench
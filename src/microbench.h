@@ -0,0 +1,258 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "src/hash_set_base.h"
+#include "src/perf_counters.h"
+#include "src/table_sizing.h"
+
+// ============================================================================
+// Single-operation microbenchmarks
+// ----------------------------------------------------------------------------
+// Where the workload (see workload.h) measures throughput under a mix of
+// operations, these time one kind of operation at a time, on one thread, so
+// that its own cost shows: an uncontended Add() of a new element, a
+// Contains() that hits or misses, and so on.
+//  - Each case runs |ops| operations in batches of |batch_size|, and every
+//    batch is timed with the time stamp counter and the steady clock (see
+//    perf_counters.h). The per-operation cost of the batches is reported as
+//    its minimum, median, 99th percentile and maximum.
+//  - The hardware counters, where available, count the whole case, and are
+//    reported per operation.
+//  - The set holds |size| elements throughout, apart from add_resizing. That
+//    case builds a set from its smallest capacity, timing every Add() on its
+//    own, so that its maximum is the longest resize pause.
+//  - Every operation's result is checked, which also keeps the calls from
+//    being optimized away.
+// Results are printed as CSV or JSON. With |baseline|, the CSV of an earlier
+// run, every case is compared to the same case there, and cases whose median
+// grew by more than |max_regression_percent| are reported as regressions.
+// ============================================================================
+namespace microbench {
+
+enum class Case {
+  kContainsHit,
+  kContainsMiss,
+  kContainsManyHit,  // ContainsMany() of kContainsManyBatch elements
+  kAddHit,           // Add() of an element that is already present
+  kRemoveMiss,
+  kAddMiss,    // Add() of a new element, into a table that need not grow
+  kRemoveHit,  // Remove() of the elements kAddMiss added
+  kAddResizing,
+};
+inline constexpr size_t kNumCases = 8;
+inline constexpr size_t kContainsManyBatch = 64;
+
+enum class Format { kCsv, kJson };
+
+struct Config {
+  std::vector<std::string> implementations;  // empty means all
+  std::vector<Case> cases;                   // empty means all
+  size_t size = size_t{1} << 16;
+  size_t ops = size_t{1} << 18;  // per case
+  size_t batch_size = 1024;
+  size_t initial_capacity = 16;
+  bool counters = true;
+  uint64_t seed = 1;
+  Format format = Format::kCsv;
+  std::string baseline;  // CSV of an earlier run, or empty
+  double max_regression_percent = 10;
+};
+
+// Parses --name=value flags into |config|. Prints a message and returns false
+// on malformed input.
+bool ParseArgs(int argc, char** argv, Config& config);
+
+const char* CaseName(Case op_case);
+
+// Timings of one case, per operation.
+struct Result {
+  std::string implementation;
+  Case op_case = Case::kContainsHit;
+  size_t ops = 0;
+  size_t batch_size = 0;
+  double cycles_min = 0;
+  double cycles_p50 = 0;
+  double cycles_p99 = 0;
+  double cycles_max = 0;
+  double ns_p50 = 0;
+  PerfSample counters;  // totals over the case
+  size_t wrong_results = 0;
+};
+
+// ----------------------------------------------------------------------------
+// Times |calls| calls of |op(i)| in batches of |batch_size| calls. Each call
+// runs |per_call| operations and returns how many of them gave the result
+// the case expects. |counters| may be null.
+// ----------------------------------------------------------------------------
+template <typename Op>
+Result TimeCase(Case op_case, size_t calls, size_t per_call,
+                size_t batch_size, PerfCounters* counters, Op&& op) {
+  std::vector<double> cycles;
+  std::vector<double> nanos;
+  cycles.reserve(calls / batch_size + 1);
+  nanos.reserve(calls / batch_size + 1);
+  size_t expected = 0;
+
+  if (counters != nullptr) {
+    counters->Start();
+  }
+  for (size_t begin = 0; begin < calls; begin += batch_size) {
+    const size_t end = std::min(calls, begin + batch_size);
+    const auto begin_time = std::chrono::steady_clock::now();
+    const uint64_t begin_cycles = ReadCycleCounter();
+    for (size_t i = begin; i < end; ++i) {
+      expected += op(i);
+    }
+    const uint64_t end_cycles = ReadCycleCounter();
+    const auto end_time = std::chrono::steady_clock::now();
+    const auto batch_ops = static_cast<double>((end - begin) * per_call);
+    cycles.push_back(static_cast<double>(end_cycles - begin_cycles) /
+                     batch_ops);
+    nanos.push_back(
+        std::chrono::duration<double, std::nano>(end_time - begin_time)
+            .count() /
+        batch_ops);
+  }
+  const PerfSample sample =
+      counters != nullptr ? counters->Stop() : PerfSample{};
+
+  std::sort(cycles.begin(), cycles.end());
+  std::sort(nanos.begin(), nanos.end());
+  const auto at = [](const std::vector<double>& sorted, double quantile) {
+    return sorted.empty() ? 0.0
+                          : sorted[static_cast<size_t>(
+                                quantile *
+                                static_cast<double>(sorted.size() - 1))];
+  };
+  Result result;
+  result.op_case = op_case;
+  result.ops = calls * per_call;
+  result.batch_size = batch_size * per_call;
+  result.cycles_min = at(cycles, 0);
+  result.cycles_p50 = at(cycles, 0.5);
+  result.cycles_p99 = at(cycles, 0.99);
+  result.cycles_max = at(cycles, 1);
+  result.ns_p50 = at(nanos, 0.5);
+  result.counters = sample;
+  result.wrong_results = calls * per_call - expected;
+  return result;
+}
+
+// The keys of a run: |present| are added to the set before the cases run,
+// |absent| never are, apart from kAddMiss. Both are shuffled.
+struct Keys {
+  std::vector<int> present;
+  std::vector<int> absent;
+};
+
+Keys MakeKeys(const Config& config);
+
+[[nodiscard]] inline bool Selected(const Config& config, Case op_case) {
+  return config.cases.empty() ||
+         std::find(config.cases.begin(), config.cases.end(), op_case) !=
+             config.cases.end();
+}
+
+// ----------------------------------------------------------------------------
+// Runs the selected cases of |config| against fresh HashSetType sets.
+// ----------------------------------------------------------------------------
+template <HashSet<int> HashSetType>
+std::vector<Result> RunMicrobench(const std::string& name,
+                                  const Config& config) {
+  const Keys keys = MakeKeys(config);
+  const std::vector<int>& present = keys.present;
+  const std::vector<int>& absent = keys.absent;
+  std::optional<PerfCounters> counters;
+  if (config.counters) {
+    counters.emplace();
+  }
+
+  std::vector<Result> results;
+  const size_t ops = config.ops;
+  const size_t batch = config.batch_size;
+  const auto run = [&](Case op_case, size_t calls, size_t per_call,
+                       size_t batch_size, auto&& op) {
+    if (!Selected(config, op_case)) {
+      return;
+    }
+    Result result = TimeCase(op_case, calls, per_call, batch_size,
+                             counters ? &*counters : nullptr, op);
+    result.implementation = name;
+    results.push_back(result);
+  };
+
+  {
+    HashSetType hash_set(config.initial_capacity);
+    for (const int key : present) {
+      hash_set.Add(key);
+    }
+    const auto hit = [&](size_t i) { return present[i % present.size()]; };
+    const auto miss = [&](size_t i) { return absent[i % absent.size()]; };
+
+    run(Case::kContainsHit, ops, 1, batch,
+        [&](size_t i) { return hash_set.Contains(hit(i)) ? 1u : 0u; });
+    run(Case::kContainsMiss, ops, 1, batch,
+        [&](size_t i) { return hash_set.Contains(miss(i)) ? 0u : 1u; });
+    run(Case::kContainsManyHit, ops / kContainsManyBatch, kContainsManyBatch,
+        std::max<size_t>(batch / kContainsManyBatch, 1), [&](size_t i) {
+          const size_t begin =
+              i * kContainsManyBatch % (present.size() - kContainsManyBatch);
+          const std::vector<bool> found = hash_set.ContainsMany(
+              std::span<const int>(present).subspan(begin,
+                                                    kContainsManyBatch));
+          return static_cast<size_t>(
+              std::count(found.begin(), found.end(), true));
+        });
+    run(Case::kAddHit, ops, 1, batch,
+        [&](size_t i) { return hash_set.Add(hit(i)) ? 0u : 1u; });
+    run(Case::kRemoveMiss, ops, 1, batch,
+        [&](size_t i) { return hash_set.Remove(miss(i)) ? 0u : 1u; });
+
+    // Room for every new element, so that kAddMiss does not resize, and
+    // a minimum capacity that keeps kRemoveHit from shrinking the table.
+    if constexpr (SizesTable<HashSetType>) {
+      hash_set.Reserve(present.size() + absent.size());
+    }
+    run(Case::kAddMiss, absent.size(), 1, batch,
+        [&](size_t i) { return hash_set.Add(absent[i]) ? 1u : 0u; });
+    if (!Selected(config, Case::kAddMiss)) {
+      for (const int key : absent) {
+        hash_set.Add(key);
+      }
+    }
+    run(Case::kRemoveHit, absent.size(), 1, batch,
+        [&](size_t i) { return hash_set.Remove(absent[i]) ? 1u : 0u; });
+  }
+
+  {
+    HashSetType hash_set(1);
+    run(Case::kAddResizing, present.size(), 1, 1,
+        [&](size_t i) { return hash_set.Add(present[i]) ? 1u : 0u; });
+  }
+  return results;
+}
+
+// An implementation the suite can run.
+struct Implementation {
+  std::string name;
+  std::vector<Result> (*run)(const std::string& name, const Config& config);
+};
+
+// Runs |config| against |implementations| and prints the results. Returns
+// the exit code of the program: 1 for bad arguments, wrong results or
+// regressions against the baseline.
+int RunSuite(const Config& config,
+             const std::vector<Implementation>& implementations);
+
+}  // namespace microbench
+
+#endif  // MICROBENCH_H
@@ -0,0 +1,65 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/bucket_storage.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_cuckoo.h"
+#include "src/hash_set_lock_free.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_sharded.h"
+#include "src/hash_set_striped.h"
+#include "src/lock_policy.h"
+#include "src/microbench.h"
+
+namespace {
+
+// Incremental resizes, whose pauses add_resizing compares with those of
+// stopping the world.
+class HashSetRefinableIncremental final : public HashSetRefinable<int> {
+ public:
+  explicit HashSetRefinableIncremental(size_t initial_capacity)
+      : HashSetRefinable<int>(initial_capacity, ResizeMode::kIncremental) {}
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  microbench::Config config;
+  if (!microbench::ParseArgs(argc, argv, config)) {
+    return 1;
+  }
+
+  // The implementations of the workload (see workload_main.cc) whose
+  // single-thread costs differ, under the same names.
+  const std::vector<microbench::Implementation> implementations = {
+      {"sequential", &microbench::RunMicrobench<HashSetSequential<int>>},
+      {"sequential_mask",
+       &microbench::RunMicrobench<
+           HashSetSequential<int, VectorBucketStorage, MaskHashPolicy<>>>},
+      {"coarse_grained",
+       &microbench::RunMicrobench<HashSetCoarseGrained<int>>},
+      {"coarse_grained_rw",
+       &microbench::RunMicrobench<HashSetCoarseGrainedRW<int>>},
+      {"striped", &microbench::RunMicrobench<HashSetStriped<int>>},
+      {"striped_mask",
+       &microbench::RunMicrobench<
+           HashSetStriped<int, VectorBucketStorage, MaskHashPolicy<>>>},
+      {"striped_optimistic",
+       &microbench::RunMicrobench<HashSetStriped<int, InlineBucketStorage<8>>>},
+      {"striped_spin",
+       &microbench::RunMicrobench<
+           HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                          std::allocator<int>, SpinParkLockPolicy>>},
+      {"refinable", &microbench::RunMicrobench<HashSetRefinable<int>>},
+      {"refinable_incremental",
+       &microbench::RunMicrobench<HashSetRefinableIncremental>},
+      {"lock_free", &microbench::RunMicrobench<HashSetLockFree<int>>},
+      {"cuckoo", &microbench::RunMicrobench<HashSetCuckoo<int>>},
+      {"sharded_striped",
+       &microbench::RunMicrobench<HashSetSharded<int, HashSetStriped<int>>>},
+  };
+  return microbench::RunSuite(config, implementations);
+}
@@ -0,0 +1,231 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// NUMA placement
+// ----------------------------------------------------------------------------
+// Just enough NUMA support to place sets and threads on nodes, without
+// depending on libnuma: the topology is read from sysfs, and memory is bound
+// with the mbind and set_mempolicy system calls. On other systems, and on
+// Linux machines without NUMA, there is a single node 0 and every function
+// here falls back to doing nothing (or to the global heap).
+//
+// Only nodes below kMaxNumaNodes are supported.
+// ============================================================================
+
+inline constexpr size_t kMaxNumaNodes = 64;
+
+// Stands for "no particular node".
+inline constexpr size_t kAnyNumaNode = ~size_t{0};
+
+namespace numa_internal {
+
+// Parses a sysfs list such as "0-3,8,10-11" into the numbers it names, or
+// returns an empty list if it is malformed.
+inline std::vector<size_t> ParseRangeList(const std::string& text) {
+  std::vector<size_t> values;
+  const char* cursor = text.c_str();
+  while (*cursor != '\0') {
+    char* end = nullptr;
+    const size_t first = std::strtoul(cursor, &end, 10);
+    size_t last = first;
+    if (end == cursor) {
+      return {};
+    }
+    if (*end == '-') {
+      cursor = end + 1;
+      last = std::strtoul(cursor, &end, 10);
+      if (end == cursor || last < first) {
+        return {};
+      }
+    }
+    for (size_t value = first; value <= last; ++value) {
+      values.push_back(value);
+    }
+    if (*end == ',') {
+      ++end;
+    } else if (*end != '\0' && *end != '\n') {
+      return {};
+    }
+    cursor = *end == '\n' ? end + 1 : end;
+  }
+  return values;
+}
+
+inline std::vector<size_t> ReadRangeList(const std::string& path) {
+  std::ifstream file(path);
+  std::string text;
+  if (!std::getline(file, text)) {
+    return {};
+  }
+  return ParseRangeList(text);
+}
+
+// Memory policy modes of mbind(2) and set_mempolicy(2).
+inline constexpr int kMpolDefault = 0;
+inline constexpr int kMpolPreferred = 1;
+inline constexpr int kMpolBind = 2;
+
+// Node mask of |node|, for the memory policy system calls. The kernel reads
+// one bit fewer than the |maxnode| it is passed, hence the + 1.
+struct NodeMask {
+  explicit NodeMask(size_t node) : bits(1UL << node) {
+    assert(node < kMaxNumaNodes);
+  }
+  unsigned long bits;
+  static constexpr unsigned long kMaxNode = kMaxNumaNodes + 1;
+};
+
+}  // namespace numa_internal
+
+// ----------------------------------------------------------------------------
+// Returns the number of NUMA nodes, at least 1. Nodes are numbered from 0.
+// ----------------------------------------------------------------------------
+[[nodiscard]] inline size_t NumaNodeCount() {
+  static const size_t count = [] {
+    const std::vector<size_t> nodes =
+        numa_internal::ReadRangeList("/sys/devices/system/node/online");
+    size_t highest = 0;
+    for (const size_t node : nodes) {
+      highest = node > highest ? node : highest;
+    }
+    return nodes.empty() || highest >= kMaxNumaNodes ? size_t{1}
+                                                     : highest + 1;
+  }();
+  return count;
+}
+
+// ----------------------------------------------------------------------------
+// Restricts the calling thread to the CPUs of |node|. Returns false, leaving
+// the thread where it was, if that is not possible.
+// ----------------------------------------------------------------------------
+inline bool PinThreadToNumaNode(size_t node) {
+#if defined(__linux__)
+  const std::vector<size_t> cpus = numa_internal::ReadRangeList(
+      "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+  if (cpus.empty()) {
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const size_t cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  (void)node;
+  return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Allocates |bytes| of page-aligned memory whose pages are bound to |node|,
+// or come from the global heap for kAnyNumaNode. Release it with
+// FreeOnNumaNode(), passing the same size and node.
+// ----------------------------------------------------------------------------
+[[nodiscard]] inline void* AllocateOnNumaNode(size_t bytes, size_t node) {
+#if defined(__linux__)
+  if (node != kAnyNumaNode) {
+    void* block = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    // Without a binding the pages still land on the node that touches them
+    // first, so a failure here is not fatal.
+    const numa_internal::NodeMask mask(node);
+    (void)syscall(SYS_mbind, block, bytes, numa_internal::kMpolBind,
+                  &mask.bits, numa_internal::NodeMask::kMaxNode, 0);
+    return block;
+  }
+#endif
+  (void)node;
+  return ::operator new(bytes);
+}
+
+inline void FreeOnNumaNode(void* block, size_t bytes, size_t node) noexcept {
+#if defined(__linux__)
+  if (node != kAnyNumaNode) {
+    munmap(block, bytes);
+    return;
+  }
+#endif
+  (void)bytes;
+  (void)node;
+  ::operator delete(block);
+}
+
+// ----------------------------------------------------------------------------
+// Makes the calling thread prefer |node| for the memory it allocates through
+// the global heap, for the lifetime of the scope. The thread must not be
+// under another memory policy; it gets the default one back.
+// ----------------------------------------------------------------------------
+class ScopedNumaMemoryPolicy {
+ public:
+  explicit ScopedNumaMemoryPolicy(size_t node) {
+#if defined(__linux__)
+    const numa_internal::NodeMask mask(node);
+    active_ = syscall(SYS_set_mempolicy, numa_internal::kMpolPreferred,
+                      &mask.bits, numa_internal::NodeMask::kMaxNode) == 0;
+#else
+    (void)node;
+#endif
+  }
+
+  ~ScopedNumaMemoryPolicy() {
+#if defined(__linux__)
+    if (active_) {
+      (void)syscall(SYS_set_mempolicy, numa_internal::kMpolDefault, nullptr,
+                    0);
+    }
+#endif
+  }
+
+  ScopedNumaMemoryPolicy(const ScopedNumaMemoryPolicy&) = delete;
+  ScopedNumaMemoryPolicy& operator=(const ScopedNumaMemoryPolicy&) = delete;
+
+ private:
+  [[maybe_unused]] bool active_ = false;
+};
+
+// ----------------------------------------------------------------------------
+// The node whose memory the arenas created by the calling thread use (see
+// arena.h), kAnyNumaNode outside of any scope. Scopes nest.
+// ----------------------------------------------------------------------------
+class ScopedNumaNode {
+ public:
+  explicit ScopedNumaNode(size_t node) noexcept : previous_(current_) {
+    current_ = node;
+  }
+
+  ~ScopedNumaNode() { current_ = previous_; }
+
+  ScopedNumaNode(const ScopedNumaNode&) = delete;
+  ScopedNumaNode& operator=(const ScopedNumaNode&) = delete;
+
+  [[nodiscard]] static size_t Current() noexcept { return current_; }
+
+ private:
+  static inline thread_local size_t current_ = kAnyNumaNode;
+
+  size_t previous_;
+};
+
+#endif  // NUMA_H
@@ -0,0 +1,90 @@
+#ifndef PARALLEL_REHASH_H
+#define PARALLEL_REHASH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// ============================================================================
+// Parallel rehash
+// ----------------------------------------------------------------------------
+// Every set grows its table to a multiple of the old bucket count, so each
+// new bucket receives elements from exactly one old bucket, whatever the
+// hash policy (see hash_policy.h). Splitting the old buckets into disjoint
+// ranges therefore splits the writes to the new table as well: workers that
+// rehash different ranges never touch the same new bucket and need no
+// synchronisation besides the final join. Shrinking the table (see
+// table_sizing.h) merges old buckets instead, so shrinks are rehashed on the
+// resizing thread alone.
+//
+// A set rehashes in parallel once it holds at least its parallel rehash
+// threshold of elements (kDefaultParallelRehashThreshold unless changed with
+// SetParallelRehashThreshold()). Smaller tables are rehashed on the resizing
+// thread, where starting workers would cost more than it saves.
+// ============================================================================
+
+inline constexpr size_t kDefaultParallelRehashThreshold = size_t{1} << 20;
+
+// Workers are only started for at least this many old buckets each.
+inline constexpr size_t kMinBucketsPerRehashWorker = size_t{1} << 12;
+
+// ----------------------------------------------------------------------------
+// Returns how many threads should rehash a table of |num_buckets| buckets
+// that holds |num_elements| elements: one below |threshold|, otherwise up to
+// one per hardware thread.
+// ----------------------------------------------------------------------------
+[[nodiscard]] inline size_t RehashWorkerCount(size_t num_elements,
+                                              size_t num_buckets,
+                                              size_t threshold) noexcept {
+  if (num_elements < threshold) {
+    return 1;
+  }
+  const size_t hardware_threads =
+      std::max(1u, std::thread::hardware_concurrency());
+  return std::clamp<size_t>(num_buckets / kMinBucketsPerRehashWorker, 1,
+                            hardware_threads);
+}
+
+// ----------------------------------------------------------------------------
+// Calls |work(worker)| for every worker in [0, num_workers). The calling
+// thread is worker 0 and the others run on freshly started threads; returns
+// once all of them are done.
+// ----------------------------------------------------------------------------
+template <typename Work>
+void ForEachWorker(size_t num_workers, Work&& work) {
+  if (num_workers == 0) {
+    return;
+  }
+  std::vector<std::thread> workers;
+  workers.reserve(num_workers - 1);
+  for (size_t worker = 1; worker < num_workers; ++worker) {
+    workers.emplace_back([&work, worker]() { work(worker); });
+  }
+  work(size_t{0});
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Calls |visit(begin, end)| for |num_workers| disjoint ranges that together
+// cover [0, num_buckets), one per worker of ForEachWorker().
+// ----------------------------------------------------------------------------
+template <typename Visit>
+void ForEachBucketRange(size_t num_buckets, size_t num_workers, Visit&& visit) {
+  if (num_buckets == 0) {
+    return;
+  }
+  num_workers = std::clamp<size_t>(num_workers, 1, num_buckets);
+  const size_t per_worker = num_buckets / num_workers;
+  const size_t remainder = num_buckets % num_workers;
+  const auto range_begin = [&](size_t worker) {
+    return worker * per_worker + std::min(worker, remainder);
+  };
+  ForEachWorker(num_workers, [&](size_t worker) {
+    visit(range_begin(worker), range_begin(worker + 1));
+  });
+}
+
+#endif  // PARALLEL_REHASH_H
@@ -0,0 +1,170 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// ============================================================================
+// Cycle and hardware event counters
+// ----------------------------------------------------------------------------
+// ReadCycleCounter() reads the time stamp counter, fenced so that the
+// instructions before it have completed and none after it has started. The
+// counter ticks at a constant rate, not with the core clock, which makes it
+// comparable between runs but not a count of core cycles; those come from
+// the counters below. Without a time stamp counter it falls back to
+// std::chrono::steady_clock nanoseconds.
+//
+// PerfCounters counts hardware events of the calling thread, in user space
+// only, with perf_event_open(2), as one group so that all events cover the
+// same instructions. Events the machine or the kernel does not offer (no
+// PMU in a VM, perf_event_paranoid too strict, ...) are left out, and on
+// other systems none are available. When the kernel multiplexes the
+// counters, counts are scaled up to the time the group was enabled.
+// ============================================================================
+
+enum class PerfEvent : size_t {
+  kCycles,
+  kInstructions,
+  kCacheMisses,
+  kBranchMisses,
+};
+inline constexpr size_t kNumPerfEvents = 4;
+
+[[nodiscard]] inline uint64_t ReadCycleCounter() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_lfence();
+  const uint64_t ticks = __rdtsc();
+  _mm_lfence();
+  return ticks;
+#else
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#endif
+}
+
+// Counts of one PerfCounters interval; events that are not available have
+// no count.
+struct PerfSample {
+  std::array<std::optional<uint64_t>, kNumPerfEvents> counts;
+
+  [[nodiscard]] std::optional<uint64_t> Count(PerfEvent event) const {
+    return counts[static_cast<size_t>(event)];
+  }
+};
+
+class PerfCounters {
+ public:
+  // --------------------------------------------------------------------------
+  // Opens every event it can for the calling thread. The counters only count
+  // that thread, between Start() and Stop().
+  // --------------------------------------------------------------------------
+  PerfCounters() {
+#if defined(__linux__)
+    static constexpr uint64_t kConfigs[kNumPerfEvents] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (size_t event = 0; event < kNumPerfEvents; ++event) {
+      perf_event_attr attr{};
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = kConfigs[event];
+      attr.disabled = leader_ == -1 ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      const auto fd = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+      if (fd == -1) {
+        continue;
+      }
+      if (leader_ == -1) {
+        leader_ = fd;
+      }
+      fds_.push_back(fd);
+      events_.push_back(static_cast<PerfEvent>(event));
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (const int fd : fds_) {
+      close(fd);
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  // Whether any event could be opened.
+  [[nodiscard]] bool Available() const noexcept { return leader_ != -1; }
+
+  void Start() noexcept {
+#if defined(__linux__)
+    if (Available()) {
+      ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+  }
+
+  // Returns the counts since Start().
+  [[nodiscard]] PerfSample Stop() noexcept {
+    PerfSample sample;
+#if defined(__linux__)
+    if (!Available()) {
+      return sample;
+    }
+    ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    // Layout of PERF_FORMAT_GROUP: the number of events, the times enabled
+    // and running, then one value per event, in the order they were opened.
+    std::array<uint64_t, 3 + kNumPerfEvents> buffer{};
+    const ssize_t bytes = read(leader_, buffer.data(), sizeof(buffer));
+    if (bytes < static_cast<ssize_t>(3 * sizeof(uint64_t)) ||
+        buffer[0] != events_.size()) {
+      return sample;
+    }
+    const uint64_t enabled = buffer[1];
+    const uint64_t running = buffer[2];
+    if (running == 0) {
+      return sample;  // the group never got a counter
+    }
+    for (size_t i = 0; i < events_.size(); ++i) {
+      uint64_t count = buffer[3 + i];
+      if (running < enabled) {
+        count = static_cast<uint64_t>(static_cast<double>(count) *
+                                      static_cast<double>(enabled) /
+                                      static_cast<double>(running));
+      }
+      sample.counts[static_cast<size_t>(events_[i])] = count;
+    }
+#endif
+    return sample;
+  }
+
+ private:
+  int leader_ = -1;
+  std::vector<int> fds_;
+  std::vector<PerfEvent> events_;  // of |fds_|, in group order
+};
+
+#endif  // PERF_COUNTERS_H
@@ -0,0 +1,276 @@
+#ifndef SET_STATS_H
+#define SET_STATS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "src/cache_line.h"
+#include "src/thread_index.h"
+
+// ============================================================================
+// Hot-path statistics
+// ----------------------------------------------------------------------------
+// Building with HASH_SET_STATS defined (the HASH_SET_STATS CMake option) makes
+// the chaining sets count, as they run:
+//  - lock acquisitions, and those that found the lock taken and had to wait;
+//  - probes, i.e. lookups of a bucket by Add, Remove and Contains, and the
+//    length of the bucket each one searched: a miss scans all of it, a hit
+//    stops at the element;
+//  - resizes, and the time threads spent rehashing.
+// Counters live in per-thread shards and are only summed by Stats(), which
+// also takes a histogram of the current bucket lengths. Without
+// HASH_SET_STATS, SetStats and StatCounter are empty and their methods do
+// nothing, so the hot paths compile exactly as before; Stats() then only
+// reports the bucket lengths.
+// ============================================================================
+
+#if defined(HASH_SET_STATS)
+inline constexpr bool kSetStatsEnabled = true;
+#else
+inline constexpr bool kSetStatsEnabled = false;
+#endif
+
+// Bucket lengths from 0 to kBucketLengthBins - 2 get a bin each; the last
+// bin counts every longer bucket.
+inline constexpr size_t kBucketLengthBins = 16;
+
+// ----------------------------------------------------------------------------
+// Statistics of a set, as returned by its Stats().
+// ----------------------------------------------------------------------------
+struct SetStatsSnapshot {
+  uint64_t lock_acquisitions = 0;
+  uint64_t contended_acquisitions = 0;
+  uint64_t probes = 0;
+  uint64_t probed_elements = 0;  // sum of the bucket lengths probed
+  uint64_t max_probe_length = 0;
+  uint64_t resizes = 0;
+  uint64_t rehash_nanos = 0;  // summed over every thread that rehashed
+  // Contended acquisitions of each lock stripe (HashSetStriped only).
+  std::vector<uint64_t> contended_per_stripe;
+  std::array<uint64_t, kBucketLengthBins> bucket_lengths = {};
+
+  void CountBucket(size_t length) noexcept {
+    ++bucket_lengths[std::min(length, kBucketLengthBins - 1)];
+  }
+
+  // Adds the statistics of another set, e.g. of another shard.
+  void Merge(const SetStatsSnapshot& other) {
+    lock_acquisitions += other.lock_acquisitions;
+    contended_acquisitions += other.contended_acquisitions;
+    probes += other.probes;
+    probed_elements += other.probed_elements;
+    max_probe_length = std::max(max_probe_length, other.max_probe_length);
+    resizes += other.resizes;
+    rehash_nanos += other.rehash_nanos;
+    contended_per_stripe.insert(contended_per_stripe.end(),
+                                other.contended_per_stripe.begin(),
+                                other.contended_per_stripe.end());
+    for (size_t bin = 0; bin < kBucketLengthBins; ++bin) {
+      bucket_lengths[bin] += other.bucket_lengths[bin];
+    }
+  }
+
+  [[nodiscard]] double MeanProbeLength() const noexcept {
+    return probes == 0 ? 0.0
+                       : static_cast<double>(probed_elements) /
+                             static_cast<double>(probes);
+  }
+};
+
+// Sets whose statistics can be read and reset.
+template <typename S>
+concept ReportsSetStats = requires(S& hash_set) {
+  { hash_set.Stats() } -> std::same_as<SetStatsSnapshot>;
+  hash_set.ResetStats();
+};
+
+#if defined(HASH_SET_STATS)
+
+// ----------------------------------------------------------------------------
+// A single counter shared by every thread, for per-lock counts.
+// ----------------------------------------------------------------------------
+class StatCounter {
+ public:
+  void Add(uint64_t delta) noexcept {
+    value_.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] uint64_t Load() const noexcept {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+  void Reset() noexcept { value_.store(0, std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> value_{0};
+};
+
+// ----------------------------------------------------------------------------
+// The counters of a set, sharded like ShardedCounter (see sharded_counter.h).
+// ----------------------------------------------------------------------------
+class SetStats {
+ public:
+  SetStats()
+      : shards_(std::bit_ceil<size_t>(
+            std::max(1u, std::thread::hardware_concurrency()))),
+        mask_(shards_.size() - 1) {}
+
+  void RecordLock(bool contended) noexcept {
+    Shard& shard = LocalShard();
+    Bump(shard.lock_acquisitions, 1);
+    if (contended) {
+      Bump(shard.contended_acquisitions, 1);
+    }
+  }
+
+  void RecordProbe(size_t length) noexcept {
+    Shard& shard = LocalShard();
+    Bump(shard.probes, 1);
+    Bump(shard.probed_elements, length);
+    if (length > shard.max_probe_length.load(std::memory_order_relaxed)) {
+      shard.max_probe_length.store(length, std::memory_order_relaxed);
+    }
+  }
+
+  void RecordResize() noexcept { Bump(LocalShard().resizes, 1); }
+
+  // Adds the time until its destruction to the rehash time.
+  class RehashTimer {
+   public:
+    explicit RehashTimer(SetStats& stats) noexcept
+        : stats_(stats), begin_(std::chrono::steady_clock::now()) {}
+
+    ~RehashTimer() {
+      const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - begin_)
+                             .count();
+      Bump(stats_.LocalShard().rehash_nanos, static_cast<uint64_t>(nanos));
+    }
+
+    RehashTimer(const RehashTimer&) = delete;
+    RehashTimer& operator=(const RehashTimer&) = delete;
+
+   private:
+    SetStats& stats_;
+    std::chrono::steady_clock::time_point begin_;
+  };
+
+  [[nodiscard]] RehashTimer TimeRehash() noexcept { return RehashTimer(*this); }
+
+  // Adds the counters to |snapshot|.
+  void AddTo(SetStatsSnapshot& snapshot) const noexcept {
+    for (const Shard& shard : shards_) {
+      snapshot.lock_acquisitions += Read(shard.lock_acquisitions);
+      snapshot.contended_acquisitions += Read(shard.contended_acquisitions);
+      snapshot.probes += Read(shard.probes);
+      snapshot.probed_elements += Read(shard.probed_elements);
+      snapshot.max_probe_length =
+          std::max(snapshot.max_probe_length, Read(shard.max_probe_length));
+      snapshot.resizes += Read(shard.resizes);
+      snapshot.rehash_nanos += Read(shard.rehash_nanos);
+    }
+  }
+
+  // Zeroes the counters. Updates that race with it may survive.
+  void Reset() noexcept {
+    for (Shard& shard : shards_) {
+      for (std::atomic<uint64_t>* counter :
+           {&shard.lock_acquisitions, &shard.contended_acquisitions,
+            &shard.probes, &shard.probed_elements, &shard.max_probe_length,
+            &shard.resizes, &shard.rehash_nanos}) {
+        counter->store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+ private:
+  struct alignas(kCacheLineSize) Shard {
+    std::atomic<uint64_t> lock_acquisitions{0};
+    std::atomic<uint64_t> contended_acquisitions{0};
+    std::atomic<uint64_t> probes{0};
+    std::atomic<uint64_t> probed_elements{0};
+    std::atomic<uint64_t> max_probe_length{0};
+    std::atomic<uint64_t> resizes{0};
+    std::atomic<uint64_t> rehash_nanos{0};
+  };
+
+  // Threads past the shard count share shards, so updates stay atomic; the
+  // max is kept per shard without a CAS loop and may miss a racing update.
+  static void Bump(std::atomic<uint64_t>& counter, uint64_t delta) noexcept {
+    counter.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  static uint64_t Read(const std::atomic<uint64_t>& counter) noexcept {
+    return counter.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] Shard& LocalShard() noexcept {
+    return shards_[CurrentThreadIndex() & mask_];
+  }
+
+  std::vector<Shard> shards_;  // power-of-two count
+  size_t mask_;
+};
+
+#else  // !defined(HASH_SET_STATS)
+
+class StatCounter {
+ public:
+  void Add(uint64_t /*delta*/) noexcept {}
+  [[nodiscard]] uint64_t Load() const noexcept { return 0; }
+  void Reset() noexcept {}
+};
+
+class SetStats {
+ public:
+  void RecordLock(bool /*contended*/) noexcept {}
+  void RecordProbe(size_t /*length*/) noexcept {}
+  void RecordResize() noexcept {}
+
+  class RehashTimer {
+   public:
+    ~RehashTimer() {}  // keeps unused timers from being warned about
+  };
+
+  [[nodiscard]] RehashTimer TimeRehash() noexcept { return RehashTimer(); }
+
+  void AddTo(SetStatsSnapshot& /*snapshot*/) const noexcept {}
+  void Reset() noexcept {}
+};
+
+#endif  // defined(HASH_SET_STATS)
+
+// ----------------------------------------------------------------------------
+// Returns |mutex| locked in a |Lock| (std::unique_lock or std::shared_lock),
+// recording in |stats| whether the caller had to wait for it. Waits are also
+// counted in |contentions|, if given.
+// ----------------------------------------------------------------------------
+template <typename Lock, typename Mutex>
+[[nodiscard]] Lock AcquireLock(Mutex& mutex, SetStats& stats,
+                               StatCounter* contentions = nullptr) {
+  if constexpr (kSetStatsEnabled) {
+    Lock lock(mutex, std::try_to_lock);
+    const bool contended = !lock.owns_lock();
+    if (contended) {
+      lock.lock();
+      if (contentions != nullptr) {
+        contentions->Add(1);
+      }
+    }
+    stats.RecordLock(contended);
+    return lock;
+  } else {
+    return Lock(mutex);
+  }
+}
+
+#endif  // SET_STATS_H
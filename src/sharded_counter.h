@@ -0,0 +1,137 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "src/cache_line.h"
+#include "src/thread_index.h"
+
+// ============================================================================
+// Sharded counter
+// ----------------------------------------------------------------------------
+//  - Spreads a count over cache-line-padded shards. Each thread updates the
+//    shard it is assigned on first use, so concurrent writers rarely share a
+//    cache line.
+//  - Size() sums every shard; it is exact whenever no update is in flight.
+//  - ApproximateSize() reads a single word that a shard adjusts each time
+//    its own count crosses a multiple of kBatch. It never overestimates and
+//    lags the exact count by less than kBatch per shard.
+//  - Exceeds(bound) answers Size() > bound from the approximation when the
+//    error bound allows, and only sums the shards close to |bound|. This is
+//    the fast path intended for resize decisions.
+// ============================================================================
+class ShardedCounter {
+ public:
+  explicit ShardedCounter(size_t num_shards = DefaultShardCount())
+      : shards_(RoundUpToPowerOfTwo(num_shards)),
+        mask_(shards_.size() - 1),
+        max_lag_(shards_.size() * static_cast<size_t>(kBatch - 1)) {}
+
+  // --------------------------------------------------------------------------
+  // Default shard count: one per hardware thread, rounded up to a power of
+  // two.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] static size_t DefaultShardCount() noexcept {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  void Increment() noexcept {
+    const int64_t now =
+        LocalShard().value.fetch_add(1, std::memory_order_relaxed) + 1;
+    if ((now & (kBatch - 1)) == 0) {
+      approximate_.fetch_add(kBatch, std::memory_order_relaxed);
+    }
+  }
+
+  void Decrement() noexcept {
+    const int64_t before =
+        LocalShard().value.fetch_sub(1, std::memory_order_relaxed);
+    if ((before & (kBatch - 1)) == 0) {
+      approximate_.fetch_sub(kBatch, std::memory_order_relaxed);
+    }
+  }
+
+  // Adds |count| at once, e.g. for the elements of a bulk load.
+  void Add(size_t count) noexcept {
+    const int64_t delta = static_cast<int64_t>(count);
+    const int64_t before =
+        LocalShard().value.fetch_add(delta, std::memory_order_relaxed);
+    const int64_t crossed = Batches(before + delta) - Batches(before);
+    if (crossed != 0) {
+      approximate_.fetch_add(crossed * kBatch, std::memory_order_relaxed);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the sum of all shards.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t Size() const noexcept {
+    int64_t total = 0;
+    for (const auto& shard : shards_) {
+      total += shard.value.load(std::memory_order_relaxed);
+    }
+    return static_cast<size_t>(std::max<int64_t>(total, 0));
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns a lower bound on Size() that is off by at most MaxLag().
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t ApproximateSize() const noexcept {
+    return static_cast<size_t>(
+        std::max<int64_t>(approximate_.load(std::memory_order_relaxed), 0));
+  }
+
+  [[nodiscard]] size_t MaxLag() const noexcept { return max_lag_; }
+
+  // --------------------------------------------------------------------------
+  // Returns true if Size() > |bound|.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool Exceeds(size_t bound) const noexcept {
+    const size_t approximate = ApproximateSize();
+    if (approximate > bound) {
+      return true;
+    }
+    if (approximate + max_lag_ <= bound) {
+      return false;
+    }
+    return Size() > bound;
+  }
+
+ private:
+  static constexpr int64_t kBatch = 64;  // must be a power of two
+
+  struct alignas(kCacheLineSize) Shard {
+    std::atomic<int64_t> value{0};
+  };
+
+  // The number of multiples of kBatch in (0, value], negated below zero: the
+  // multiples a shard's count crosses are what approximate_ follows.
+  [[nodiscard]] static int64_t Batches(int64_t value) noexcept {
+    return value >= 0 ? value / kBatch : (value - (kBatch - 1)) / kBatch;
+  }
+
+  [[nodiscard]] static size_t RoundUpToPowerOfTwo(size_t value) noexcept {
+    size_t result = 1;
+    while (result < value) {
+      result *= 2;
+    }
+    return result;
+  }
+
+  // The first shards_.size() threads get a shard of their own.
+  [[nodiscard]] Shard& LocalShard() noexcept {
+    return shards_[CurrentThreadIndex() & mask_];
+  }
+
+  std::vector<Shard> shards_;  // power-of-two count
+  size_t mask_;
+  size_t max_lag_;
+  alignas(kCacheLineSize) std::atomic<int64_t> approximate_{0};
+};
+
+#endif  // SHARDED_COUNTER_H
@@ -0,0 +1,403 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "src/bucket_storage.h"
+
+// ============================================================================
+// Snapshots
+// ----------------------------------------------------------------------------
+// A snapshot is a set's table written to a file in a flat layout that can be
+// mapped and used in place, so that a restarted process gets its elements
+// back without adding them one by one:
+//
+//   SnapshotHeader    - magic, version, layout fingerprint, bucket count,
+//                       element count and where the sections start
+//   elements          - every element, bucket after bucket, each bucket's
+//                       elements in the order the bucket visits them
+//   bucket offsets    - bucket_count + 1 entries; bucket i holds the
+//                       elements [offsets[i], offsets[i + 1])
+//
+// The chaining sets write snapshots with SaveSnapshot(). Bucket i of a
+// snapshot holds exactly the elements with HashPolicy::Index(h, bucket_count)
+// == i, so a MappedSnapshot answers lookups straight from the mapping, and
+// HashSetRefinable can adopt it as its first table, copying every bucket
+// into the bucket of the same index without hashing a single element.
+//
+// Elements are stored as their object representation, so T must be
+// trivially copyable, and a snapshot is only meaningful to a build with the
+// same element type, hash policy and hash function. The fingerprint covers
+// the first two; std::hash is only spot-checked when a snapshot is opened,
+// on the first element of a sample of buckets. Files are native-endian.
+//
+// I/O failures throw std::system_error, and files that are not snapshots of
+// the expected layout std::runtime_error.
+// ============================================================================
+
+// Elements a snapshot can hold.
+template <typename T>
+concept SnapshotElement = std::is_trivially_copyable_v<T>;
+
+struct SnapshotHeader {
+  uint64_t magic;
+  uint64_t version;
+  uint64_t fingerprint;      // see SnapshotFingerprint()
+  uint64_t bucket_count;
+  uint64_t size;             // number of elements
+  uint64_t elements_offset;  // from the start of the file
+  uint64_t offsets_offset;
+};
+
+inline constexpr uint64_t kSnapshotMagic = 0x544f485350414e53ULL;  // SNAPSHOT
+inline constexpr uint64_t kSnapshotVersion = 1;
+
+// Buckets whose first element is rehashed when a snapshot is opened.
+inline constexpr size_t kSnapshotCheckedBuckets = 64;
+
+namespace snapshot_internal {
+
+[[nodiscard]] inline uint64_t Fnv1a(uint64_t h, std::string_view text) {
+  for (const char c : text) {
+    h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+[[nodiscard]] constexpr uint64_t AlignUp(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+[[noreturn]] inline void ThrowErrno(const std::string& what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+}  // namespace snapshot_internal
+
+// ----------------------------------------------------------------------------
+// Identifies the element type and hash policy of a snapshot, from the names
+// and layout the compiler gives them.
+// ----------------------------------------------------------------------------
+template <SnapshotElement T, typename HashPolicy>
+[[nodiscard]] uint64_t SnapshotFingerprint() {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  h = snapshot_internal::Fnv1a(h, typeid(T).name());
+  h = snapshot_internal::Fnv1a(h, typeid(HashPolicy).name());
+  h = snapshot_internal::Fnv1a(
+      h, std::to_string(sizeof(T)) + "/" + std::to_string(alignof(T)));
+  return h;
+}
+
+// ----------------------------------------------------------------------------
+// Writes a snapshot, one bucket at a time, to a temporary file next to
+// |path| that Finish() renames to |path|, so that a snapshot is either
+// complete or absent. The buckets must be added in index order. A writer
+// that is destroyed unfinished removes the temporary file.
+// ----------------------------------------------------------------------------
+template <typename T, typename HashPolicy>
+class SnapshotWriter {
+  static_assert(SnapshotElement<T>, "elements must be trivially copyable");
+
+ public:
+  explicit SnapshotWriter(std::filesystem::path path)
+      : path_(std::move(path)), temp_path_(path_.string() + ".tmp") {
+    file_.open(temp_path_, std::ios::binary | std::ios::trunc);
+    if (!file_) {
+      snapshot_internal::ThrowErrno("cannot create " + temp_path_.string());
+    }
+    // The header is written last, once the sections are known.
+    Pad(ElementsOffset());
+  }
+
+  ~SnapshotWriter() {
+    if (!finished_) {
+      file_.close();
+      std::error_code ignored;
+      std::filesystem::remove(temp_path_, ignored);
+    }
+  }
+
+  SnapshotWriter(const SnapshotWriter&) = delete;
+  SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+  // Appends the next bucket (see bucket_storage.h).
+  template <typename Bucket>
+  void AddBucket(const Bucket& bucket) {
+    offsets_.push_back(size_);
+    bucket.ForEach([this](const T& elem) {
+      Write(&elem, sizeof(T));
+      ++size_;
+    });
+  }
+
+  // Writes the bucket offsets and the header, and publishes the file.
+  void Finish() {
+    offsets_.push_back(size_);
+    const uint64_t offsets_offset =
+        snapshot_internal::AlignUp(position_, alignof(uint64_t));
+    Pad(offsets_offset);
+    Write(offsets_.data(), offsets_.size() * sizeof(uint64_t));
+
+    const SnapshotHeader header{
+        .magic = kSnapshotMagic,
+        .version = kSnapshotVersion,
+        .fingerprint = SnapshotFingerprint<T, HashPolicy>(),
+        .bucket_count = offsets_.size() - 1,
+        .size = size_,
+        .elements_offset = ElementsOffset(),
+        .offsets_offset = offsets_offset,
+    };
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file_.close();
+    if (!file_) {
+      snapshot_internal::ThrowErrno("cannot write " + temp_path_.string());
+    }
+    std::filesystem::rename(temp_path_, path_);
+    finished_ = true;
+  }
+
+ private:
+  [[nodiscard]] static constexpr uint64_t ElementsOffset() {
+    return snapshot_internal::AlignUp(sizeof(SnapshotHeader), alignof(T));
+  }
+
+  void Write(const void* data, uint64_t bytes) {
+    file_.write(static_cast<const char*>(data),
+                static_cast<std::streamsize>(bytes));
+    position_ += bytes;
+  }
+
+  // Zero-fills the file up to |offset|.
+  void Pad(uint64_t offset) {
+    static constexpr char kZeros[64] = {};
+    while (position_ < offset) {
+      Write(kZeros, std::min<uint64_t>(offset - position_, sizeof(kZeros)));
+    }
+  }
+
+  std::filesystem::path path_;
+  std::filesystem::path temp_path_;
+  std::ofstream file_;
+  std::vector<uint64_t> offsets_;
+  uint64_t position_ = 0;  // bytes written so far
+  uint64_t size_ = 0;
+  bool finished_ = false;
+};
+
+// ----------------------------------------------------------------------------
+// A snapshot mapped read-only into memory, and usable in place as a
+// read-only set. The mapping is private to the process and shared with the
+// page cache, so opening a snapshot costs a validation pass over the bucket
+// offsets, and the elements are only read when they are looked up. On
+// systems without mmap the file is read into memory instead.
+// ----------------------------------------------------------------------------
+template <typename T, typename HashPolicy>
+class MappedSnapshot {
+  static_assert(SnapshotElement<T>, "elements must be trivially copyable");
+
+ public:
+  explicit MappedSnapshot(const std::filesystem::path& path) {
+    Map(path);
+    // The destructor does not run if the constructor throws.
+    try {
+      Load(path.string());
+    } catch (...) {
+      Unmap();
+      throw;
+    }
+  }
+
+  ~MappedSnapshot() { Unmap(); }
+
+  MappedSnapshot(const MappedSnapshot&) = delete;
+  MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+  template <typename K>
+  [[nodiscard]] bool Contains(const K& key) const {
+    const size_t h = HashPolicy::Hash(key);
+    const std::span<const T> bucket =
+        Bucket(HashPolicy::Index(h, BucketCount()));
+    return FindKey(bucket.data(), bucket.size(), key) != bucket.size();
+  }
+
+  [[nodiscard]] size_t Size() const noexcept {
+    return static_cast<size_t>(header_.size);
+  }
+
+  [[nodiscard]] size_t BucketCount() const noexcept {
+    return static_cast<size_t>(header_.bucket_count);
+  }
+
+  // The elements of bucket |index|.
+  [[nodiscard]] std::span<const T> Bucket(size_t index) const noexcept {
+    const size_t begin = static_cast<size_t>(offsets_[index]);
+    const size_t end = static_cast<size_t>(offsets_[index + 1]);
+    return {elems_ + begin, end - begin};
+  }
+
+ private:
+  // Reads and checks the header of the mapped file |name|, and locates its
+  // sections.
+  void Load(const std::string& name) {
+    if (bytes_ < sizeof(SnapshotHeader)) {
+      throw std::runtime_error(name + " is not a snapshot");
+    }
+    std::memcpy(&header_, data_, sizeof(header_));
+    if (header_.magic != kSnapshotMagic ||
+        header_.version != kSnapshotVersion) {
+      throw std::runtime_error(name + " is not a snapshot");
+    }
+    if (header_.fingerprint != SnapshotFingerprint<T, HashPolicy>()) {
+      throw std::runtime_error(name +
+                               " holds another element type or hash policy");
+    }
+    Validate(name);
+    elems_ = static_cast<const T*>(At(header_.elements_offset));
+    offsets_ = static_cast<const uint64_t*>(At(header_.offsets_offset));
+    CheckHashes(name);
+  }
+
+  [[nodiscard]] const void* At(uint64_t offset) const noexcept {
+    return static_cast<const char*>(data_) + offset;
+  }
+
+  // Checks that the sections lie within the file and that the bucket
+  // offsets are in order, so that no lookup can read outside the mapping.
+  void Validate(const std::string& name) const {
+    const uint64_t elements_end =
+        header_.elements_offset + header_.size * sizeof(T);
+    const uint64_t offsets_bytes =
+        (header_.bucket_count + 1) * sizeof(uint64_t);
+    const bool in_bounds =
+        header_.bucket_count > 0 &&
+        header_.bucket_count < bytes_ / sizeof(uint64_t) &&
+        header_.size <= bytes_ / sizeof(T) &&
+        header_.elements_offset % alignof(T) == 0 &&
+        header_.offsets_offset % alignof(uint64_t) == 0 &&
+        header_.elements_offset >= sizeof(SnapshotHeader) &&
+        header_.elements_offset <= bytes_ &&
+        elements_end <= header_.offsets_offset &&
+        header_.offsets_offset <= bytes_ &&
+        offsets_bytes <= bytes_ - header_.offsets_offset &&
+        HashPolicy::Capacity(static_cast<size_t>(header_.bucket_count)) ==
+            header_.bucket_count;
+    if (!in_bounds) {
+      throw std::runtime_error(name + " is truncated or corrupt");
+    }
+    const auto* offsets =
+        static_cast<const uint64_t*>(At(header_.offsets_offset));
+    uint64_t previous = 0;
+    for (uint64_t i = 0; i <= header_.bucket_count; ++i) {
+      if (offsets[i] < previous) {
+        throw std::runtime_error(name + " is truncated or corrupt");
+      }
+      previous = offsets[i];
+    }
+    if (offsets[0] != 0 || previous != header_.size) {
+      throw std::runtime_error(name + " is truncated or corrupt");
+    }
+  }
+
+  // Rehashes the first element of a sample of buckets, spread over the
+  // table, to catch a hash function that changed since the snapshot.
+  void CheckHashes(const std::string& name) const {
+    const size_t buckets = BucketCount();
+    const size_t stride =
+        std::max<size_t>(buckets / kSnapshotCheckedBuckets, 1);
+    for (size_t index = 0; index < buckets; index += stride) {
+      const std::span<const T> bucket = Bucket(index);
+      if (!bucket.empty() &&
+          HashPolicy::Index(HashPolicy::Hash(bucket.front()), buckets) !=
+              index) {
+        throw std::runtime_error(name + " was written with another hash");
+      }
+    }
+  }
+
+#if defined(__linux__) || defined(__APPLE__)
+  void Map(const std::filesystem::path& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      snapshot_internal::ThrowErrno("cannot open " + path.string());
+    }
+    struct stat status {};
+    if (fstat(fd, &status) != 0) {
+      const int error = errno;
+      close(fd);
+      errno = error;
+      snapshot_internal::ThrowErrno("cannot stat " + path.string());
+    }
+    bytes_ = static_cast<size_t>(status.st_size);
+    if (bytes_ == 0) {
+      close(fd);
+      return;
+    }
+    void* data = mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+    const int error = errno;
+    close(fd);  // the mapping keeps the file open
+    if (data == MAP_FAILED) {
+      errno = error;
+      bytes_ = 0;
+      snapshot_internal::ThrowErrno("cannot map " + path.string());
+    }
+    data_ = data;
+  }
+
+  void Unmap() noexcept {
+    if (data_ != nullptr) {
+      munmap(const_cast<void*>(data_), bytes_);
+    }
+  }
+#else
+  void Map(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      snapshot_internal::ThrowErrno("cannot open " + path.string());
+    }
+    bytes_ = static_cast<size_t>(std::filesystem::file_size(path));
+    // uint64_t words, so that the sections are as aligned as in a mapping.
+    buffer_.resize(bytes_ / sizeof(uint64_t) + 1);
+    file.read(reinterpret_cast<char*>(buffer_.data()),
+              static_cast<std::streamsize>(bytes_));
+    if (!file) {
+      snapshot_internal::ThrowErrno("cannot read " + path.string());
+    }
+    data_ = buffer_.data();
+  }
+
+  void Unmap() noexcept {}
+
+  std::vector<uint64_t> buffer_;
+#endif
+
+  const void* data_ = nullptr;
+  size_t bytes_ = 0;
+  SnapshotHeader header_{};
+  const T* elems_ = nullptr;
+  const uint64_t* offsets_ = nullptr;
+};
+
+#endif  // SNAPSHOT_H
@@ -0,0 +1,183 @@
+#ifndef TABLE_SIZING_H
+#define TABLE_SIZING_H
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+
+// ============================================================================
+// Table sizing
+// ----------------------------------------------------------------------------
+// Every set grows its table by a growth factor F once its load factor passes
+// its grow threshold G, which leaves the load factor at G / F. TableSizing
+// adds the way back down:
+//  - When a removal leaves the load factor below the shrink load factor, the
+//    set resizes its table, the same way it grows it, to the smallest
+//    capacity at which the load factor is below G / F again.
+//    SetShrinkLoadFactor() of the set changes it; 0 turns shrinking off.
+//  - The shrink load factor is at most G / F^2, so that every shrink takes
+//    away at least a factor F, and defaults to half that. A table that just
+//    shrank has to gain F times its elements before it grows again, and one
+//    that just grew has to lose all but 1 / 2F of them before it shrinks:
+//    sets that hover around a size do not resize back and forth.
+//  - The capacity never drops below a minimum: the initial capacity, raised
+//    by Reserve().
+//  - Compact() rebuilds the table at that same smallest capacity, whatever
+//    the shrink load factor. It rebuilds even at the current capacity, which
+//    reallocates buckets that kept the capacity of an earlier peak, and
+//    releases the arena of the old table (see arena.h).
+//  - Reserve(n) raises the minimum capacity until n elements fit below G, and
+//    grows the table to it, so that removals do not give the room back.
+// Capacities only ever move by factors of F from the initial one, so each is
+// a multiple or a divisor of every other (see hash_policy.h).
+// ============================================================================
+
+// Why a set resizes its table.
+enum class ResizeGoal {
+  kGrow,     // the load factor passed the grow threshold
+  kShrink,   // the load factor fell below the shrink load factor
+  kCompact,  // Compact() was called
+  kReserve,  // Reserve() raised the minimum capacity
+};
+
+class TableSizing {
+ public:
+  // --------------------------------------------------------------------------
+  // Sizing of a table that starts at |min_capacity| and grows by
+  // |growth_factor| once its load factor exceeds |grow_load_factor|.
+  // --------------------------------------------------------------------------
+  TableSizing(size_t min_capacity, double grow_load_factor,
+              size_t growth_factor) noexcept
+      : grow_load_factor_(grow_load_factor),
+        growth_factor_(growth_factor),
+        min_capacity_(min_capacity),
+        shrink_load_factor_(MaxShrinkLoadFactor() / 2) {
+    assert(growth_factor >= 2 && "Tables must grow by a factor of at least 2");
+  }
+
+  TableSizing(const TableSizing&) = delete;
+  TableSizing& operator=(const TableSizing&) = delete;
+
+  [[nodiscard]] double MaxShrinkLoadFactor() const noexcept {
+    return grow_load_factor_ /
+           static_cast<double>(growth_factor_ * growth_factor_);
+  }
+
+  [[nodiscard]] double ShrinkLoadFactor() const noexcept {
+    return shrink_load_factor_.load(std::memory_order_relaxed);
+  }
+
+  void SetShrinkLoadFactor(double load_factor) noexcept {
+    assert(load_factor >= 0 && load_factor <= MaxShrinkLoadFactor() &&
+           "Shrink load factor out of range");
+    shrink_load_factor_.store(load_factor, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] size_t MinCapacity() const noexcept {
+    return min_capacity_.load(std::memory_order_relaxed);
+  }
+
+  // --------------------------------------------------------------------------
+  // Raises the minimum capacity to the smallest capacity, reached from it by
+  // factors of F, that holds |num_elements| below G.
+  // --------------------------------------------------------------------------
+  void Reserve(size_t num_elements) noexcept {
+    size_t current = min_capacity_.load(std::memory_order_relaxed);
+    size_t capacity = current;
+    while (static_cast<double>(num_elements) >
+           grow_load_factor_ * static_cast<double>(capacity)) {
+      capacity *= growth_factor_;
+    }
+    while (current < capacity &&
+           !min_capacity_.compare_exchange_weak(current, capacity,
+                                                std::memory_order_relaxed)) {
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns true if shrinking is on and a table of |capacity| may shrink by a
+  // factor F, staying at or above the minimum capacity and a multiple of
+  // |divisor| (e.g. a stripe count).
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool CanShrink(size_t capacity,
+                               size_t divisor = 1) const noexcept {
+    return ShrinkLoadFactor() > 0 &&
+           capacity >= MinCapacity() * growth_factor_ &&
+           capacity % growth_factor_ == 0 &&
+           (capacity / growth_factor_) % divisor == 0;
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the element count below which a table of |capacity| is under the
+  // shrink load factor.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t ShrinkBound(size_t capacity) const noexcept {
+    return static_cast<size_t>(
+        std::ceil(ShrinkLoadFactor() * static_cast<double>(capacity)));
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns true if a table of |capacity| holding |size| elements should
+  // shrink, for sets that count their elements exactly.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] bool ShouldShrink(size_t size, size_t capacity,
+                                  size_t divisor = 1) const noexcept {
+    return CanShrink(capacity, divisor) && size < ShrinkBound(capacity);
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the smallest capacity, reached from |capacity| by factors of F,
+  // at which |size| elements keep the load factor below G / F, but no less
+  // than the minimum capacity and a multiple of |divisor|.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t FitCapacity(size_t size, size_t capacity,
+                                   size_t divisor = 1) const noexcept {
+    while (!Fits(size, capacity)) {
+      capacity *= growth_factor_;
+    }
+    while (capacity >= MinCapacity() * growth_factor_ &&
+           capacity % growth_factor_ == 0 &&
+           (capacity / growth_factor_) % divisor == 0 &&
+           Fits(size, capacity / growth_factor_)) {
+      capacity /= growth_factor_;
+    }
+    return capacity;
+  }
+
+  // --------------------------------------------------------------------------
+  // Returns the smallest capacity, reached from |capacity| by factors of F,
+  // that holds |size| elements below G and is at least the minimum capacity.
+  // --------------------------------------------------------------------------
+  [[nodiscard]] size_t ReserveCapacity(size_t size,
+                                       size_t capacity) const noexcept {
+    while (capacity < MinCapacity() ||
+           static_cast<double>(size) >
+               grow_load_factor_ * static_cast<double>(capacity)) {
+      capacity *= growth_factor_;
+    }
+    return capacity;
+  }
+
+ private:
+  // Whether |size| elements keep a table of |capacity| below G / F.
+  [[nodiscard]] bool Fits(size_t size, size_t capacity) const noexcept {
+    return static_cast<double>(size) * static_cast<double>(growth_factor_) <
+           grow_load_factor_ * static_cast<double>(capacity);
+  }
+
+  const double grow_load_factor_;
+  const size_t growth_factor_;
+  std::atomic<size_t> min_capacity_;
+  std::atomic<double> shrink_load_factor_;
+};
+
+// Sets whose table can be shrunk, compacted and reserved.
+template <typename S>
+concept SizesTable = requires(S& hash_set, double load_factor, size_t n) {
+  hash_set.SetShrinkLoadFactor(load_factor);
+  hash_set.Compact();
+  hash_set.Reserve(n);
+};
+
+#endif  // TABLE_SIZING_H
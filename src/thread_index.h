@@ -0,0 +1,19 @@
+#ifndef THREAD_INDEX_H
+#define THREAD_INDEX_H
+
+#include <atomic>
+#include <cstddef>
+
+// ----------------------------------------------------------------------------
+// Returns a small number identifying the calling thread. Threads are
+// numbered in order of first use, so the first n threads get the indices
+// [0, n); sharded structures use it to give each thread a shard of its own.
+// ----------------------------------------------------------------------------
+[[nodiscard]] inline size_t CurrentThreadIndex() noexcept {
+  static std::atomic<size_t> next_index{0};
+  thread_local const size_t index =
+      next_index.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+#endif  // THREAD_INDEX_H
@@ -0,0 +1,569 @@
+#include "src/workload.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "src/numa.h"
+
+namespace workload {
+
+namespace {
+
+const char* OpName(size_t op) {
+  static constexpr const char* kNames[kNumOps] = {"contains", "add", "remove"};
+  return kNames[op];
+}
+
+const char* DistributionName(Distribution distribution) {
+  return distribution == Distribution::kZipfian ? "zipfian" : "uniform";
+}
+
+const char* DispatchName(Dispatch dispatch) {
+  return dispatch == Dispatch::kVirtual ? "virtual" : "static";
+}
+
+const char* AffinityName(Affinity affinity) {
+  static constexpr const char* kNames[] = {"none", "local", "remote",
+                                           "spread"};
+  return kNames[static_cast<size_t>(affinity)];
+}
+
+const char* PrefillModeName(PrefillMode mode) {
+  return mode == PrefillMode::kBulk ? "bulk" : "add";
+}
+
+void PrintUsage(const char* program) {
+  std::cerr
+      << "Usage: " << program << " [--flag=value ...]\n"
+      << "  --threads=1,2,4,8        thread counts to sweep\n"
+      << "  --impls=a,b,...          implementations to run (default: all)\n"
+      << "  --dispatch=static        static | virtual | static,virtual\n"
+      << "  --mix=90,5,5             read,insert,remove percentages\n"
+      << "  --distribution=uniform   uniform | zipfian\n"
+      << "  --zipf_theta=0.99        Zipfian skew, in (0, 1)\n"
+      << "  --key_range=1048576      keys are drawn from [0, key_range)\n"
+      << "  --prefill=50             percentage of the key range added first\n"
+      << "  --prefill_mode=add       add | bulk (build from all keys at once)\n"
+      << "  --initial_capacity=16    initial capacity of each set\n"
+      << "  --warmup_ms=200          unrecorded warmup per run\n"
+      << "  --duration_ms=1000       measured time per run\n"
+      << "  --seed=1                 base seed of the per-thread generators\n"
+      << "  --affinity=none          none | local | remote | spread\n"
+      << "  --format=csv             csv | json" << std::endl;
+}
+
+// Parses a comma-separated list of unsigned integers.
+bool ParseList(const std::string& text, std::vector<size_t>& values) {
+  values.clear();
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (item.empty() ||
+        item.find_first_not_of("0123456789") != std::string::npos) {
+      return false;
+    }
+    values.push_back(std::stoul(item));
+  }
+  return !values.empty();
+}
+
+bool ParseNames(const std::string& text, std::vector<std::string>& names) {
+  names.clear();
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (item.empty()) {
+      return false;
+    }
+    names.push_back(item);
+  }
+  return !names.empty();
+}
+
+bool ParseDispatches(const std::string& text,
+                     std::vector<Dispatch>& dispatches) {
+  std::vector<std::string> names;
+  if (!ParseNames(text, names)) {
+    return false;
+  }
+  dispatches.clear();
+  for (const std::string& name : names) {
+    if (name == "static") {
+      dispatches.push_back(Dispatch::kStatic);
+    } else if (name == "virtual") {
+      dispatches.push_back(Dispatch::kVirtual);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ParseSize(const std::string& text, size_t& value) {
+  std::vector<size_t> values;
+  if (!ParseList(text, values) || values.size() != 1) {
+    return false;
+  }
+  value = values[0];
+  return true;
+}
+
+bool ParseFlag(const std::string& name, const std::string& value,
+               Config& config) {
+  if (name == "threads") {
+    return ParseList(value, config.thread_counts) &&
+           std::find(config.thread_counts.begin(), config.thread_counts.end(),
+                     size_t{0}) == config.thread_counts.end();
+  }
+  if (name == "impls") {
+    return ParseNames(value, config.implementations);
+  }
+  if (name == "dispatch") {
+    return ParseDispatches(value, config.dispatches);
+  }
+  if (name == "mix") {
+    std::vector<size_t> mix;
+    if (!ParseList(value, mix) || mix.size() != 3 ||
+        mix[0] + mix[1] + mix[2] != 100) {
+      return false;
+    }
+    config.read_percent = static_cast<unsigned>(mix[0]);
+    config.insert_percent = static_cast<unsigned>(mix[1]);
+    config.remove_percent = static_cast<unsigned>(mix[2]);
+    return true;
+  }
+  if (name == "distribution") {
+    if (value == "uniform") {
+      config.distribution = Distribution::kUniform;
+      return true;
+    }
+    if (value == "zipfian") {
+      config.distribution = Distribution::kZipfian;
+      return true;
+    }
+    return false;
+  }
+  if (name == "zipf_theta") {
+    char* end = nullptr;
+    config.zipf_theta = std::strtod(value.c_str(), &end);
+    return end != value.c_str() && *end == '\0' && config.zipf_theta > 0 &&
+           config.zipf_theta < 1;
+  }
+  if (name == "key_range") {
+    // Keys are stored as int.
+    return ParseSize(value, config.key_range) && config.key_range > 0 &&
+           config.key_range <= size_t{1} << 31;
+  }
+  if (name == "prefill") {
+    size_t prefill = 0;
+    if (!ParseSize(value, prefill) || prefill > 100) {
+      return false;
+    }
+    config.prefill_percent = static_cast<unsigned>(prefill);
+    return true;
+  }
+  if (name == "prefill_mode") {
+    for (const PrefillMode mode : {PrefillMode::kAdd, PrefillMode::kBulk}) {
+      if (value == PrefillModeName(mode)) {
+        config.prefill_mode = mode;
+        return true;
+      }
+    }
+    return false;
+  }
+  if (name == "initial_capacity") {
+    return ParseSize(value, config.initial_capacity) &&
+           config.initial_capacity > 0;
+  }
+  if (name == "warmup_ms") {
+    return ParseSize(value, config.warmup_ms);
+  }
+  if (name == "duration_ms") {
+    return ParseSize(value, config.duration_ms) && config.duration_ms > 0;
+  }
+  if (name == "seed") {
+    size_t seed = 0;
+    if (!ParseSize(value, seed)) {
+      return false;
+    }
+    config.seed = seed;
+    return true;
+  }
+  if (name == "affinity") {
+    for (const Affinity affinity : {Affinity::kNone, Affinity::kLocal,
+                                    Affinity::kRemote, Affinity::kSpread}) {
+      if (value == AffinityName(affinity)) {
+        config.affinity = affinity;
+        return true;
+      }
+    }
+    return false;
+  }
+  if (name == "format") {
+    if (value == "csv") {
+      config.format = Format::kCsv;
+      return true;
+    }
+    if (value == "json") {
+      config.format = Format::kJson;
+      return true;
+    }
+    return false;
+  }
+  return false;
+}
+
+// Writes |values| separated by |separator|.
+template <typename Values>
+void PrintList(const Values& values, const char* separator) {
+  for (size_t i = 0; i < values.size(); i++) {
+    std::cout << (i == 0 ? "" : separator) << values[i];
+  }
+}
+
+// Riemann zeta partial sum: sum_{i=1..n} 1 / i^theta.
+double Zeta(size_t n, double theta) {
+  double sum = 0;
+  for (size_t i = 1; i <= n; i++) {
+    sum += 1 / std::pow(static_cast<double>(i), theta);
+  }
+  return sum;
+}
+
+// Writes the hot-path statistics columns of a CSV row; they are empty for
+// sets that do not report them.
+void PrintCsvStats(const std::optional<SetStatsSnapshot>& set_stats) {
+  if (!set_stats.has_value()) {
+    std::cout << ",,,,,,,,,";
+    return;
+  }
+  const SetStatsSnapshot& stats = *set_stats;
+  const auto& per_stripe = stats.contended_per_stripe;
+  std::cout << ',' << stats.lock_acquisitions << ','
+            << stats.contended_acquisitions << ',' << stats.probes << ','
+            << stats.MeanProbeLength() << ',' << stats.max_probe_length << ','
+            << stats.resizes << ','
+            << static_cast<double>(stats.rehash_nanos) / 1e6 << ',';
+  if (!per_stripe.empty()) {
+    std::cout << *std::max_element(per_stripe.begin(), per_stripe.end());
+  }
+  std::cout << ',';
+  PrintList(stats.bucket_lengths, ";");
+}
+
+void PrintCsv(const Config& config, const std::vector<Result>& results) {
+  std::cout << "implementation,dispatch,threads,read_pct,insert_pct,remove_pct,"
+               "distribution,key_range,affinity,seconds,ops,ops_per_sec";
+  for (size_t op = 0; op < kNumOps; op++) {
+    const char* name = OpName(op);
+    std::cout << ',' << name << "_ops," << name << "_p50_ns," << name
+              << "_p99_ns," << name << "_p999_ns";
+  }
+  std::cout << ",final_size,prefill_mode,prefill_ms";
+  if constexpr (kSetStatsEnabled) {
+    std::cout << ",lock_acquisitions,contended_acquisitions,probes,"
+                 "mean_probe_length,max_probe_length,resizes,rehash_ms,"
+                 "max_stripe_contentions,bucket_lengths";
+  }
+  std::cout << '\n';
+
+  for (const Result& result : results) {
+    std::cout << result.implementation << ','
+              << DispatchName(result.dispatch) << ',' << result.threads << ','
+              << config.read_percent << ',' << config.insert_percent << ','
+              << config.remove_percent << ','
+              << DistributionName(config.distribution) << ','
+              << config.key_range << ',' << AffinityName(config.affinity)
+              << ',' << result.seconds << ','
+              << result.ops << ','
+              << static_cast<uint64_t>(static_cast<double>(result.ops) /
+                                       result.seconds);
+    for (size_t op = 0; op < kNumOps; op++) {
+      std::cout << ',' << result.op_counts[op] << ',' << result.p50_ns[op]
+                << ',' << result.p99_ns[op] << ',' << result.p999_ns[op];
+    }
+    std::cout << ',' << result.final_size << ','
+              << PrefillModeName(config.prefill_mode) << ','
+              << result.prefill_seconds * 1e3;
+    if constexpr (kSetStatsEnabled) {
+      PrintCsvStats(result.set_stats);
+    }
+    std::cout << '\n';
+  }
+  std::cout << std::flush;
+}
+
+void PrintJson(const Config& config, const std::vector<Result>& results) {
+  std::cout << "{\n"
+            << "  \"config\": {\"read_pct\": " << config.read_percent
+            << ", \"insert_pct\": " << config.insert_percent
+            << ", \"remove_pct\": " << config.remove_percent
+            << ", \"distribution\": \""
+            << DistributionName(config.distribution) << "\""
+            << ", \"zipf_theta\": " << config.zipf_theta
+            << ", \"key_range\": " << config.key_range
+            << ", \"prefill_pct\": " << config.prefill_percent
+            << ", \"prefill_mode\": \""
+            << PrefillModeName(config.prefill_mode) << "\""
+            << ", \"initial_capacity\": " << config.initial_capacity
+            << ", \"warmup_ms\": " << config.warmup_ms
+            << ", \"duration_ms\": " << config.duration_ms
+            << ", \"seed\": " << config.seed << ", \"affinity\": \""
+            << AffinityName(config.affinity) << "\", \"numa_nodes\": "
+            << NumaNodeCount() << "},\n"
+            << "  \"results\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& result = results[i];
+    std::cout << (i == 0 ? "\n" : ",\n") << "    {\"implementation\": \""
+              << result.implementation << "\", \"dispatch\": \""
+              << DispatchName(result.dispatch) << "\", \"threads\": "
+              << result.threads << ", \"seconds\": " << result.seconds
+              << ", \"ops\": " << result.ops << ", \"ops_per_sec\": "
+              << static_cast<uint64_t>(static_cast<double>(result.ops) /
+                                       result.seconds)
+              << ", \"final_size\": " << result.final_size
+              << ", \"prefill_ms\": " << result.prefill_seconds * 1e3;
+    for (size_t op = 0; op < kNumOps; op++) {
+      std::cout << ", \"" << OpName(op) << "\": {\"ops\": "
+                << result.op_counts[op] << ", \"p50_ns\": "
+                << result.p50_ns[op] << ", \"p99_ns\": " << result.p99_ns[op]
+                << ", \"p999_ns\": " << result.p999_ns[op] << "}";
+    }
+    if (result.set_stats.has_value()) {
+      const SetStatsSnapshot& stats = *result.set_stats;
+      std::cout << ", \"set_stats\": {\"lock_acquisitions\": "
+                << stats.lock_acquisitions
+                << ", \"contended_acquisitions\": "
+                << stats.contended_acquisitions
+                << ", \"probes\": " << stats.probes
+                << ", \"mean_probe_length\": " << stats.MeanProbeLength()
+                << ", \"max_probe_length\": " << stats.max_probe_length
+                << ", \"resizes\": " << stats.resizes << ", \"rehash_ms\": "
+                << static_cast<double>(stats.rehash_nanos) / 1e6
+                << ", \"contended_per_stripe\": [";
+      PrintList(stats.contended_per_stripe, ", ");
+      std::cout << "], \"bucket_lengths\": [";
+      PrintList(stats.bucket_lengths, ", ");
+      std::cout << "]}";
+    }
+    std::cout << "}";
+  }
+  std::cout << "\n  ]\n}" << std::endl;
+}
+
+}  // namespace
+
+bool ParseArgs(int argc, char** argv, Config& config) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || equals == std::string::npos ||
+        !ParseFlag(arg.substr(2, equals - 2), arg.substr(equals + 1),
+                   config)) {
+      std::cerr << argv[0] << ": invalid argument '" << arg << "'"
+                << std::endl;
+      PrintUsage(argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// ZipfianGenerator
+// ----------------------------------------------------------------------------
+ZipfianGenerator::ZipfianGenerator(size_t n, double theta)
+    : n_(n),
+      theta_(theta),
+      alpha_(1 / (1 - theta)),
+      zeta_n_(Zeta(n, theta)),
+      eta_((1 - std::pow(2.0 / static_cast<double>(n), 1 - theta)) /
+           (1 - Zeta(2, theta) / zeta_n_)) {}
+
+size_t ZipfianGenerator::Sample(Random& random) const noexcept {
+  const double u = random.NextDouble();
+  const double uz = u * zeta_n_;
+  if (uz < 1) {
+    return 0;
+  }
+  if (uz < 1 + std::pow(0.5, theta_)) {
+    return std::min<size_t>(1, n_ - 1);
+  }
+  const auto rank = static_cast<size_t>(static_cast<double>(n_) *
+                                        std::pow(eta_ * u - eta_ + 1, alpha_));
+  return std::min(rank, n_ - 1);
+}
+
+// ----------------------------------------------------------------------------
+// LatencyHistogram
+// ----------------------------------------------------------------------------
+LatencyHistogram::LatencyHistogram() : counts_(kNumBuckets, 0) {}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    counts_[i] += other.counts_[i];
+  }
+}
+
+uint64_t LatencyHistogram::Count() const noexcept {
+  uint64_t count = 0;
+  for (const uint64_t bucket_count : counts_) {
+    count += bucket_count;
+  }
+  return count;
+}
+
+uint64_t LatencyHistogram::Percentile(double quantile) const noexcept {
+  const uint64_t count = Count();
+  if (count == 0) {
+    return 0;
+  }
+  // Rank of the sample that reaches |quantile|, counting from 1.
+  const double target = std::ceil(quantile * static_cast<double>(count));
+  const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(target));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return LowerBound(i);
+    }
+  }
+  return LowerBound(kNumBuckets - 1);
+}
+
+// Values below kSubBuckets get a bucket each. Larger values are identified by
+// the position of their highest set bit and the kSubBits bits that follow it.
+size_t LatencyHistogram::BucketOf(uint64_t nanos) noexcept {
+  if (nanos < kSubBuckets) {
+    return static_cast<size_t>(nanos);
+  }
+  const auto shift =
+      static_cast<unsigned>(std::bit_width(nanos)) - kSubBits - 1;
+  const auto sub = static_cast<size_t>(nanos >> shift) - kSubBuckets;
+  return (shift + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::LowerBound(size_t bucket) noexcept {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  const size_t shift = bucket / kSubBuckets - 1;
+  const size_t sub = bucket % kSubBuckets;
+  return static_cast<uint64_t>(kSubBuckets + sub) << shift;
+}
+
+// ----------------------------------------------------------------------------
+// Runs
+// ----------------------------------------------------------------------------
+void PinDriverThread(const Config& config) {
+  if (config.affinity == Affinity::kLocal ||
+      config.affinity == Affinity::kRemote) {
+    PinThreadToNumaNode(0);
+  }
+}
+
+void PinWorkerThread(const Config& config, size_t id) {
+  const size_t nodes = NumaNodeCount();
+  if (config.affinity == Affinity::kLocal) {
+    PinThreadToNumaNode(0);
+  } else if (config.affinity == Affinity::kRemote) {
+    PinThreadToNumaNode(1 % nodes);
+  } else if (config.affinity == Affinity::kSpread) {
+    PinThreadToNumaNode(id % nodes);
+  }
+}
+
+std::vector<int> PrefillKeys(const Config& config) {
+  std::vector<int> keys;
+  keys.reserve(config.key_range / 100 * config.prefill_percent + 100);
+  for (size_t key = 0; key < config.key_range; key++) {
+    if (key % 100 < config.prefill_percent) {
+      keys.push_back(static_cast<int>(key));
+    }
+  }
+  return keys;
+}
+
+Result Summarize(const std::string& implementation, size_t threads,
+                 double seconds, const std::vector<ThreadStats>& stats,
+                 size_t final_size) {
+  Result result;
+  result.implementation = implementation;
+  result.threads = threads;
+  result.seconds = seconds;
+  result.final_size = final_size;
+  for (size_t op = 0; op < kNumOps; op++) {
+    LatencyHistogram merged;
+    for (const ThreadStats& thread_stats : stats) {
+      merged.Merge(thread_stats.latency[op]);
+    }
+    result.op_counts[op] = merged.Count();
+    result.p50_ns[op] = merged.Percentile(0.5);
+    result.p99_ns[op] = merged.Percentile(0.99);
+    result.p999_ns[op] = merged.Percentile(0.999);
+  }
+  for (const ThreadStats& thread_stats : stats) {
+    result.ops += thread_stats.ops;
+  }
+  return result;
+}
+
+int RunSuite(const Config& config,
+             const std::vector<Implementation>& implementations) {
+  for (const std::string& name : config.implementations) {
+    if (std::none_of(implementations.begin(), implementations.end(),
+                     [&name](const Implementation& implementation) {
+                       return implementation.name == name;
+                     })) {
+      std::cerr << "Unknown implementation '" << name << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  if (config.affinity == Affinity::kRemote && NumaNodeCount() < 2) {
+    std::cerr << "Only one NUMA node: remote affinity runs locally"
+              << std::endl;
+  }
+
+  std::unique_ptr<ZipfianGenerator> zipfian;
+  if (config.distribution == Distribution::kZipfian) {
+    zipfian = std::make_unique<ZipfianGenerator>(config.key_range,
+                                                 config.zipf_theta);
+  }
+
+  std::vector<Result> results;
+  for (const Implementation& implementation : implementations) {
+    if (!config.implementations.empty() &&
+        std::find(config.implementations.begin(), config.implementations.end(),
+                  implementation.name) == config.implementations.end()) {
+      continue;
+    }
+    for (const size_t threads : config.thread_counts) {
+      if (!implementation.thread_safe && threads != 1) {
+        continue;
+      }
+      for (const Dispatch dispatch : config.dispatches) {
+        std::cerr << "Running " << implementation.name << " with " << threads
+                  << " thread(s), " << DispatchName(dispatch) << " dispatch"
+                  << std::endl;
+        results.push_back(implementation.run(implementation.name, config,
+                                             zipfian.get(), threads,
+                                             dispatch));
+      }
+    }
+  }
+
+  if (config.format == Format::kJson) {
+    PrintJson(config, results);
+  } else {
+    PrintCsv(config, results);
+  }
+  return 0;
+}
+
+}  // namespace workload
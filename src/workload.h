@@ -0,0 +1,342 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/bulk_load.h"
+#include "src/hash_set_base.h"
+#include "src/set_stats.h"
+
+// ============================================================================
+// Configurable multi-workload benchmark
+// ----------------------------------------------------------------------------
+// Runs a timed mix of Contains/Add/Remove operations against one or more
+// hash set implementations, for each thread count of a sweep, and reports
+// throughput plus per-operation latency percentiles as CSV or JSON.
+//
+// A run has two phases: |warmup_ms| during which operations are executed but
+// not recorded, followed by |duration_ms| of measurement. Keys are drawn from
+// [0, key_range), either uniformly or from a Zipfian distribution in which
+// key 0 is the most popular.
+//
+// Each run calls the set either on its concrete type, where the operations
+// are final and dispatched statically, or through HashSetBase<int>, which
+// costs a virtual call per operation; sweeping both measures the difference.
+//
+// In builds with HASH_SET_STATS, the sets' hot-path statistics for the
+// measured phase are reported next to the timings (see set_stats.h).
+//
+// On NUMA machines, |affinity| pins the threads to nodes (see numa.h). The
+// driver thread builds and prefills each set, so with kLocal and kRemote the
+// set's memory starts out on node 0, and the workers run on node 0 or on
+// another node; kSpread deals the workers out over all nodes, which suits
+// HashSetSharded.
+//
+// The prefill either adds its keys one by one, or, with PrefillMode::kBulk,
+// builds the set from all of them at once (see bulk_load.h); how long that
+// took is reported as prefill_ms.
+// ============================================================================
+namespace workload {
+
+enum class Distribution { kUniform, kZipfian };
+enum class Format { kCsv, kJson };
+enum class Dispatch { kStatic, kVirtual };
+enum class Affinity { kNone, kLocal, kRemote, kSpread };
+enum class PrefillMode { kAdd, kBulk };
+
+struct Config {
+  std::vector<size_t> thread_counts = {1, 2, 4, 8};
+  std::vector<std::string> implementations;  // empty means all
+  std::vector<Dispatch> dispatches = {Dispatch::kStatic};
+  unsigned read_percent = 90;
+  unsigned insert_percent = 5;
+  unsigned remove_percent = 5;
+  Distribution distribution = Distribution::kUniform;
+  double zipf_theta = 0.99;
+  size_t key_range = size_t{1} << 20;
+  unsigned prefill_percent = 50;  // share of the key range added up front
+  PrefillMode prefill_mode = PrefillMode::kAdd;
+  size_t initial_capacity = 16;
+  size_t warmup_ms = 200;
+  size_t duration_ms = 1000;
+  uint64_t seed = 1;
+  Affinity affinity = Affinity::kNone;
+  Format format = Format::kCsv;
+};
+
+// Parses --name=value flags into |config|. Prints a message and returns false
+// on malformed input.
+bool ParseArgs(int argc, char** argv, Config& config);
+
+// ----------------------------------------------------------------------------
+// Small, fast per-thread PRNG (splitmix64).
+// ----------------------------------------------------------------------------
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state_(seed) {}
+
+  uint64_t Next() noexcept {
+    uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform double in [0, 1).
+  double NextDouble() noexcept {
+    return static_cast<double>(Next() >> 11) * 0x1.0p-53;
+  }
+
+ private:
+  uint64_t state_;
+};
+
+// ----------------------------------------------------------------------------
+// Zipfian key generator over [0, n) (Gray et al., "Quickly generating
+// billion-record synthetic databases", as used by YCSB). Construction is
+// O(n); sampling is O(1). Immutable once built, so it can be shared by all
+// threads.
+// ----------------------------------------------------------------------------
+class ZipfianGenerator {
+ public:
+  ZipfianGenerator(size_t n, double theta);
+
+  size_t Sample(Random& random) const noexcept;
+
+ private:
+  size_t n_;
+  double theta_;
+  double alpha_;
+  double zeta_n_;
+  double eta_;
+};
+
+// ----------------------------------------------------------------------------
+// Log-linear latency histogram in nanoseconds: values are grouped by their
+// highest set bit and the kSubBits bits below it, which bounds the relative
+// error of a reported percentile by 1 / 2^kSubBits.
+// ----------------------------------------------------------------------------
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  void Record(uint64_t nanos) noexcept { ++counts_[BucketOf(nanos)]; }
+  void Merge(const LatencyHistogram& other);
+
+  [[nodiscard]] uint64_t Count() const noexcept;
+  // Returns the smallest recorded bucket value below which |quantile| of the
+  // samples fall, or 0 if the histogram is empty.
+  [[nodiscard]] uint64_t Percentile(double quantile) const noexcept;
+
+ private:
+  static constexpr unsigned kSubBits = 4;
+  static constexpr size_t kSubBuckets = size_t{1} << kSubBits;
+  static constexpr size_t kNumBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+  static size_t BucketOf(uint64_t nanos) noexcept;
+  static uint64_t LowerBound(size_t bucket) noexcept;
+
+  std::vector<uint64_t> counts_;
+};
+
+enum class Op { kContains, kAdd, kRemove };
+inline constexpr size_t kNumOps = 3;
+
+// Per-thread measurements.
+struct ThreadStats {
+  uint64_t ops = 0;
+  // Contains() calls that found their key. Also keeps inlined lookups from
+  // being optimised away.
+  uint64_t hits = 0;
+  LatencyHistogram latency[kNumOps];
+};
+
+// Result of one implementation at one thread count.
+struct Result {
+  std::string implementation;
+  Dispatch dispatch = Dispatch::kStatic;
+  size_t threads = 0;
+  double seconds = 0;
+  uint64_t ops = 0;
+  uint64_t op_counts[kNumOps] = {};
+  uint64_t p50_ns[kNumOps] = {};
+  uint64_t p99_ns[kNumOps] = {};
+  uint64_t p999_ns[kNumOps] = {};
+  size_t final_size = 0;
+  double prefill_seconds = 0;  // building and prefilling the set
+  // Only for sets that report them, in builds with HASH_SET_STATS.
+  std::optional<SetStatsSnapshot> set_stats;
+};
+
+// Phases of a run, published by the driver thread.
+enum class Phase : int { kWarmup, kMeasure, kStop };
+
+// Pin the calling thread to the node |config.affinity| gives the driver
+// thread, or to the one it gives worker |id|. Both do nothing for kNone.
+void PinDriverThread(const Config& config);
+void PinWorkerThread(const Config& config, size_t id);
+
+// Body of one worker thread: runs operations until |phase| becomes kStop and
+// records the ones issued while it is kMeasure.
+template <HashSet<int> HashSetType>
+void ThreadBody(HashSetType& hash_set, const Config& config,
+                const ZipfianGenerator* zipfian, size_t id,
+                const std::atomic<Phase>& phase, ThreadStats& stats) {
+  PinWorkerThread(config, id);
+  Random random(config.seed * 0x100000001b3ULL + id);
+  const uint64_t read_threshold = config.read_percent;
+  const uint64_t insert_threshold = read_threshold + config.insert_percent;
+  uint64_t hits = 0;
+
+  while (true) {
+    const Phase current = phase.load(std::memory_order_acquire);
+    if (current == Phase::kStop) {
+      break;
+    }
+
+    const uint64_t draw = random.Next();
+    const uint64_t choice = (draw >> 32) % 100;
+    const size_t key = zipfian != nullptr
+                           ? zipfian->Sample(random)
+                           : static_cast<size_t>(draw % config.key_range);
+    const int elem = static_cast<int>(key);
+    const Op op = choice < read_threshold     ? Op::kContains
+                  : choice < insert_threshold ? Op::kAdd
+                                              : Op::kRemove;
+
+    const auto begin_time = std::chrono::steady_clock::now();
+    if (op == Op::kContains) {
+      hits += hash_set.Contains(elem) ? 1u : 0u;
+    } else if (op == Op::kAdd) {
+      hash_set.Add(elem);
+    } else {
+      hash_set.Remove(elem);
+    }
+    const auto end_time = std::chrono::steady_clock::now();
+
+    if (current == Phase::kMeasure) {
+      const auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             end_time - begin_time)
+                             .count();
+      stats.latency[static_cast<size_t>(op)].Record(
+          static_cast<uint64_t>(nanos));
+      ++stats.ops;
+    }
+  }
+  stats.hits = hits;
+}
+
+// Returns the prefill share of the key range, spread over the whole range so
+// that every region of the key space starts with the same density.
+std::vector<int> PrefillKeys(const Config& config);
+
+// Builds |hash_set| and inserts |keys| into it by |config.prefill_mode|. Sets
+// without a bulk-load constructor are always prefilled by Add().
+template <HashSet<int> HashSetType>
+void BuildPrefilled(std::optional<HashSetType>& hash_set,
+                    const std::vector<int>& keys, const Config& config) {
+  if constexpr (std::constructible_from<HashSetType, std::span<const int>,
+                                        BulkKeys, size_t>) {
+    if (config.prefill_mode == PrefillMode::kBulk) {
+      hash_set.emplace(std::span<const int>(keys), BulkKeys::kDistinct,
+                       config.initial_capacity);
+      return;
+    }
+  }
+  hash_set.emplace(config.initial_capacity);
+  for (const int key : keys) {
+    hash_set->Add(key);
+  }
+}
+
+// Collapses per-thread statistics into a Result.
+Result Summarize(const std::string& implementation, size_t threads,
+                 double seconds, const std::vector<ThreadStats>& stats,
+                 size_t final_size);
+
+// ----------------------------------------------------------------------------
+// Runs |config| against a fresh HashSetType with |num_threads| workers, which
+// call it through |dispatch|.
+// ----------------------------------------------------------------------------
+template <typename HashSetType>
+Result RunWorkload(const std::string& name, const Config& config,
+                   const ZipfianGenerator* zipfian, size_t num_threads,
+                   Dispatch dispatch) {
+  PinDriverThread(config);
+  const std::vector<int> keys = PrefillKeys(config);
+  std::optional<HashSetType> storage;
+  const auto prefill_begin = std::chrono::steady_clock::now();
+  BuildPrefilled(storage, keys, config);
+  const auto prefill_end = std::chrono::steady_clock::now();
+  HashSetType& hash_set = *storage;
+  HashSetBase<int>& base = hash_set;
+
+  std::atomic<Phase> phase{Phase::kWarmup};
+  std::vector<ThreadStats> stats(num_threads);
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; i++) {
+    if (dispatch == Dispatch::kVirtual) {
+      threads.emplace_back(ThreadBody<HashSetBase<int>>, std::ref(base),
+                           std::cref(config), zipfian, i, std::cref(phase),
+                           std::ref(stats[i]));
+    } else {
+      threads.emplace_back(ThreadBody<HashSetType>, std::ref(hash_set),
+                           std::cref(config), zipfian, i, std::cref(phase),
+                           std::ref(stats[i]));
+    }
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(config.warmup_ms));
+  if constexpr (ReportsSetStats<HashSetType>) {
+    hash_set.ResetStats();
+  }
+  const auto begin_time = std::chrono::steady_clock::now();
+  phase.store(Phase::kMeasure, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::milliseconds(config.duration_ms));
+  phase.store(Phase::kStop, std::memory_order_release);
+  const auto end_time = std::chrono::steady_clock::now();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  const double seconds =
+      std::chrono::duration<double>(end_time - begin_time).count();
+  Result result = Summarize(name, num_threads, seconds, stats, hash_set.Size());
+  result.dispatch = dispatch;
+  result.prefill_seconds =
+      std::chrono::duration<double>(prefill_end - prefill_begin).count();
+  if constexpr (kSetStatsEnabled && ReportsSetStats<HashSetType>) {
+    result.set_stats = hash_set.Stats();
+  }
+  return result;
+}
+
+// An implementation the suite can run. Implementations that are not
+// thread-safe only run with a single thread.
+struct Implementation {
+  std::string name;
+  Result (*run)(const std::string& name, const Config& config,
+                const ZipfianGenerator* zipfian, size_t num_threads,
+                Dispatch dispatch);
+  bool thread_safe;
+};
+
+// Sweeps every selected implementation over every thread count and prints
+// the results to std::cout. Returns the process exit code.
+int RunSuite(const Config& config,
+             const std::vector<Implementation>& implementations);
+
+}  // namespace workload
+
+#endif  // WORKLOAD_H
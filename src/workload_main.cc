@@ -0,0 +1,124 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/arena.h"
+#include "src/bucket_storage.h"
+#include "src/hash_policy.h"
+#include "src/hash_set_coarse_grained.h"
+#include "src/hash_set_cuckoo.h"
+#include "src/hash_set_lock_free.h"
+#include "src/hash_set_refinable.h"
+#include "src/hash_set_sequential.h"
+#include "src/hash_set_sharded.h"
+#include "src/hash_set_striped.h"
+#include "src/lock_policy.h"
+#include "src/workload.h"
+
+int main(int argc, char** argv) {
+  workload::Config config;
+  if (!workload::ParseArgs(argc, argv, config)) {
+    return 1;
+  }
+
+  // Every implementation the suite knows about, in output order.
+  const std::vector<workload::Implementation> implementations = {
+      {"sequential", &workload::RunWorkload<HashSetSequential<int>>, false},
+      {"coarse_grained", &workload::RunWorkload<HashSetCoarseGrained<int>>,
+       true},
+      // Reader-writer global lock, shared by lookups.
+      {"coarse_grained_rw",
+       &workload::RunWorkload<HashSetCoarseGrainedRW<int>>, true},
+      {"coarse_grained_rw_spin",
+       &workload::RunWorkload<
+           HashSetCoarseGrainedRW<int, VectorBucketStorage, ModuloHashPolicy<>,
+                                  std::allocator<int>, SpinParkLockPolicy>>,
+       true},
+      {"striped", &workload::RunWorkload<HashSetStriped<int>>, true},
+      {"refinable", &workload::RunWorkload<HashSetRefinable<int>>, true},
+      {"lock_free", &workload::RunWorkload<HashSetLockFree<int>>, true},
+      {"cuckoo", &workload::RunWorkload<HashSetCuckoo<int>>, true},
+      {"sequential_mask",
+       &workload::RunWorkload<
+           HashSetSequential<int, VectorBucketStorage, MaskHashPolicy<>>>,
+       false},
+      {"striped_mask",
+       &workload::RunWorkload<
+           HashSetStriped<int, VectorBucketStorage, MaskHashPolicy<>>>,
+       true},
+      // Per-table arenas instead of the global heap (see arena.h).
+      {"sequential_arena",
+       &workload::RunWorkload<
+           HashSetSequential<int, VectorBucketStorage, ModuloHashPolicy<>,
+                             ArenaAllocator<int>>>,
+       false},
+      {"coarse_grained_arena",
+       &workload::RunWorkload<
+           HashSetCoarseGrained<int, VectorBucketStorage, ModuloHashPolicy<>,
+                                ArenaAllocator<int>>>,
+       true},
+      {"striped_arena",
+       &workload::RunWorkload<
+           HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                          ArenaAllocator<int>>>,
+       true},
+      {"refinable_arena",
+       &workload::RunWorkload<
+           HashSetRefinable<int, VectorBucketStorage, ModuloHashPolicy<>,
+                            ArenaAllocator<int>>>,
+       true},
+      // Lock-free Contains (see hash_set_striped.h).
+      {"striped_optimistic",
+       &workload::RunWorkload<HashSetStriped<int, InlineBucketStorage<8>>>,
+       true},
+      // Spin-then-park locks (see lock_policy.h).
+      {"striped_spin",
+       &workload::RunWorkload<
+           HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                          std::allocator<int>, SpinParkLockPolicy>>,
+       true},
+      {"refinable_spin",
+       &workload::RunWorkload<
+           HashSetRefinable<int, VectorBucketStorage, ModuloHashPolicy<>,
+                            std::allocator<int>, SpinParkLockPolicy>>,
+       true},
+      // Padded lock layout, to compare with the packed variants above.
+      {"striped_padded",
+       &workload::RunWorkload<
+           HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                          std::allocator<int>,
+                          PaddedLockPolicy<StdLockPolicy>>>,
+       true},
+      {"refinable_padded",
+       &workload::RunWorkload<
+           HashSetRefinable<int, VectorBucketStorage, ModuloHashPolicy<>,
+                            std::allocator<int>,
+                            PaddedLockPolicy<StdLockPolicy>>>,
+       true},
+      {"striped_spin_padded",
+       &workload::RunWorkload<
+           HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                          std::allocator<int>,
+                          PaddedLockPolicy<SpinParkLockPolicy>>>,
+       true},
+      {"refinable_spin_padded",
+       &workload::RunWorkload<
+           HashSetRefinable<int, VectorBucketStorage, ModuloHashPolicy<>,
+                            std::allocator<int>,
+                            PaddedLockPolicy<SpinParkLockPolicy>>>,
+       true},
+      // One shard per NUMA node, with arenas on the shard's node (see
+      // hash_set_sharded.h); best run with --affinity=spread.
+      {"sharded_striped",
+       &workload::RunWorkload<HashSetSharded<
+           int, HashSetStriped<int, VectorBucketStorage, ModuloHashPolicy<>,
+                               ArenaAllocator<int>>>>,
+       true},
+      {"sharded_refinable",
+       &workload::RunWorkload<HashSetSharded<
+           int, HashSetRefinable<int, VectorBucketStorage, ModuloHashPolicy<>,
+                                 ArenaAllocator<int>>>>,
+       true},
+  };
+  return workload::RunSuite(config, implementations);
+}